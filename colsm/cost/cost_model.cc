@@ -4,24 +4,229 @@
 
 #include "cost_model.h"
 
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
 #include <fstream>
 
+#include "leveldb/env.h"
+
+#include "level_solver.h"
+
 namespace colsm {
 
 using namespace std;
 
 static int LEVEL_DEFAULT = 7;
 
+// Vertical over horizontal cost of a lookup within a block. run_solver sweeps
+// it from 0.2 to 3; until calibrated, assume vertical lookups are a bit slower
+static const double kVerticalLookupFactor = 1.2;
+
+Parameter DefaultParameter() {
+  Parameter param;
+  param.l = LEVEL_DEFAULT;
+  param.m = LEVEL_DEFAULT + 1;
+  for (auto i = 0; i < param.l; ++i) {
+    param.t.push_back(10);
+    param.fpr.push_back(0.01);
+    param.b.push_back(param.b.empty() ? 15000 : param.b.back() * 10);
+  }
+  param.h_epsilon = 179.46;
+  param.h_eta = -1740.2;
+  param.v_epsilon = kVerticalLookupFactor * param.h_epsilon;
+  param.v_eta = kVerticalLookupFactor * param.h_eta;
+
+  param.rv = 10;
+  param.rh = 10;
+
+  param.v_mu = 409.41;
+  param.v_xi = -7.99e6;
+  param.h_mu = 429.87;
+  param.h_xi = -5.01e6;
+  return param;
+}
+
+namespace {
+
+struct Coefficient {
+  const char* name;
+  double Parameter::*field;
+};
+
+const Coefficient kCoefficients[] = {
+    {"v_epsilon", &Parameter::v_epsilon}, {"v_eta", &Parameter::v_eta},
+    {"h_epsilon", &Parameter::h_epsilon}, {"h_eta", &Parameter::h_eta},
+    {"rv", &Parameter::rv},               {"rh", &Parameter::rh},
+    {"v_mu", &Parameter::v_mu},           {"v_xi", &Parameter::v_xi},
+    {"h_mu", &Parameter::h_mu},           {"h_xi", &Parameter::h_xi}};
+
+}  // namespace
+
+leveldb::Status WriteParameterFile(leveldb::Env* env, const std::string& fname,
+                                   const Parameter& param) {
+  std::string contents;
+  for (const Coefficient& coefficient : kCoefficients) {
+    char line[100];
+    std::snprintf(line, sizeof(line), "%s %.17g\n", coefficient.name,
+                  param.*coefficient.field);
+    contents.append(line);
+  }
+  return leveldb::WriteStringToFile(env, contents, fname);
+}
+
+leveldb::Status ReadParameterFile(leveldb::Env* env, const std::string& fname,
+                                  Parameter* param) {
+  std::string contents;
+  leveldb::Status s = leveldb::ReadFileToString(env, fname, &contents);
+  if (!s.ok()) {
+    return s;
+  }
+
+  Parameter result = *param;
+  size_t pos = 0;
+  while (pos < contents.size()) {
+    size_t end = contents.find('\n', pos);
+    if (end == std::string::npos) {
+      end = contents.size();
+    }
+    const std::string line = contents.substr(pos, end - pos);
+    pos = end + 1;
+    if (line.empty() || line[0] == '#') {
+      continue;
+    }
+
+    char name[32];
+    double value;
+    if (std::sscanf(line.c_str(), "%31s %lf", name, &value) != 2) {
+      return leveldb::Status::Corruption(fname, "malformed line: " + line);
+    }
+    const Coefficient* found = nullptr;
+    for (const Coefficient& coefficient : kCoefficients) {
+      if (std::strcmp(coefficient.name, name) == 0) {
+        found = &coefficient;
+      }
+    }
+    if (found == nullptr) {
+      return leveldb::Status::Corruption(fname,
+                                         std::string("unknown coefficient ") +
+                                             name);
+    }
+    result.*found->field = value;
+  }
+  *param = result;
+  return leveldb::Status::OK();
+}
+
+void FitLine(const std::vector<double>& x, const std::vector<double>& y,
+             double* slope, double* intercept) {
+  const double n = static_cast<double>(x.size());
+  double sum_x = 0, sum_y = 0, sum_xx = 0, sum_xy = 0;
+  for (size_t i = 0; i < x.size(); ++i) {
+    sum_x += x[i];
+    sum_y += y[i];
+    sum_xx += x[i] * x[i];
+    sum_xy += x[i] * y[i];
+  }
+  *slope = (n * sum_xy - sum_x * sum_y) / (n * sum_xx - sum_x * sum_x);
+  *intercept = (sum_y - *slope * sum_x) / n;
+}
+
+double LevelCost(const Parameter& param, const Workload& workload, int level,
+                 bool vertical) {
+  const double epsilon = vertical ? param.v_epsilon : param.h_epsilon;
+  const double eta = vertical ? param.v_eta : param.h_eta;
+  const double range = vertical ? param.rv : param.rh;
+  const double mu = vertical ? param.v_mu : param.h_mu;
+  const double xi = vertical ? param.v_xi : param.h_xi;
+
+  const bool leveling = level >= param.m;
+  const double runs = leveling ? 1 : param.t[level];
+  const double merges = leveling ? param.t[level] : 1;
+
+  // The fitted lines go below zero for small blocks, where no cost is
+  // measured; a run or a merge never costs less than nothing
+  const double lookup =
+      std::max(epsilon * std::log(param.b[level]) + eta, 0.0);
+  const double p = runs * param.fpr[level] * lookup;
+  const double r = runs * std::max(param.fpr[level] * lookup + range, 0.0);
+  const double u = merges * std::max(mu + xi / param.b[level], 0.0);
+  return workload.alpha * p + workload.beta * r + workload.gamma * u;
+}
+
+WorkloadTracker::WorkloadTracker()
+    : range_lookups_(0), updates_(0), operations_(0) {
+  for (auto& count : point_lookups_) {
+    count.store(0, std::memory_order_relaxed);
+  }
+}
+
+void WorkloadTracker::RecordPointLookup(uint32_t levels) {
+  for (int level = 0; levels != 0 && level < kMaxLevels; ++level) {
+    if (levels & (1u << level)) {
+      point_lookups_[level].fetch_add(1, std::memory_order_relaxed);
+      levels &= ~(1u << level);
+    }
+  }
+  operations_.fetch_add(1, std::memory_order_relaxed);
+}
+
+void WorkloadTracker::RecordRangeLookup() {
+  range_lookups_.fetch_add(1, std::memory_order_relaxed);
+  operations_.fetch_add(1, std::memory_order_relaxed);
+}
+
+void WorkloadTracker::RecordUpdates(uint64_t count) {
+  updates_.fetch_add(count, std::memory_order_relaxed);
+  operations_.fetch_add(count, std::memory_order_relaxed);
+}
+
+uint64_t WorkloadTracker::Operations() const {
+  return operations_.load(std::memory_order_relaxed);
+}
+
+std::vector<Workload> WorkloadTracker::TakeWorkloads(int num_levels) {
+  // Counts racing with the exchanges land in this window or the next
+  const double range =
+      static_cast<double>(range_lookups_.exchange(0, std::memory_order_relaxed));
+  const double updates =
+      static_cast<double>(updates_.exchange(0, std::memory_order_relaxed));
+  operations_.store(0, std::memory_order_relaxed);
+
+  std::vector<Workload> workloads;
+  for (int level = 0; level < num_levels; ++level) {
+    double point = 0;
+    if (level < kMaxLevels) {
+      point = static_cast<double>(
+          point_lookups_[level].exchange(0, std::memory_order_relaxed));
+    }
+    const double total = point + range + updates;
+    if (total == 0) {
+      workloads.push_back(Workload{0, 0, 0});
+    } else {
+      workloads.push_back(
+          Workload{point / total, range / total, updates / total});
+    }
+  }
+  return workloads;
+}
+
 CostModel::CostModel() {
 //  if (!ReadModel()) {
     for (auto i = 0; i <= LEVEL_DEFAULT; ++i) {
-      level_vertical_.push_back(true);
+      level_vertical_[i].store(true, std::memory_order_relaxed);
     }
 //  }
 }
 
+CostModel::CostModel(const std::vector<bool>& level_vertical) : CostModel() {
+  for (size_t i = 0; i < level_vertical.size() && i < kMaxLevels; ++i) {
+    level_vertical_[i].store(level_vertical[i], std::memory_order_relaxed);
+  }
+}
+
 bool CostModel::ReadModel() {
-  level_vertical_.clear();
   ifstream modelFile("colsm_model");
   if (modelFile.good()) {
     uint32_t num_level;
@@ -29,7 +234,9 @@ bool CostModel::ReadModel() {
     bool level_assign;
     for (int i = 0; i < num_level; ++i) {
       modelFile >> level_assign;
-      level_vertical_.push_back(level_assign);
+      if (i < kMaxLevels) {
+        level_vertical_[i].store(level_assign, std::memory_order_relaxed);
+      }
     }
     modelFile.close();
     return true;
@@ -37,9 +244,62 @@ bool CostModel::ReadModel() {
   return false;
 }
 
-std::unique_ptr<CostModel> CostModel::INSTANCE =
-    std::unique_ptr<CostModel>(new CostModel());
+bool CostModel::ShouldVertical(int level) {
+  return level_vertical_[level].load(std::memory_order_relaxed);
+}
+
+bool CostModel::Adapt(const Parameter& param,
+                      const std::vector<Workload>& workloads) {
+  std::vector<Workload> padded(workloads);
+  padded.resize(std::max<size_t>(padded.size(), param.l), Workload{0, 0, 0});
+  Parameter solved = param;
+  LevelSolver().Solve(solved, padded);
+
+  bool changed = false;
+  for (int level = 0; level < param.l && level < kMaxLevels; ++level) {
+    const Workload& workload = padded[level];
+    if (workload.alpha + workload.beta + workload.gamma == 0) {
+      continue;
+    }
+    if (level_workloads_.size() <= static_cast<size_t>(level)) {
+      level_workloads_.resize(level + 1, Workload{0, 0, 0});
+    }
+    level_workloads_[level] = workload;
+    const bool should_vertical = solved.level_results[level];
+    if (should_vertical != ShouldVertical(level)) {
+      level_vertical_[level].store(should_vertical, std::memory_order_relaxed);
+      changed = true;
+    }
+  }
+  return changed;
+}
 
-bool CostModel::ShouldVertical(int level) { return level_vertical_[level]; }
+bool CostModel::ShouldVertical(const Parameter& param, int level,
+                               const KeyRangeStats& range,
+                               const KeyRangeStats& level_stats) {
+  const double level_lookups = static_cast<double>(level_stats.point_lookups +
+                                                   level_stats.range_lookups);
+  if (level >= param.l ||
+      static_cast<size_t>(level) >= level_workloads_.size() ||
+      level_lookups == 0 || level_stats.bytes == 0 || range.bytes == 0) {
+    return ShouldVertical(level);
+  }
+  const Workload& workload = level_workloads_[level];
+  if (workload.alpha + workload.beta + workload.gamma == 0) {
+    return ShouldVertical(level);
+  }
+  const double lookups =
+      static_cast<double>(range.point_lookups + range.range_lookups);
+  const double density = (lookups / range.bytes) /
+                         (level_lookups / level_stats.bytes);
+  Workload scaled{0, 0, workload.gamma};
+  if (lookups > 0) {
+    const double share = (workload.alpha + workload.beta) * density;
+    scaled.alpha = share * range.point_lookups / lookups;
+    scaled.beta = share * range.range_lookups / lookups;
+  }
+  return LevelCost(param, scaled, level, true) <=
+         LevelCost(param, scaled, level, false);
+}
 
 }  // namespace colsm
\ No newline at end of file
@@ -4,9 +4,18 @@
 
 #ifndef COLSM_COST_MODEL_H
 #define COLSM_COST_MODEL_H
+#include <atomic>
+#include <cstdint>
 #include <memory>
+#include <string>
 #include <vector>
 
+#include "leveldb/status.h"
+
+namespace leveldb {
+class Env;
+}
+
 namespace colsm {
 
 struct Parameter {
@@ -40,20 +49,136 @@ struct Workload {
   double gamma;  // Percentage of update
 };
 
+/**
+ * Parameters of the solver for a 7-level tree, with the coefficients
+ * measured in run_solver.cc
+ */
+Parameter DefaultParameter();
+
+/**
+ * Write the measured coefficients of param (the p(x), range and update
+ * costs) to a text file, one "name value" per line
+ */
+leveldb::Status WriteParameterFile(leveldb::Env* env, const std::string& fname,
+                                   const Parameter& param);
+
+/**
+ * Override the coefficients of param with those in a file written by
+ * WriteParameterFile. Coefficients missing from the file keep their value,
+ * and param is unchanged on error.
+ */
+leveldb::Status ReadParameterFile(leveldb::Env* env, const std::string& fname,
+                                  Parameter* param);
+
+/**
+ * Least squares fit of y = slope * x + intercept
+ * REQUIRES: x holds at least two distinct values
+ */
+void FitLine(const std::vector<double>& x, const std::vector<double>& y,
+             double* slope, double* intercept);
+
+/**
+ * Cost of serving the workload of a level in the vertical or horizontal
+ * format, the term of level i in the objective of CPlexSolver::SolveLevelDB
+ * (which does not clamp).
+ * That objective tiers every level, with t runs to probe. Levels from
+ * param.m on use leveling instead: a lookup probes a single run, but an
+ * update is merged about t times into the level. The cost of a run or a
+ * merge is clamped at zero, so no level ever has a negative cost.
+ */
+double LevelCost(const Parameter& param, const Workload& workload, int level,
+                 bool vertical);
+
+/**
+ * Counts the point lookups, range lookups and updates served by a DB. A
+ * point lookup counts for each level it reads a file from, range lookups
+ * and updates count for every level. Thread safe.
+ */
+class WorkloadTracker {
+ public:
+  static const int kMaxLevels = 8;
+
+  WorkloadTracker();
+
+  /**
+   * @param levels bit i is set if the lookup read a file at level i
+   */
+  void RecordPointLookup(uint32_t levels);
+  void RecordRangeLookup();
+  void RecordUpdates(uint64_t count);
+
+  /**
+   * Number of operations recorded since the last TakeWorkloads()
+   */
+  uint64_t Operations() const;
+
+  /**
+   * The mix of the operations at each level since the last call, which
+   * restarts the counts. A level without operations gets all zeros.
+   */
+  std::vector<Workload> TakeWorkloads(int num_levels);
+
+ private:
+  std::atomic<uint64_t> point_lookups_[kMaxLevels];
+  std::atomic<uint64_t> range_lookups_;
+  std::atomic<uint64_t> updates_;
+  std::atomic<uint64_t> operations_;
+};
+
+/**
+ * Lookups served by some tables of a level, and their bytes
+ */
+struct KeyRangeStats {
+  uint64_t point_lookups;
+  uint64_t range_lookups;
+  uint64_t bytes;
+};
+
 class CostModel {
  protected:
-  CostModel();
+  static const int kMaxLevels = 8;
 
-  std::vector<bool> level_vertical_;
+  std::atomic<bool> level_vertical_[kMaxLevels];
+  // The last workload of each level that served operations, guarded like
+  // Adapt()
+  std::vector<Workload> level_workloads_;
 
   bool ReadModel();
 
  public:
-  virtual ~CostModel() = default;
+  // All levels vertical
+  CostModel();
 
-  static std::unique_ptr<CostModel> INSTANCE;
+  /**
+   * @param level_vertical the initial format of each level, levels past its
+   * end are vertical
+   */
+  explicit CostModel(const std::vector<bool>& level_vertical);
+
+  virtual ~CostModel() = default;
 
   bool ShouldVertical(int level);
+
+  /**
+   * Switch each level to the format LevelSolver chooses for its own
+   * workload. A level that served no operations keeps its format.
+   * @return true if the format of some level changed
+   */
+  bool Adapt(const Parameter& param, const std::vector<Workload>& workloads);
+
+  /**
+   * Format of the tables of a key range of a level. Updates spread over the
+   * keys of a level alike, lookups may not: the key range gets the last
+   * workload of the level, with its lookups scaled by the lookups per byte
+   * of the range over those of the level, and split between point and range
+   * lookups as the range served them. A hot range then leans to the cheaper
+   * lookups, a cold one to the cheaper updates. A tie picks vertical.
+   * Without a workload or lookups at the level, the format of the level.
+   * REQUIRES: External synchronization with Adapt()
+   */
+  bool ShouldVertical(const Parameter& param, int level,
+                      const KeyRangeStats& range,
+                      const KeyRangeStats& level_stats);
 };
 
 }  // namespace colsm
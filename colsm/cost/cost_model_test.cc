@@ -0,0 +1,228 @@
+//
+// Created by harper on 10/19/26.
+//
+
+#include "cost_model.h"
+
+#include <colsm/comparators.h>
+#include <gtest/gtest.h>
+
+#include "leveldb/db.h"
+#include "leveldb/env.h"
+
+#include "helpers/memenv/memenv.h"
+#include "util/coding.h"
+
+using namespace colsm;
+using namespace leveldb;
+
+TEST(CostModel, AdaptToWorkload) {
+  Parameter param = DefaultParameter();
+  CostModel model;
+  std::vector<Workload> updates(param.l, Workload{0, 0, 1});
+  EXPECT_FALSE(model.Adapt(param, updates));
+
+  // Point lookups favor horizontal blocks, except on the tiny level 0
+  std::vector<Workload> lookups(param.l, Workload{1, 0, 0});
+  EXPECT_TRUE(model.Adapt(param, lookups));
+  EXPECT_TRUE(model.ShouldVertical(0));
+  for (int level = 1; level < param.l; ++level) {
+    EXPECT_FALSE(model.ShouldVertical(level)) << level;
+  }
+
+  // Idle levels keep their format
+  std::vector<Workload> idle(param.l, Workload{0, 0, 0});
+  EXPECT_FALSE(model.Adapt(param, idle));
+  EXPECT_FALSE(model.ShouldVertical(1));
+
+  EXPECT_TRUE(model.Adapt(param, updates));
+  for (int level = 0; level < param.l; ++level) {
+    EXPECT_TRUE(model.ShouldVertical(level)) << level;
+  }
+}
+
+TEST(CostModel, KeyRangeFormat) {
+  Parameter param = DefaultParameter();
+  const KeyRangeStats level{1000, 0, 20 << 20};
+  const KeyRangeStats hot{1000, 0, 2 << 20};
+  const KeyRangeStats cold{0, 0, 2 << 20};
+
+  // Without a workload, the format of the level
+  CostModel model({false, false});
+  EXPECT_FALSE(model.ShouldVertical(param, 1, cold, level));
+
+  // Half updates keep the level vertical. The range serving all lookups of
+  // the level gets ten times its share of them, and horizontal blocks.
+  std::vector<Workload> mixed(param.l, Workload{0.5, 0, 0.5});
+  model.Adapt(param, mixed);
+  EXPECT_TRUE(model.ShouldVertical(1));
+  EXPECT_FALSE(model.ShouldVertical(param, 1, hot, level));
+  EXPECT_TRUE(model.ShouldVertical(param, 1, cold, level));
+  EXPECT_TRUE(model.ShouldVertical(param, 1, level, level));
+
+  // Where vertical blocks scan faster, a range hot with scans is vertical
+  param.rv = param.rh / 100;
+  const KeyRangeStats scanned{0, 1000, 2 << 20};
+  EXPECT_TRUE(model.ShouldVertical(param, 1, scanned, level));
+  EXPECT_FALSE(model.ShouldVertical(param, 1, hot, level));
+}
+
+TEST(CostModel, TrackWorkload) {
+  WorkloadTracker tracker;
+  tracker.RecordPointLookup(0x1 | 0x4);
+  tracker.RecordPointLookup(0x4);
+  tracker.RecordRangeLookup();
+  tracker.RecordUpdates(6);
+  EXPECT_EQ(9, tracker.Operations());
+
+  auto workloads = tracker.TakeWorkloads(3);
+  ASSERT_EQ(3, workloads.size());
+  EXPECT_DOUBLE_EQ(1.0 / 8, workloads[0].alpha);
+  EXPECT_DOUBLE_EQ(0, workloads[1].alpha);
+  EXPECT_DOUBLE_EQ(1.0 / 7, workloads[1].beta);
+  EXPECT_DOUBLE_EQ(2.0 / 9, workloads[2].alpha);
+  EXPECT_DOUBLE_EQ(6.0 / 9, workloads[2].gamma);
+
+  EXPECT_EQ(0, tracker.Operations());
+  workloads = tracker.TakeWorkloads(3);
+  EXPECT_DOUBLE_EQ(0, workloads[2].alpha + workloads[2].beta +
+                          workloads[2].gamma);
+}
+
+static std::string Key(uint32_t i) {
+  std::string result;
+  PutFixed32(&result, i);
+  return result;
+}
+
+TEST(CostModel, DBFollowsWorkload) {
+  std::unique_ptr<Env> env(NewMemEnv(Env::Default()));
+  auto comparator = intComparator();
+  Options options;
+  options.env = env.get();
+  options.comparator = comparator.get();
+  options.create_if_missing = true;
+  options.layout_adaptation_ops = 1000;
+
+  DB* db;
+  ASSERT_TRUE(DB::Open(options, "/layoutdb", &db).ok());
+  const uint32_t kNumKeys = 5000;
+  for (uint32_t i = 0; i < kNumKeys; i++) {
+    ASSERT_TRUE(db->Put(WriteOptions(), Key(i), std::to_string(i)).ok());
+  }
+  db->CompactRange(nullptr, nullptr);
+  std::string layout;
+  ASSERT_TRUE(db->GetProperty("leveldb.layout", &layout));
+  ASSERT_EQ("VVVVVVV", layout);
+
+  // Lookups reach the levels holding the keys, the next compaction
+  // switches them to horizontal blocks
+  for (int round = 0; round < 10; round++) {
+    for (uint32_t i = 0; i < kNumKeys; i++) {
+      std::string value;
+      ASSERT_TRUE(db->Get(ReadOptions(), Key(i), &value).ok());
+    }
+  }
+  db->CompactRange(nullptr, nullptr);
+  ASSERT_TRUE(db->GetProperty("leveldb.layout", &layout));
+  for (int level = 1; level < 7; level++) {
+    std::string files;
+    ASSERT_TRUE(db->GetProperty(
+        "leveldb.num-files-at-level" + std::to_string(level), &files));
+    if (files != "0") {
+      ASSERT_EQ('H', layout[level]) << layout;
+    }
+  }
+  ASSERT_NE("VVVVVVV", layout);
+
+  // And back once updates dominate
+  for (int round = 0; round < 4; round++) {
+    for (uint32_t i = 0; i < kNumKeys; i++) {
+      ASSERT_TRUE(db->Put(WriteOptions(), Key(i), std::to_string(i)).ok());
+    }
+  }
+  db->CompactRange(nullptr, nullptr);
+  ASSERT_TRUE(db->GetProperty("leveldb.layout", &layout));
+  ASSERT_EQ("VVVVVVV", layout);
+
+  for (uint32_t i = 0; i < kNumKeys; i++) {
+    std::string value;
+    ASSERT_TRUE(db->Get(ReadOptions(), Key(i), &value).ok());
+    ASSERT_EQ(std::to_string(i), value);
+  }
+  delete db;
+}
+
+TEST(CostModel, FitLine) {
+  double slope, intercept;
+  FitLine({1, 2, 3, 4}, {5, 7, 9, 11}, &slope, &intercept);
+  EXPECT_DOUBLE_EQ(2, slope);
+  EXPECT_DOUBLE_EQ(3, intercept);
+}
+
+TEST(CostModel, ParameterFile) {
+  std::unique_ptr<Env> env(NewMemEnv(Env::Default()));
+  Parameter measured = DefaultParameter();
+  measured.v_epsilon = 69.34;
+  measured.h_eta = -1293.05;
+  measured.rv = 20.5;
+  measured.h_xi = -18084.9;
+  ASSERT_TRUE(WriteParameterFile(env.get(), "/params", measured).ok());
+
+  Parameter param = DefaultParameter();
+  ASSERT_TRUE(ReadParameterFile(env.get(), "/params", &param).ok());
+  EXPECT_DOUBLE_EQ(69.34, param.v_epsilon);
+  EXPECT_DOUBLE_EQ(-1293.05, param.h_eta);
+  EXPECT_DOUBLE_EQ(20.5, param.rv);
+  EXPECT_DOUBLE_EQ(-18084.9, param.h_xi);
+  EXPECT_DOUBLE_EQ(measured.v_mu, param.v_mu);
+  EXPECT_EQ(measured.l, param.l);
+
+  // Missing coefficients keep their value
+  ASSERT_TRUE(
+      WriteStringToFile(env.get(), "# measured\nrh 12.5\n", "/partial").ok());
+  param = DefaultParameter();
+  ASSERT_TRUE(ReadParameterFile(env.get(), "/partial", &param).ok());
+  EXPECT_DOUBLE_EQ(12.5, param.rh);
+  EXPECT_DOUBLE_EQ(DefaultParameter().rv, param.rv);
+
+  ASSERT_TRUE(WriteStringToFile(env.get(), "rh 1\nfoo 2\n", "/bad").ok());
+  EXPECT_TRUE(ReadParameterFile(env.get(), "/bad", &param).IsCorruption());
+  EXPECT_DOUBLE_EQ(12.5, param.rh);
+  EXPECT_FALSE(ReadParameterFile(env.get(), "/missing", &param).ok());
+}
+
+TEST(CostModel, DBLoadsParameterFile) {
+  std::unique_ptr<Env> env(NewMemEnv(Env::Default()));
+  auto comparator = intComparator();
+  Options options;
+  options.env = env.get();
+  options.comparator = comparator.get();
+  options.create_if_missing = true;
+  options.layout_adaptation_ops = 1000;
+  options.cost_parameter_file = "/params";
+
+  DB* db;
+  ASSERT_FALSE(DB::Open(options, "/paramdb", &db).ok());
+
+  // A host where vertical blocks are slow at everything
+  Parameter param = DefaultParameter();
+  param.v_epsilon = param.v_mu = 1e6;
+  param.v_eta = param.v_xi = 0;
+  param.rv = 1e6;
+  ASSERT_TRUE(WriteParameterFile(env.get(), "/params", param).ok());
+  ASSERT_TRUE(DB::Open(options, "/paramdb", &db).ok());
+  for (uint32_t i = 0; i < 2000; i++) {
+    ASSERT_TRUE(db->Put(WriteOptions(), Key(i), std::to_string(i)).ok());
+  }
+  db->CompactRange(nullptr, nullptr);
+  std::string layout;
+  ASSERT_TRUE(db->GetProperty("leveldb.layout", &layout));
+  ASSERT_EQ("HHHHHHH", layout);
+  delete db;
+}
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,60 @@
+//
+// Created by harper on 10/19/26.
+//
+
+#include "filter_allocation.h"
+
+#include <cmath>
+
+namespace colsm {
+
+static const double LN2_SQUARE = std::log(2) * std::log(2);
+
+std::vector<double> AllocateFilterFpr(const std::vector<double>& level_entries,
+                                      double total_bits) {
+  std::vector<double> fpr(level_entries.size(), 1);
+  std::vector<bool> active(level_entries.size());
+  for (size_t i = 0; i < level_entries.size(); ++i) {
+    active[i] = level_entries[i] > 0;
+  }
+  // With fpr_i = c * n_i, the memory sum_i n_i * ln(1/fpr_i) / ln2^2 equals
+  // total_bits when ln c = -(total_bits * ln2^2 + sum_i n_i ln n_i) / N.
+  // Levels that would get fpr >= 1 get no filter and are solved again.
+  bool changed = true;
+  while (changed) {
+    changed = false;
+    double num_entry = 0;
+    double entropy = 0;
+    for (size_t i = 0; i < level_entries.size(); ++i) {
+      if (active[i]) {
+        num_entry += level_entries[i];
+        entropy += level_entries[i] * std::log(level_entries[i]);
+      }
+    }
+    if (num_entry == 0) {
+      break;
+    }
+    double log_c = -(total_bits * LN2_SQUARE + entropy) / num_entry;
+    for (size_t i = 0; i < level_entries.size(); ++i) {
+      if (!active[i]) {
+        continue;
+      }
+      fpr[i] = std::exp(log_c) * level_entries[i];
+      if (fpr[i] >= 1) {
+        fpr[i] = 1;
+        active[i] = false;
+        changed = true;
+      }
+    }
+  }
+  return fpr;
+}
+
+double FilterBitsForFpr(double fpr) {
+  if (fpr >= 1) {
+    return 0;
+  }
+  return -std::log(fpr) / LN2_SQUARE;
+}
+
+}  // namespace colsm
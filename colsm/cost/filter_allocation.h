@@ -0,0 +1,35 @@
+//
+// Created by harper on 10/19/26.
+//
+//
+// Allocation of bloom filter memory to levels, following Monkey (Dayan et
+// al., SIGMOD 17). A point lookup of a missing key probes the filter of every
+// level, so its cost is the sum of the levels' false positive rates. With a
+// fixed total of filter bits, the sum is minimized by setting each level's
+// false positive rate proportional to its number of entries, i.e., giving the
+// small upper levels more bits per key and the large lower levels fewer.
+
+#ifndef COLSM_FILTER_ALLOCATION_H
+#define COLSM_FILTER_ALLOCATION_H
+
+#include <vector>
+
+namespace colsm {
+
+/**
+ * Compute the false positive rate of each level (see Parameter::fpr)
+ * @param level_entries number of entries in each level
+ * @param total_bits    total filter bits over all levels
+ * @return the fpr of each level, 1 for a level that gets no filter bits
+ */
+std::vector<double> AllocateFilterFpr(const std::vector<double>& level_entries,
+                                      double total_bits);
+
+/**
+ * Bits per key of a bloom filter with the given false positive rate
+ */
+double FilterBitsForFpr(double fpr);
+
+}  // namespace colsm
+
+#endif  // COLSM_FILTER_ALLOCATION_H
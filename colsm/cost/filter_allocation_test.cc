@@ -0,0 +1,201 @@
+//
+// Created by harper on 10/19/26.
+//
+
+#include "filter_allocation.h"
+
+#include <atomic>
+#include <cmath>
+#include <colsm/comparators.h>
+#include <gtest/gtest.h>
+#include <memory>
+#include <sstream>
+
+#include "leveldb/db.h"
+#include "leveldb/env.h"
+#include "leveldb/filter_policy.h"
+
+#include "helpers/memenv/memenv.h"
+#include "util/coding.h"
+
+using namespace colsm;
+using namespace leveldb;
+
+TEST(FilterAllocation, Monkey) {
+  std::vector<double> entries = {1e5, 1e5, 1e6, 1e7, 1e8};
+  double total_entries = 0;
+  for (auto e : entries) {
+    total_entries += e;
+  }
+  auto fpr = AllocateFilterFpr(entries, total_entries * 10);
+
+  double memory = 0;
+  double fpr_sum = 0;
+  for (size_t i = 0; i < entries.size(); ++i) {
+    memory += entries[i] * FilterBitsForFpr(fpr[i]);
+    fpr_sum += fpr[i];
+    if (i > 0) {
+      EXPECT_GE(fpr[i], fpr[i - 1]);
+    }
+  }
+  // Uses the whole budget, and beats uniform bits per key
+  EXPECT_NEAR(total_entries * 10, memory, total_entries * 0.01);
+  double uniform_fpr = std::exp(-10 * std::log(2) * std::log(2));
+  EXPECT_LT(fpr_sum, uniform_fpr * entries.size());
+}
+
+TEST(FilterAllocation, SmallBudget) {
+  // The last level is too large to be worth any bits
+  std::vector<double> entries = {10, 10, 100, 1e9};
+  auto fpr = AllocateFilterFpr(entries, 1000);
+  EXPECT_EQ(1, fpr[3]);
+  EXPECT_EQ(0, FilterBitsForFpr(fpr[3]));
+  double memory = 0;
+  for (size_t i = 0; i < entries.size(); ++i) {
+    EXPECT_LE(fpr[i], 1);
+    memory += entries[i] * FilterBitsForFpr(fpr[i]);
+  }
+  EXPECT_NEAR(1000, memory, 1);
+}
+
+TEST(FilterAllocation, MemoryBudget) {
+  const uint32_t kNumKeys = 20000;
+  std::unique_ptr<const FilterPolicy> read_policy(NewBloomFilterPolicy(10));
+  std::unique_ptr<Env> env(NewMemEnv(Env::Default()));
+  auto comparator = intComparator();
+
+  // About 10 bits per key, then too few bits for the largest level
+  for (size_t budget : {kNumKeys * 10 / 8, 1000u}) {
+    Options options;
+    options.env = env.get();
+    options.create_if_missing = true;
+    options.comparator = comparator.get();
+    options.write_buffer_size = 64 << 10;
+    options.filter_policy = read_policy.get();
+    options.filter_memory_budget = budget;
+
+    DB* db;
+    ASSERT_TRUE(
+        DB::Open(options, "/filterdb" + std::to_string(budget), &db).ok());
+    std::string key;
+    for (uint32_t i = 0; i < kNumKeys; ++i) {
+      key.clear();
+      PutFixed32(&key, i * 2);
+      ASSERT_TRUE(db->Put(WriteOptions(), key, std::string(100, 'v')).ok());
+    }
+    db->CompactRange(nullptr, nullptr);
+
+    std::string property;
+    ASSERT_TRUE(db->GetProperty("leveldb.filter-bits-per-key", &property));
+    std::istringstream bits_stream(property);
+    std::vector<int> bits;
+    int level_bits;
+    while (bits_stream >> level_bits) {
+      bits.push_back(level_bits);
+    }
+    ASSERT_EQ(7, bits.size());
+    int last = 6;
+    std::string files;
+    while (last > 0 &&
+           db->GetProperty("leveldb.num-files-at-level" + std::to_string(last),
+                           &files) &&
+           files == "0") {
+      --last;
+    }
+    if (budget > 1000) {
+      EXPECT_GE(bits[last], 6) << property;
+      EXPECT_LE(bits[last], 10) << property;
+      // The small levels above get more bits per key
+      EXPECT_GT(bits[0], bits[last]) << property;
+    } else {
+      EXPECT_EQ(0, bits[last]) << property;
+    }
+
+    std::string value;
+    for (uint32_t i = 0; i < kNumKeys * 2; ++i) {
+      key.clear();
+      PutFixed32(&key, i);
+      auto status = db->Get(ReadOptions(), key, &value);
+      EXPECT_EQ(i % 2 == 0, status.ok()) << i;
+    }
+    delete db;
+  }
+}
+
+// Counts the probes of the filters it reads
+class CountingFilterPolicy : public FilterPolicy {
+ public:
+  explicit CountingFilterPolicy(const FilterPolicy* policy)
+      : policy_(policy), probes_(0) {}
+
+  const char* Name() const override { return policy_->Name(); }
+
+  void CreateFilter(const Slice* keys, int n,
+                    std::string* dst) const override {
+    policy_->CreateFilter(keys, n, dst);
+  }
+
+  bool KeyMayMatch(const Slice& key, const Slice& filter) const override {
+    probes_++;
+    return policy_->KeyMayMatch(key, filter);
+  }
+
+  const FilterPolicy* NewWithBitsPerKey(int bits_per_key) const override {
+    return policy_->NewWithBitsPerKey(bits_per_key);
+  }
+
+  int probes() const { return probes_.load(); }
+
+ private:
+  const FilterPolicy* policy_;
+  mutable std::atomic<int> probes_;
+};
+
+TEST(FilterAllocation, MemoryBudgetOtherPolicy) {
+  const uint32_t kNumKeys = 20000;
+  std::unique_ptr<const FilterPolicy> blocked(NewBlockedBloomFilterPolicy(10));
+  CountingFilterPolicy read_policy(blocked.get());
+  std::unique_ptr<Env> env(NewMemEnv(Env::Default()));
+  auto comparator = intComparator();
+
+  Options options;
+  options.env = env.get();
+  options.create_if_missing = true;
+  options.comparator = comparator.get();
+  options.write_buffer_size = 64 << 10;
+  options.filter_policy = &read_policy;
+  options.filter_memory_budget = kNumKeys * 10 / 8;
+
+  DB* db;
+  ASSERT_TRUE(DB::Open(options, "/blockeddb", &db).ok());
+  std::string key;
+  for (uint32_t i = 0; i < kNumKeys; ++i) {
+    key.clear();
+    PutFixed32(&key, i * 2);
+    ASSERT_TRUE(db->Put(WriteOptions(), key, std::string(100, 'v')).ok());
+  }
+  db->CompactRange(nullptr, nullptr);
+
+  // The tables hold blocked bloom filters, which filter_policy reads
+  std::string value;
+  for (uint32_t i = 0; i < kNumKeys * 2; ++i) {
+    key.clear();
+    PutFixed32(&key, i);
+    auto status = db->Get(ReadOptions(), key, &value);
+    EXPECT_EQ(i % 2 == 0, status.ok()) << i;
+  }
+  EXPECT_GE(read_policy.probes(), kNumKeys);
+  delete db;
+
+  // Xor filters have a fixed size
+  std::unique_ptr<const FilterPolicy> xor_policy(NewXorFilterPolicy());
+  options.filter_policy = xor_policy.get();
+  Status s = DB::Open(options, "/xordb", &db);
+  ASSERT_TRUE(s.IsInvalidArgument()) << s.ToString();
+}
+
+// LevelDB test did not use gtest_main
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
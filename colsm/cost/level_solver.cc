@@ -0,0 +1,69 @@
+//
+// Created by harper on 10/19/26.
+//
+
+#include "level_solver.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace colsm {
+
+double LevelSolver::Solve(Parameter& param, const Workload& workload) {
+  return Solve(param, std::vector<Workload>(param.l, workload));
+}
+
+double LevelSolver::Solve(Parameter& param,
+                          const std::vector<Workload>& workloads) {
+  double total = 0;
+  param.level_results.clear();
+  for (int level = 0; level < param.l; ++level) {
+    const double vertical = LevelCost(param, workloads[level], level, true);
+    const double horizontal = LevelCost(param, workloads[level], level, false);
+    param.level_results.push_back(vertical <= horizontal);
+    total += std::min(vertical, horizontal);
+  }
+  return total;
+}
+
+double LevelSolver::SolveMergePolicy(Parameter& param,
+                                     const std::vector<Workload>& workloads) {
+  Parameter candidate = param;
+  double best = 0;
+  for (int m = param.l - 1; m >= 0; --m) {
+    candidate.m = m;
+    const double cost = Solve(candidate, workloads);
+    if (m == param.l - 1 || cost < best) {
+      best = cost;
+      param.m = m;
+      param.level_results = candidate.level_results;
+    }
+  }
+  return best;
+}
+
+void LevelSolver::SolveFanouts(Parameter& param,
+                               const std::vector<Workload>& workloads,
+                               int min_t, int max_t) {
+  Parameter candidate = param;
+  for (int level = 0; level < param.l; ++level) {
+    const Workload& workload = workloads[level];
+    if (workload.alpha + workload.beta + workload.gamma == 0) {
+      continue;
+    }
+    double best = 0;
+    for (int t = max_t; t >= min_t; --t) {
+      candidate.t[level] = t;
+      const double cost =
+          std::min(LevelCost(candidate, workload, level, true),
+                   LevelCost(candidate, workload, level, false)) /
+          std::log(t);
+      if (t == max_t || cost < best) {
+        best = cost;
+        param.t[level] = t;
+      }
+    }
+  }
+}
+
+}  // namespace colsm
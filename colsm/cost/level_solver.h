@@ -0,0 +1,64 @@
+//
+// Created by harper on 10/19/26.
+//
+
+#ifndef COLSM_COST_LEVEL_SOLVER_H
+#define COLSM_COST_LEVEL_SOLVER_H
+
+#include <vector>
+
+#include "cost_model.h"
+
+namespace colsm {
+
+/**
+ * Chooses the format of each level without a MIP library. The objective is
+ * the sum of LevelCost over the levels. It differs from the objective of
+ * CPlexSolver::SolveLevelDB in two ways: the cost of a run or a merge is
+ * clamped at zero, and levels from param.m on use leveling. With param.m
+ * >= param.l and fitted lines above zero for the block sizes, the two are
+ * the same. Each term depends only on the format of its own level, so
+ * choosing the cheaper format of every level on its own is optimal. It
+ * takes O(l) cost evaluations, cheap enough to run inside the DB.
+ */
+class LevelSolver {
+ public:
+  /**
+   * Fills param.level_results with the format of each level, true for
+   * vertical, as CPlexSolver::Solve does for its objective. A tie picks
+   * vertical.
+   * @return the minimal cost
+   */
+  double Solve(Parameter& param, const Workload& workload);
+
+  /**
+   * Same with the workload served by each level
+   * REQUIRES: workloads.size() >= param.l
+   */
+  double Solve(Parameter& param, const std::vector<Workload>& workloads);
+
+  /**
+   * Also chooses param.m, the first level using leveling, among
+   * 0..param.l-1, by solving the formats for each value of it. The last
+   * level always uses leveling, as nothing would merge its runs. A tie
+   * picks the larger m.
+   * REQUIRES: workloads.size() >= param.l
+   */
+  double SolveMergePolicy(Parameter& param,
+                          const std::vector<Workload>& workloads);
+
+  /**
+   * Chooses param.t, the size ratio of each level to the one above it,
+   * among min_t..max_t. A tree grows by a factor of t with one more level,
+   * so each level is charged LevelCost / ln(t) in its cheaper format, the
+   * cost per unit of growth. Costs the fitted coefficients put below zero
+   * count as zero. A tie picks the larger t, levels without a workload
+   * keep theirs.
+   * REQUIRES: workloads.size() >= param.l, 2 <= min_t <= max_t
+   */
+  void SolveFanouts(Parameter& param, const std::vector<Workload>& workloads,
+                    int min_t, int max_t);
+};
+
+}  // namespace colsm
+#endif  // COLSM_COST_LEVEL_SOLVER_H
@@ -0,0 +1,218 @@
+//
+// Created by harper on 10/19/26.
+//
+
+#include "level_solver.h"
+
+#include <algorithm>
+#include <cmath>
+#include <gtest/gtest.h>
+
+using namespace colsm;
+
+// The objective LevelSolver minimizes for a given assignment with every
+// level tiered: that of CPlexSolver::SolveLevelDB, with the cost of a run
+// or a merge clamped at zero
+static double Objective(const Parameter& param, const Workload& workload,
+                        const std::vector<bool>& vertical) {
+  double p = 0, r = 0, u = 0;
+  for (int i = 0; i < param.l; ++i) {
+    const int var = vertical[i] ? 1 : 0;
+    const double lookup = std::max(
+        (var * param.v_epsilon + (1 - var) * param.h_epsilon) *
+                std::log(param.b[i]) +
+            var * param.v_eta + (1 - var) * param.h_eta,
+        0.0);
+    p += param.t[i] * param.fpr[i] * lookup;
+    r += param.t[i] *
+         std::max(param.fpr[i] * lookup + var * param.rv + (1 - var) * param.rh,
+                  0.0);
+    u += std::max((var * param.v_mu + (1 - var) * param.h_mu) +
+                      (var * param.v_xi + (1 - var) * param.h_xi) / param.b[i],
+                  0.0);
+  }
+  return workload.alpha * p + workload.beta * r + workload.gamma * u;
+}
+
+// The objective of CPlexSolver::SolveLevelDB for a given assignment, as
+// written there
+static double CplexObjective(const Parameter& param, const Workload& workload,
+                             const std::vector<bool>& vertical) {
+  double p = 0, r = 0, u = 0;
+  for (int i = 0; i < param.l; ++i) {
+    const int var = vertical[i] ? 1 : 0;
+    p += param.t[i] * param.fpr[i] *
+         ((var * param.v_epsilon + (1 - var) * param.h_epsilon) *
+              std::log(param.b[i]) +
+          var * param.v_eta + (1 - var) * param.h_eta);
+    r += param.t[i] *
+         (param.fpr[i] * ((var * param.v_epsilon + (1 - var) * param.h_epsilon) *
+                              std::log(param.b[i]) +
+                          var * param.v_eta + (1 - var) * param.h_eta) +
+          var * param.rv + (1 - var) * param.rh);
+    u += (var * param.v_mu + (1 - var) * param.h_mu) +
+         (var * param.v_xi + (1 - var) * param.h_xi) / param.b[i];
+  }
+  return workload.alpha * p + workload.beta * r + workload.gamma * u;
+}
+
+static std::vector<bool> Assignment(int levels, uint32_t bits) {
+  std::vector<bool> vertical;
+  for (int i = 0; i < levels; ++i) {
+    vertical.push_back((bits >> i) & 1);
+  }
+  return vertical;
+}
+
+static const Workload kWorkloads[] = {
+    {1, 0, 0},     {0, 1, 0},       {0, 0, 1},     {0.5, 0, 0.5},
+    {0.2, 0.3, 0.5}, {0.9, 0.05, 0.05}, {0.01, 0, 0.99}};
+
+TEST(LevelSolver, SameAsExhaustiveSearch) {
+  Parameter param = DefaultParameter();
+  LevelSolver solver;
+  for (double factor = 0.2; factor <= 3; factor += 0.1) {
+    param.v_epsilon = factor * param.h_epsilon;
+    param.v_eta = factor * param.h_eta;
+    for (const Workload& workload : kWorkloads) {
+      double best = 0;
+      for (uint32_t bits = 0; bits < (1u << param.l); ++bits) {
+        const double cost =
+            Objective(param, workload, Assignment(param.l, bits));
+        if (bits == 0 || cost < best) {
+          best = cost;
+        }
+      }
+
+      const double cost = solver.Solve(param, workload);
+      ASSERT_EQ(param.l, param.level_results.size());
+      EXPECT_NEAR(best, cost, 1e-6 * std::fabs(best));
+      EXPECT_NEAR(best, Objective(param, workload, param.level_results),
+                  1e-6 * std::fabs(best));
+    }
+  }
+}
+
+TEST(LevelSolver, SameAsCplex) {
+  // Every level tiered, as in CPlexSolver::SolveLevelDB, and blocks large
+  // enough that the fitted lines are above zero, so nothing is clamped
+  Parameter param = DefaultParameter();
+  param.m = param.l;
+  for (int i = 0; i < param.l; ++i) {
+    param.b[i] = 150000 << (2 * i);
+  }
+  LevelSolver solver;
+  for (double factor = 0.2; factor <= 3; factor += 0.1) {
+    param.v_epsilon = factor * param.h_epsilon;
+    param.v_eta = factor * param.h_eta;
+    for (const Workload& workload : kWorkloads) {
+      double best = 0;
+      for (uint32_t bits = 0; bits < (1u << param.l); ++bits) {
+        const double cost =
+            CplexObjective(param, workload, Assignment(param.l, bits));
+        if (bits == 0 || cost < best) {
+          best = cost;
+        }
+      }
+
+      const double cost = solver.Solve(param, workload);
+      EXPECT_NEAR(best, cost, 1e-6 * std::fabs(best)) << factor;
+      EXPECT_NEAR(best, CplexObjective(param, workload, param.level_results),
+                  1e-6 * std::fabs(best))
+          << factor;
+    }
+  }
+}
+
+TEST(LevelSolver, MergePolicy) {
+  Parameter param = DefaultParameter();
+  LevelSolver solver;
+  for (const Workload& workload : kWorkloads) {
+    std::vector<Workload> workloads(param.l, workload);
+    double best = 0;
+    for (int m = 0; m < param.l; ++m) {
+      Parameter candidate = param;
+      candidate.m = m;
+      for (uint32_t bits = 0; bits < (1u << param.l); ++bits) {
+        double cost = 0;
+        auto vertical = Assignment(param.l, bits);
+        for (int level = 0; level < param.l; ++level) {
+          cost += LevelCost(candidate, workload, level, vertical[level]);
+        }
+        if ((m == 0 && bits == 0) || cost < best) {
+          best = cost;
+        }
+      }
+    }
+
+    Parameter solved = param;
+    const double cost = solver.SolveMergePolicy(solved, workloads);
+    EXPECT_NEAR(best, cost, 1e-6 * std::fabs(best));
+    EXPECT_EQ(param.l, solved.level_results.size());
+  }
+
+  // Leveling saves lookups on the large levels, tiering saves updates.
+  // Lookups in the small blocks of level 0 cost nothing, so tiering it
+  // ties with leveling, and the tie picks the larger m.
+  std::vector<Workload> lookups(param.l, Workload{1, 0, 0});
+  Parameter leveled = param;
+  leveled.m = 0;
+  Parameter tiered_top = param;
+  tiered_top.m = 1;
+  EXPECT_EQ(solver.Solve(leveled, lookups), solver.Solve(tiered_top, lookups));
+  solver.SolveMergePolicy(param, lookups);
+  EXPECT_EQ(1, param.m);
+  std::vector<Workload> updates(param.l, Workload{0, 0, 1});
+  solver.SolveMergePolicy(param, updates);
+  EXPECT_EQ(param.l - 1, param.m);
+}
+
+TEST(LevelSolver, CostsAreNotNegative) {
+  // The fitted lines are below zero for the blocks of level 0
+  Parameter param = DefaultParameter();
+  for (int m = 0; m <= param.l; ++m) {
+    param.m = m;
+    for (const Workload& workload : kWorkloads) {
+      for (int level = 0; level < param.l; ++level) {
+        EXPECT_GE(LevelCost(param, workload, level, true), 0);
+        EXPECT_GE(LevelCost(param, workload, level, false), 0);
+      }
+    }
+  }
+}
+
+TEST(LevelSolver, Fanouts) {
+  Parameter param = DefaultParameter();
+  param.m = 0;
+  LevelSolver solver;
+  std::vector<Workload> workloads(param.l, Workload{0, 0, 0});
+  workloads[2] = Workload{0, 0, 1};
+  workloads[3] = Workload{1, 0, 0};
+  workloads[4] = Workload{0.5, 0.2, 0.3};
+  solver.SolveFanouts(param, workloads, 2, 16);
+
+  // Updates are merged t times into a level, lookups probe a run per level
+  EXPECT_EQ(10, param.t[1]);
+  EXPECT_EQ(3, param.t[2]);
+  EXPECT_EQ(16, param.t[3]);
+  for (int level = 2; level <= 4; ++level) {
+    Parameter candidate = param;
+    for (int t = 2; t <= 16; ++t) {
+      candidate.t[level] = t;
+      const double cost =
+          std::min(LevelCost(candidate, workloads[level], level, true),
+                   LevelCost(candidate, workloads[level], level, false)) /
+          std::log(t);
+      const double chosen =
+          std::min(LevelCost(param, workloads[level], level, true),
+                   LevelCost(param, workloads[level], level, false)) /
+          std::log(param.t[level]);
+      EXPECT_LE(chosen, cost + 1e-9);
+    }
+  }
+}
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
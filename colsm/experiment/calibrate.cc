@@ -0,0 +1,214 @@
+//
+// Created by harper on 10/19/26.
+//
+// Measures the costs of the cost model on this host and writes them to a
+// parameter file for Options::cost_parameter_file. The lookup, scan and merge
+// loops are those of vert_block_read_benchmark, vert_block_range_benchmark and
+// block_runner, run against blocks of growing size:
+//   - a lookup costs epsilon * ln(n) + eta ns in a block of n entries
+//   - a scan costs r ns per entry
+//   - merging two blocks into one of n entries costs mu + xi / n ns per entry
+//
+// Usage: colsm_calibrate [output file, default colsm_parameters]
+//
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "leveldb/comparator.h"
+#include "leveldb/env.h"
+#include "leveldb/options.h"
+
+#include "table/block.h"
+#include "table/block_builder.h"
+#include "table/format.h"
+
+#include "colsm/comparators.h"
+#include "colsm/cost/cost_model.h"
+#include "colsm/vblock/sortmerge_iterator.h"
+#include "colsm/vblock/vert_block.h"
+#include "colsm/vblock/vert_block_builder.h"
+
+using namespace std;
+using namespace leveldb;
+using namespace colsm;
+
+static const int kValueLength = 64;
+static const int kLookups = 20000;
+static const int kScanLength = 100;
+
+// Keys are 12-byte internal keys. Horizontal blocks compare them bytewise, so
+// the int is stored big endian; vertical blocks take it little endian.
+static void EncodeKey(uint32_t key, bool vertical, char* buffer) {
+  if (vertical) {
+    memcpy(buffer, &key, 4);
+  } else {
+    for (int i = 0; i < 4; ++i) {
+      buffer[i] = static_cast<char>(key >> (24 - 8 * i));
+    }
+  }
+  memset(buffer + 4, 0, 8);
+}
+
+static BlockContents Copy(Slice data) {
+  char* copied = new char[data.size()];
+  memcpy(copied, data.data(), data.size());
+  return BlockContents{Slice(copied, data.size()), true, true};
+}
+
+static unique_ptr<BlockBuilder> NewBuilder(const Options* options,
+                                           bool vertical) {
+  if (vertical) {
+    return unique_ptr<BlockBuilder>(new VertBlockBuilder(options, LENGTH));
+  }
+  return unique_ptr<BlockBuilder>(new BlockBuilder(options));
+}
+
+// Block with the keys first, first + step, ...
+static unique_ptr<BlockCore> BuildBlock(const Options* options, bool vertical,
+                                        uint32_t num_entry, uint32_t first,
+                                        uint32_t step) {
+  auto builder = NewBuilder(options, vertical);
+  char key[12];
+  char value[kValueLength];
+  memset(value, 'v', kValueLength);
+  for (uint32_t i = 0; i < num_entry; ++i) {
+    EncodeKey(first + i * step, vertical, key);
+    builder->Add(Slice(key, 12), Slice(value, kValueLength));
+  }
+  BlockContents contents = Copy(builder->Finish());
+  if (vertical) {
+    return unique_ptr<BlockCore>(new VertBlockCore(contents));
+  }
+  return unique_ptr<BlockCore>(new BasicBlockCore(contents));
+}
+
+static double NanosSince(chrono::steady_clock::time_point start) {
+  return chrono::duration<double, nano>(chrono::steady_clock::now() - start)
+      .count();
+}
+
+struct Measure {
+  const Comparator* comparator;
+  bool vertical;
+  // Per block size
+  vector<double> log_sizes;
+  vector<double> lookup_ns;
+  vector<double> inverse_sizes;
+  vector<double> merge_ns;
+  vector<double> scan_ns;
+};
+
+static void MeasureBlock(Measure* measure, uint32_t num_entry,
+                         mt19937* random) {
+  Options options;
+  options.comparator = measure->comparator;
+  auto block = BuildBlock(&options, measure->vertical, num_entry, 0, 1);
+  const Comparator* iter_comparator =
+      measure->vertical ? nullptr : measure->comparator;
+
+  vector<uint32_t> targets;
+  for (int i = 0; i < kLookups; ++i) {
+    targets.push_back((*random)() % (num_entry - kScanLength));
+  }
+  char key[12];
+
+  auto start = chrono::steady_clock::now();
+  for (uint32_t target : targets) {
+    unique_ptr<Iterator> iter(block->NewIterator(iter_comparator));
+    EncodeKey(target, measure->vertical, key);
+    iter->Seek(Slice(key, 12));
+    if (!iter->Valid()) {
+      cerr << "Lookup missed key " << target << '\n';
+    }
+  }
+  const double lookup = NanosSince(start) / kLookups;
+
+  start = chrono::steady_clock::now();
+  for (uint32_t target : targets) {
+    unique_ptr<Iterator> iter(block->NewIterator(iter_comparator));
+    EncodeKey(target, measure->vertical, key);
+    iter->Seek(Slice(key, 12));
+    for (int i = 0; i < kScanLength && iter->Valid(); ++i) {
+      iter->Next();
+    }
+  }
+  // Time per entry past the seek
+  const double scan = (NanosSince(start) / kLookups - lookup) / kScanLength;
+
+  // Merge two halves with interleaved keys into one block
+  auto left = BuildBlock(&options, measure->vertical, num_entry / 2, 0, 2);
+  auto right = BuildBlock(&options, measure->vertical, num_entry / 2, 1, 2);
+  start = chrono::steady_clock::now();
+  {
+    auto builder = NewBuilder(&options, measure->vertical);
+    Iterator* left_iter = left->NewIterator(iter_comparator);
+    Iterator* right_iter = right->NewIterator(iter_comparator);
+    left_iter->SeekToFirst();
+    right_iter->SeekToFirst();
+    unique_ptr<Iterator> merged(
+        sortMergeIterator(measure->comparator, left_iter, right_iter));
+    for (; merged->Valid(); merged->Next()) {
+      builder->Add(merged->key(), merged->value());
+    }
+    builder->Finish();
+  }
+  const double merge = NanosSince(start) / num_entry;
+
+  measure->log_sizes.push_back(std::log(num_entry));
+  measure->lookup_ns.push_back(lookup);
+  measure->inverse_sizes.push_back(1.0 / num_entry);
+  measure->merge_ns.push_back(merge);
+  measure->scan_ns.push_back(scan);
+
+  cout << (measure->vertical ? "vertical" : "horizontal") << ',' << num_entry
+       << ',' << lookup << ',' << scan << ',' << merge << '\n';
+}
+
+static double Mean(const vector<double>& values) {
+  double sum = 0;
+  for (double value : values) {
+    sum += value;
+  }
+  return sum / values.size();
+}
+
+int main(int argc, char** argv) {
+  const std::string output = argc > 1 ? argv[1] : "colsm_parameters";
+
+  auto int_comparator = intComparator();
+  Measure vertical{int_comparator.get(), true};
+  Measure horizontal{BytewiseComparator(), false};
+
+  mt19937 random(301);
+  cout << "format,entries,lookup_ns,scan_ns,merge_ns\n";
+  for (uint32_t num_entry = 1 << 10; num_entry <= (1 << 20); num_entry <<= 2) {
+    MeasureBlock(&vertical, num_entry, &random);
+    MeasureBlock(&horizontal, num_entry, &random);
+  }
+
+  // Sizes and ratios keep their defaults, only the costs are measured
+  Parameter param = DefaultParameter();
+  FitLine(vertical.log_sizes, vertical.lookup_ns, &param.v_epsilon,
+          &param.v_eta);
+  FitLine(horizontal.log_sizes, horizontal.lookup_ns, &param.h_epsilon,
+          &param.h_eta);
+  param.rv = Mean(vertical.scan_ns);
+  param.rh = Mean(horizontal.scan_ns);
+  FitLine(vertical.inverse_sizes, vertical.merge_ns, &param.v_xi,
+          &param.v_mu);
+  FitLine(horizontal.inverse_sizes, horizontal.merge_ns, &param.h_xi,
+          &param.h_mu);
+
+  Status s = WriteParameterFile(Env::Default(), output, param);
+  if (!s.ok()) {
+    cerr << s.ToString() << '\n';
+    return 1;
+  }
+  cout << "Wrote " << output << '\n';
+  return 0;
+}
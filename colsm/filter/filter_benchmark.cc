@@ -0,0 +1,100 @@
+//
+// Created by harper on 10/19/26.
+//
+
+#include <benchmark/benchmark.h>
+#include <leveldb/filter_policy.h>
+#include <leveldb/slice.h>
+
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace leveldb;
+
+// Keys of a filter in a table, and negative lookups of a deep level
+static const int NUM_KEY = 100000;
+static const int NUM_PROBE = 100000;
+
+struct FilterData {
+  std::vector<uint32_t> keys;
+  std::vector<uint32_t> probes;
+
+  FilterData() {
+    std::mt19937 rand(0);
+    for (int i = 0; i < NUM_KEY; ++i) {
+      keys.push_back(rand() & ~1u);
+    }
+    for (int i = 0; i < NUM_PROBE; ++i) {
+      probes.push_back(rand() | 1u);
+    }
+  }
+};
+
+static FilterData DATA;
+
+static const FilterPolicy* NewPolicy(int type) {
+  switch (type) {
+    case 0:
+      return NewBloomFilterPolicy(10);
+    case 1:
+      return NewBlockedBloomFilterPolicy(10);
+    default:
+      return NewXorFilterPolicy();
+  }
+}
+
+static std::string BuildFilter(const FilterPolicy* policy) {
+  std::vector<Slice> slices;
+  for (auto& key : DATA.keys) {
+    slices.emplace_back((const char*)&key, 4);
+  }
+  std::string filter;
+  policy->CreateFilter(slices.data(), slices.size(), &filter);
+  return filter;
+}
+
+void FilterBuild(benchmark::State& state) {
+  std::unique_ptr<const FilterPolicy> policy(NewPolicy(state.range(0)));
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(BuildFilter(policy.get()));
+  }
+  state.SetLabel(policy->Name());
+}
+
+void FilterNegativeLookup(benchmark::State& state) {
+  std::unique_ptr<const FilterPolicy> policy(NewPolicy(state.range(0)));
+  auto filter = BuildFilter(policy.get());
+  int false_positive = 0;
+  for (auto _ : state) {
+    false_positive = 0;
+    for (auto& probe : DATA.probes) {
+      false_positive += policy->KeyMayMatch(Slice((const char*)&probe, 4), filter);
+    }
+  }
+  state.SetLabel(policy->Name());
+  state.counters["bits_per_key"] = filter.size() * 8.0 / NUM_KEY;
+  state.counters["fpr"] = (double)false_positive / NUM_PROBE;
+  state.SetItemsProcessed(state.iterations() * NUM_PROBE);
+}
+
+void FilterBatchLookup(benchmark::State& state) {
+  std::unique_ptr<const FilterPolicy> policy(NewPolicy(state.range(0)));
+  auto filter = BuildFilter(policy.get());
+  std::vector<Slice> slices;
+  for (auto& probe : DATA.probes) {
+    slices.emplace_back((const char*)&probe, 4);
+  }
+  std::unique_ptr<bool[]> results(new bool[NUM_PROBE]);
+  for (auto _ : state) {
+    policy->KeysMayMatch(slices.data(), NUM_PROBE, filter, results.get());
+    benchmark::DoNotOptimize(results.get());
+  }
+  state.SetLabel(policy->Name());
+  state.SetItemsProcessed(state.iterations() * NUM_PROBE);
+}
+
+BENCHMARK(FilterBuild)->DenseRange(0, 2);
+BENCHMARK(FilterNegativeLookup)->DenseRange(0, 2);
+BENCHMARK(FilterBatchLookup)->DenseRange(0, 2);
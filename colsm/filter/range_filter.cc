@@ -0,0 +1,105 @@
+//
+// Created by harper on 10/19/26.
+//
+
+#include "range_filter.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "util/coding.h"
+
+namespace colsm {
+
+static const uint32_t kHeaderSize = 16;
+
+static inline uint64_t LoadWord(const char* bitmap, uint64_t index) {
+  uint64_t word;
+  memcpy(&word, bitmap + index * 8, 8);
+  return word;
+}
+
+RangeFilterBuilder::RangeFilterBuilder(int bits_per_key)
+    : bits_per_key_(bits_per_key) {}
+
+Slice RangeFilterBuilder::Finish() {
+  result_.clear();
+  if (keys_.empty()) {
+    return Slice(result_);
+  }
+  uint32_t key_min = *std::min_element(keys_.begin(), keys_.end());
+  uint32_t key_max = *std::max_element(keys_.begin(), keys_.end());
+
+  // Widen the buckets until the domain fits in the bitmap budget
+  uint64_t budget = std::max<uint64_t>(
+      64, static_cast<uint64_t>(keys_.size()) * std::max(bits_per_key_, 1));
+  uint8_t shift = 0;
+  while ((static_cast<uint64_t>(key_max - key_min) >> shift) >= budget) {
+    shift++;
+  }
+  uint64_t num_bucket = (static_cast<uint64_t>(key_max - key_min) >> shift) + 1;
+  uint64_t num_word = (num_bucket + 63) / 64;
+
+  std::vector<uint64_t> bitmap(num_word, 0);
+  for (auto key : keys_) {
+    uint64_t bucket = (key - key_min) >> shift;
+    bitmap[bucket >> 6] |= 1ULL << (bucket & 63);
+  }
+
+  result_.resize(kHeaderSize, 0);
+  EncodeFixed32(&result_[0], key_min);
+  EncodeFixed32(&result_[4], key_max);
+  result_[8] = static_cast<char>(shift);
+  result_.append(reinterpret_cast<const char*>(bitmap.data()), num_word * 8);
+  keys_.clear();
+  return Slice(result_);
+}
+
+RangeFilter::RangeFilter(const Slice& contents)
+    : valid_(false), key_min_(0), key_max_(0), shift_(0), bitmap_(nullptr) {
+  if (contents.size() < kHeaderSize) {
+    return;
+  }
+  key_min_ = DecodeFixed32(contents.data());
+  key_max_ = DecodeFixed32(contents.data() + 4);
+  shift_ = static_cast<uint8_t>(contents[8]);
+  if (key_max_ < key_min_ || shift_ >= 32) {
+    return;
+  }
+  uint64_t num_bucket = (static_cast<uint64_t>(key_max_ - key_min_) >> shift_) + 1;
+  if (contents.size() - kHeaderSize < (num_bucket + 63) / 64 * 8) {
+    return;
+  }
+  bitmap_ = contents.data() + kHeaderSize;
+  valid_ = true;
+}
+
+bool RangeFilter::RangeMayMatch(uint32_t low, uint32_t high) const {
+  if (!valid_) {
+    return true;
+  }
+  if (low > high || high < key_min_ || low > key_max_) {
+    return false;
+  }
+  uint64_t begin = (std::max(low, key_min_) - key_min_) >> shift_;
+  uint64_t end = (std::min(high, key_max_) - key_min_) >> shift_;
+
+  uint64_t begin_word = begin >> 6;
+  uint64_t end_word = end >> 6;
+  uint64_t begin_mask = ~0ULL << (begin & 63);
+  uint64_t end_mask = ~0ULL >> (63 - (end & 63));
+  if (begin_word == end_word) {
+    return LoadWord(bitmap_, begin_word) & begin_mask & end_mask;
+  }
+  if (LoadWord(bitmap_, begin_word) & begin_mask) {
+    return true;
+  }
+  for (uint64_t i = begin_word + 1; i < end_word; ++i) {
+    if (LoadWord(bitmap_, i)) {
+      return true;
+    }
+  }
+  return LoadWord(bitmap_, end_word) & end_mask;
+}
+
+}  // namespace colsm
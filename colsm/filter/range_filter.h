@@ -0,0 +1,77 @@
+//
+// Created by harper on 10/19/26.
+//
+//
+// A range filter answers whether a table may contain any int key in a given
+// range, so short scans can skip tables that have nothing to offer.
+//
+// The filter is a truncated prefix bitmap: the key domain [key_min, key_max]
+// of the table is cut into equal-width buckets, and one bit records whether
+// a bucket is occupied. The bucket width is chosen such that the bitmap has
+// about bits_per_key bits for each key. A range query is answered by testing
+// the bits of the buckets it covers, so there is no false negative, and false
+// positives only come from the buckets partially covered by the range. The
+// data format is as following:
+//
+//    key_min  : uint32_t
+//    key_max  : uint32_t
+//    shift    : uint8_t   (bucket = (key - key_min) >> shift)
+//    reserved : uint8_t {7}
+//    bitmap   : uint64_t {(num_bucket + 63) / 64}
+//
+// Keys are the 4-byte user keys of vertical tables, compared as unsigned ints.
+
+#ifndef LEVELDB_RANGE_FILTER_H
+#define LEVELDB_RANGE_FILTER_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "leveldb/slice.h"
+
+using namespace leveldb;
+namespace colsm {
+
+class RangeFilterBuilder {
+ public:
+  explicit RangeFilterBuilder(int bits_per_key);
+
+  RangeFilterBuilder(const RangeFilterBuilder&) = delete;
+
+  RangeFilterBuilder& operator=(const RangeFilterBuilder&) = delete;
+
+  void AddKey(uint32_t key) { keys_.push_back(key); }
+
+  Slice Finish();
+
+ private:
+  const int bits_per_key_;
+  std::vector<uint32_t> keys_;
+  std::string result_;
+};
+
+class RangeFilter {
+ public:
+  // contents must remain live while the filter is in use
+  explicit RangeFilter(const Slice& contents);
+
+  RangeFilter(const RangeFilter&) = delete;
+
+  RangeFilter& operator=(const RangeFilter&) = delete;
+
+  // Return false only if no key in [low, high] was added. A malformed filter
+  // always returns true.
+  bool RangeMayMatch(uint32_t low, uint32_t high) const;
+
+ private:
+  bool valid_;
+  uint32_t key_min_;
+  uint32_t key_max_;
+  uint8_t shift_;
+  const char* bitmap_;
+};
+
+}  // namespace colsm
+
+#endif  // LEVELDB_RANGE_FILTER_H
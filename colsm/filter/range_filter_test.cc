@@ -0,0 +1,178 @@
+//
+// Created by harper on 10/19/26.
+//
+
+#include "range_filter.h"
+
+#include <colsm/comparators.h>
+#include <gtest/gtest.h>
+
+#include "leveldb/db.h"
+#include "leveldb/env.h"
+#include "leveldb/table.h"
+#include "leveldb/table_builder.h"
+
+#include "db/dbformat.h"
+#include "helpers/memenv/memenv.h"
+#include "util/coding.h"
+
+using namespace colsm;
+
+namespace {
+std::string IntKey(uint32_t key) {
+  std::string result;
+  PutFixed32(&result, key);
+  return result;
+}
+}  // namespace
+
+TEST(RangeFilter, Exact) {
+  RangeFilterBuilder builder(10);
+  for (uint32_t i = 0; i < 100; ++i) {
+    builder.AddKey(1000 + i * 10);
+  }
+  auto content = builder.Finish();
+  RangeFilter filter(content);
+
+  // Small domain, one bucket per key value
+  for (uint32_t i = 0; i < 100; ++i) {
+    EXPECT_TRUE(filter.RangeMayMatch(1000 + i * 10, 1000 + i * 10));
+    EXPECT_TRUE(filter.RangeMayMatch(995 + i * 10, 1005 + i * 10));
+    EXPECT_FALSE(filter.RangeMayMatch(1001 + i * 10, 1009 + i * 10));
+  }
+  EXPECT_FALSE(filter.RangeMayMatch(0, 999));
+  EXPECT_FALSE(filter.RangeMayMatch(1991, UINT32_MAX));
+  EXPECT_TRUE(filter.RangeMayMatch(0, UINT32_MAX));
+  EXPECT_FALSE(filter.RangeMayMatch(1500, 1400));
+}
+
+TEST(RangeFilter, NoFalseNegative) {
+  RangeFilterBuilder builder(8);
+  std::vector<uint32_t> keys;
+  uint32_t key = 7;
+  for (uint32_t i = 0; i < 10000; ++i) {
+    key += 1 + (key * 2654435761u) % 100000;
+    keys.push_back(key);
+    builder.AddKey(key);
+  }
+  auto content = builder.Finish();
+  RangeFilter filter(content);
+
+  for (auto k : keys) {
+    EXPECT_TRUE(filter.RangeMayMatch(k, k));
+    EXPECT_TRUE(filter.RangeMayMatch(k - 50, k));
+    EXPECT_TRUE(filter.RangeMayMatch(k, k + 50));
+  }
+  // Empty gaps of short scans are mostly rejected
+  uint32_t rejected = 0;
+  for (uint32_t i = 1; i < keys.size(); ++i) {
+    if (keys[i] - keys[i - 1] > 1000) {
+      rejected += !filter.RangeMayMatch(keys[i - 1] + 300, keys[i - 1] + 400);
+    }
+  }
+  EXPECT_GT(rejected, 0);
+}
+
+TEST(RangeFilter, Malformed) {
+  RangeFilter filter(Slice("abc"));
+  EXPECT_TRUE(filter.RangeMayMatch(0, 10));
+}
+
+TEST(RangeFilter, TablePruning) {
+  std::unique_ptr<Env> env(NewMemEnv(Env::Default()));
+  auto int_comparator = intComparator();
+  InternalKeyComparator internal_comparator(int_comparator.get());
+  Options options;
+  options.env = env.get();
+  options.comparator = &internal_comparator;
+  options.range_filter_bits_per_key = 10;
+
+  WritableFile* file;
+  ASSERT_TRUE(env->NewWritableFile("/table", &file).ok());
+  TableBuilder builder(options, true, file);
+  for (uint32_t i = 0; i < 1000; ++i) {
+    InternalKey key(IntKey(10000 + i * 2), 100, kTypeValue);
+    builder.Add(key.Encode(), "value");
+  }
+  ASSERT_TRUE(builder.Finish().ok());
+  uint64_t file_size = builder.FileSize();
+  ASSERT_TRUE(file->Close().ok());
+  delete file;
+
+  RandomAccessFile* source;
+  ASSERT_TRUE(env->NewRandomAccessFile("/table", &source).ok());
+  Table* table;
+  ASSERT_TRUE(Table::Open(options, source, file_size, &table).ok());
+
+  auto lower = IntKey(100);
+  auto upper = IntKey(9000);
+  Slice lower_slice(lower);
+  Slice upper_slice(upper);
+  ReadOptions read_options;
+  read_options.iterate_lower_bound = &lower_slice;
+  read_options.iterate_upper_bound = &upper_slice;
+  Iterator* iter = table->NewIterator(read_options);
+  iter->SeekToFirst();
+  EXPECT_FALSE(iter->Valid());
+  delete iter;
+
+  upper = IntKey(10001);
+  upper_slice = Slice(upper);
+  iter = table->NewIterator(read_options);
+  iter->SeekToFirst();
+  ASSERT_TRUE(iter->Valid());
+  ParsedInternalKey pkey;
+  ASSERT_TRUE(ParseInternalKey(iter->key(), &pkey));
+  EXPECT_EQ(10000, DecodeFixed32(pkey.user_key.data()));
+  delete iter;
+
+  delete table;
+  delete source;
+}
+
+TEST(RangeFilter, BoundedIterator) {
+  std::unique_ptr<Env> env(NewMemEnv(Env::Default()));
+  auto int_comparator = intComparator();
+  Options options;
+  options.env = env.get();
+  options.create_if_missing = true;
+  options.comparator = int_comparator.get();
+  options.range_filter_bits_per_key = 10;
+
+  DB* db;
+  ASSERT_TRUE(DB::Open(options, "/rangedb", &db).ok());
+  for (uint32_t i = 0; i < 2000; ++i) {
+    ASSERT_TRUE(db->Put(WriteOptions(), IntKey(i * 3), "value").ok());
+  }
+  db->CompactRange(nullptr, nullptr);
+  ASSERT_TRUE(db->Delete(WriteOptions(), IntKey(300)).ok());
+
+  auto lower = IntKey(298);
+  auto upper = IntKey(310);
+  Slice lower_slice(lower);
+  Slice upper_slice(upper);
+  ReadOptions read_options;
+  read_options.iterate_lower_bound = &lower_slice;
+  read_options.iterate_upper_bound = &upper_slice;
+  Iterator* iter = db->NewIterator(read_options);
+
+  std::vector<uint32_t> forward;
+  for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+    forward.push_back(DecodeFixed32(iter->key().data()));
+  }
+  EXPECT_EQ(std::vector<uint32_t>({303, 306, 309}), forward);
+
+  // Seek back into the same data block
+  iter->Seek(IntKey(0));
+  ASSERT_TRUE(iter->Valid());
+  EXPECT_EQ(303, DecodeFixed32(iter->key().data()));
+  ASSERT_TRUE(iter->status().ok());
+  delete iter;
+  delete db;
+}
+
+// LevelDB test did not use gtest_main
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
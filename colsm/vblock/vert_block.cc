@@ -63,18 +63,15 @@ int eq_packed(const uint8_t* data, uint32_t num_entry, uint8_t bitwidth,
 
 int geq(const uint8_t* data, uint32_t num_entry, uint32_t target) {
   uint32_t* data32 = (uint32_t*)data;
+  // Lower bound, as versions of a key are stored as equal entries
   uint32_t begin = 0;
-  uint32_t end = num_entry - 1;
-  while (begin <= end) {
-    auto current = (begin + end + 1) / 2;
-    uint32_t extracted = data32[current];
-    if (extracted == target) {
-      return current;
-    }
-    if (extracted > target) {
-      end = current - 1;
-    } else {
+  uint32_t end = num_entry;
+  while (begin < end) {
+    auto current = (begin + end) / 2;
+    if (data32[current] < target) {
       begin = current + 1;
+    } else {
+      end = current;
     }
   }
   return begin;
@@ -91,9 +88,9 @@ int geq_packed(const uint8_t* data, uint32_t num_entry, uint8_t bitwidth,
     return num_entry;
   }
   uint32_t begin = 0;
-  uint32_t end = num_entry - 1;
-  while (begin <= end) {
-    auto current = (begin + end + 1) / 2;
+  uint32_t end = num_entry;
+  while (begin < end) {
+    auto current = (begin + end) / 2;
 
     auto bits = current * bitwidth;
     auto index = bits >> 3;
@@ -101,13 +98,10 @@ int geq_packed(const uint8_t* data, uint32_t num_entry, uint8_t bitwidth,
 
     uint32_t extracted = (*(uint64_t*)(data + index) >> offset) & mask;
 
-    if (extracted == target) {
-      return current;
-    }
-    if (extracted > target) {
-      end = current - 1;
-    } else {
+    if (extracted < target) {
       begin = current + 1;
+    } else {
+      end = current;
     }
   }
   return begin;
@@ -372,10 +366,10 @@ class VertBlockCore::VIter : public Iterator {
     // Scan through blocks
     uint32_t target_key = *reinterpret_cast<const uint32_t*>(target.data());
 
-    auto new_section_index = meta_.Search(target_key);
-    if (new_section_index != section_index_) {
-      ReadSection(new_section_index);
-    }
+    // Always re-read the section, as the decoders only skip forward. Start
+    // from the section before target_key, as the newer versions of the key
+    // may end that section
+    ReadSection(meta_.Search(target_key > 0 ? target_key - 1 : 0));
 
     entry_index_ = section_.FindStart(target_key);
     if (entry_index_ == -1) {
@@ -391,6 +385,13 @@ class VertBlockCore::VIter : public Iterator {
       }
     }
     ReadKeyValue();
+    // Versions of the key newer than the target sort before it
+    uint64_t target_tag = DecodeFixed64(target.data() + target.size() - 8);
+    while (Valid() && *reinterpret_cast<const uint32_t*>(key_buffer_) ==
+                          target_key &&
+           DecodeFixed64(key_buffer_ + 4) > target_tag) {
+      Next();
+    }
   }
 
   void SeekToFirst() override {
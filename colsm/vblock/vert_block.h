@@ -23,6 +23,18 @@ using namespace encoding;
 
 const uint32_t MAGIC = 0xCAAEDADE;
 
+// Search kernels over bit-packed sorted columns, shared by the data sections
+// and the vertical index block. Both require 8 bytes of readable padding
+// after the packed data.
+
+// Return the index of an entry equal to target, -1 if not found
+int eq_packed(const uint8_t* data, uint32_t num_entry, uint8_t bitwidth,
+              uint32_t target);
+
+// Return the first entry larger or equal to the target, num_entry if none
+int geq_packed(const uint8_t* data, uint32_t num_entry, uint8_t bitwidth,
+               uint32_t target);
+
 class VertBlockMeta {
  protected:
   uint32_t num_section_;
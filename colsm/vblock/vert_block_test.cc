@@ -367,6 +367,45 @@ TEST(VertSection, FindStart) {
   EXPECT_EQ(-1, section.FindStart(0xFF050900));
 }
 
+TEST(VertSection, FindStartDuplicates) {
+  uint8_t buffer[200];
+  memset(buffer, 0, 200);
+  auto pointer = buffer;
+
+  *(uint32_t*)pointer = 100;
+  pointer += 4;
+  *(uint32_t*)pointer = 0xFF0500EA;
+  pointer += 4;
+
+  *(pointer + 4) = BITPACK;
+  pointer += 5;
+  *(pointer + 4) = PLAIN;
+  pointer += 5;
+  *(pointer + 4) = RUNLENGTH;
+  pointer += 5;
+  *(pointer + 4) = LENGTH;
+  pointer += 5;
+
+  *(uint8_t*)pointer = 8;
+  pointer++;
+
+  // Versions of a key are stored as equal entries, 4 for each key here
+  uint32_t plain_buffer[100];
+  for (auto i = 0; i < 100; ++i) {
+    plain_buffer[i] = 2 * (i / 4);
+  }
+  sboost::byteutils::bitpack(plain_buffer, 100, 8, (uint8_t*)pointer);
+
+  VertSection section;
+  section.Read(buffer);
+  // The first of the equal entries
+  for (uint32_t key = 1; key < 25; ++key) {
+    EXPECT_EQ(4 * key, section.FindStart(0xFF0500EA + 2 * key)) << key;
+    EXPECT_EQ(4 * key, section.FindStart(0xFF0500EA + 2 * key - 1)) << key;
+  }
+  EXPECT_EQ(-1, section.FindStart(0xFF0500EA + 49));
+}
+
 TEST(VertSection, SingleEntry) {
   VertSectionBuilder builder;
   builder.Open(111);
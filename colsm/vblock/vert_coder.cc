@@ -436,9 +436,13 @@ void BitpackEncoder::Dump(uint8_t* output) {
 }
 
 void BitpackDecoder::LoadNextGroup() {
+  index_ = 0;
+  if (bit_width_ == 0) {
+    // All values are 0, unpacked_ is already zeroed
+    return;
+  }
   auto up = unpacker_->unpack(pointer_);
   memcpy(unpacked_, (uint8_t*)&up, 32);
-  index_ = 0;
   pointer_ += bit_width_;
 }
 
@@ -446,8 +450,8 @@ void BitpackDecoder::Attach(const uint8_t* buffer) {
   base_ = buffer;
   bit_width_ = *buffer;
   if(bit_width_==0) {
-    // A single value of 0
-    unpacked_[0] = 0;
+    // All values are 0, e.g., versions of a single key
+    memset(unpacked_, 0, sizeof(unpacked_));
     index_ = 0;
   } else {
     pointer_ = (uint8_t*)buffer + 1;
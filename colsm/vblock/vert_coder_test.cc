@@ -387,6 +387,33 @@ TEST(U32Bitpack, EncDec) {
   delete[] buffer;
 }
 
+TEST(U32Bitpack, AllZeros) {
+  Encoding& plainEncoding = u32::EncodingFactory::Get(BITPACK);
+  auto encoder = plainEncoding.encoder();
+  auto decoder = plainEncoding.decoder();
+
+  // A zero bit width, as for the versions of a single key
+  for (int i = 0; i < 100; ++i) {
+    encoder->Encode((uint32_t)0);
+  }
+  encoder->Close();
+  auto size = encoder->EstimateSize();
+  uint8_t* buffer = new uint8_t[size];
+  memset(buffer, 0xFF, size);
+  encoder->Dump(buffer);
+
+  decoder->Attach(buffer);
+  for (int i = 0; i < 100; ++i) {
+    ASSERT_EQ(0, decoder->DecodeU32()) << i;
+  }
+
+  auto decoder2 = plainEncoding.decoder();
+  decoder2->Attach(buffer);
+  decoder2->Skip(37);
+  ASSERT_EQ(0, decoder2->DecodeU32());
+  delete[] buffer;
+}
+
 TEST(U8Plain, EncDec) {
   Encoding& plainEncoding = u8::EncodingFactory::Get(PLAIN);
   auto encoder = plainEncoding.encoder();
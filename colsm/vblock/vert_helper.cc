@@ -6,6 +6,7 @@
 
 #include <leveldb/comparator.h>
 #include <leveldb/slice.h>
+#include <memory>
 
 #include "table/block.h"
 #include "table/format.h"
@@ -17,10 +18,14 @@ bool IsVerticalTable(leveldb::Env* env, const std::string& filename) {
   uint64_t size;
   Status s;
   s = env->NewRandomAccessFile(filename, &file);
-  s = env->GetFileSize(filename, &size);
   if (!s.ok()) {
     return false;
   }
+  std::unique_ptr<RandomAccessFile> file_guard(file);
+  s = env->GetFileSize(filename, &size);
+  if (!s.ok() || size < Footer::kEncodedLength) {
+    return false;
+  }
   Slice footer_input;
   char footer_space[Footer::kEncodedLength];
   s = file->Read(size - Footer::kEncodedLength, Footer::kEncodedLength,
@@ -31,6 +36,9 @@ bool IsVerticalTable(leveldb::Env* env, const std::string& filename) {
 
   Footer footer;
   s = footer.DecodeFrom(&footer_input);
+  if (!s.ok()) {
+    return false;
+  }
 
   ReadOptions opt;
   BlockContents contents;
@@ -42,7 +50,8 @@ bool IsVerticalTable(leveldb::Env* env, const std::string& filename) {
 
   bool usev = false;
   Iterator* iter = meta->NewIterator(BytewiseComparator());
-  std::string key = "vformat";
+  // Written by TableBuilder::Finish
+  std::string key = "block.colsm.vformat";
   iter->Seek(key);
   if (iter->Valid() && iter->key() == Slice(key)) {
     usev = (iter->value().ToString() == "true");
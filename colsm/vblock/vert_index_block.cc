@@ -0,0 +1,162 @@
+//
+// Created by harper on 10/19/26.
+//
+
+#include "vert_index_block.h"
+
+#include "util/coding.h"
+
+#include "vert_block.h"
+
+namespace colsm {
+
+// Extract the index-th entry from a bit-packed column
+static inline uint32_t unpack_at(const uint8_t* data, uint8_t bitwidth,
+                                 uint32_t index) {
+  uint64_t bits = static_cast<uint64_t>(index) * bitwidth;
+  uint64_t word = *reinterpret_cast<const uint64_t*>(data + (bits >> 3));
+  return (word >> (bits & 0x7)) & ((1ULL << bitwidth) - 1);
+}
+
+VertIndexBlockCore::VertIndexBlockCore(const BlockContents& data)
+    : raw_data_((const uint8_t*)data.data.data()),
+      size_(data.data.size()),
+      owned_(data.heap_allocated) {
+  auto pointer = raw_data_;
+  num_entry_ = *reinterpret_cast<const uint32_t*>(pointer);
+  key_min_ = *reinterpret_cast<const uint32_t*>(pointer + 4);
+  size_min_ = *reinterpret_cast<const uint32_t*>(pointer + 8);
+  key_bitwidth_ = pointer[12];
+  offset_bitwidth_ = pointer[13];
+  size_bitwidth_ = pointer[14];
+  keys_ = pointer + INDEX_HEADER_SIZE;
+  tags_ = pointer + *reinterpret_cast<const uint32_t*>(pointer + 16);
+  offsets_ = pointer + *reinterpret_cast<const uint32_t*>(pointer + 20);
+  sizes_ = pointer + *reinterpret_cast<const uint32_t*>(pointer + 24);
+}
+
+VertIndexBlockCore::~VertIndexBlockCore() {
+  if (owned_) {
+    delete[] raw_data_;
+  }
+}
+
+uint32_t VertIndexBlockCore::Key(uint32_t index) const {
+  return key_min_ + unpack_at(keys_, key_bitwidth_, index);
+}
+
+uint64_t VertIndexBlockCore::Tag(uint32_t index) const {
+  return reinterpret_cast<const uint64_t*>(tags_)[index];
+}
+
+uint64_t VertIndexBlockCore::Offset(uint32_t index) const {
+  return unpack_at(offsets_, offset_bitwidth_, index);
+}
+
+uint64_t VertIndexBlockCore::Size(uint32_t index) const {
+  return size_min_ + unpack_at(sizes_, size_bitwidth_, index);
+}
+
+uint32_t VertIndexBlockCore::Find(uint32_t user_key, uint64_t tag) const {
+  if (num_entry_ == 0) {
+    return 0;
+  }
+  if (user_key < key_min_) {
+    return 0;
+  }
+  uint32_t target = user_key - key_min_;
+  uint32_t index = geq_packed(keys_, num_entry_, key_bitwidth_, target);
+  // Same user key is ordered by decreasing sequence
+  while (index < num_entry_ &&
+         unpack_at(keys_, key_bitwidth_, index) == target &&
+         Tag(index) > tag) {
+    index++;
+  }
+  return index;
+}
+
+class VertIndexBlockCore::IIter : public Iterator {
+ private:
+  const VertIndexBlockCore* block_;
+  uint32_t current_;
+
+  char key_buffer_[12];
+  std::string value_buffer_;
+
+  Status status_;
+
+  void ComposeEntry() {
+    if (!Valid()) {
+      return;
+    }
+    *((uint32_t*)key_buffer_) = block_->Key(current_);
+    EncodeFixed64(key_buffer_ + 4, block_->Tag(current_));
+    BlockHandle handle;
+    handle.set_offset(block_->Offset(current_));
+    handle.set_size(block_->Size(current_));
+    value_buffer_.clear();
+    handle.EncodeTo(&value_buffer_);
+  }
+
+ public:
+  explicit IIter(const VertIndexBlockCore* block)
+      : block_(block), current_(block->NumEntry()) {}
+
+  bool Valid() const override { return current_ < block_->NumEntry(); }
+
+  void Seek(const Slice& target) override {
+    if (target.size() != 12) {
+      status_ = Status::InvalidArgument("vertical index requires int keys");
+      current_ = block_->NumEntry();
+      return;
+    }
+    uint32_t user_key = *reinterpret_cast<const uint32_t*>(target.data());
+    current_ = block_->Find(user_key, DecodeFixed64(target.data() + 4));
+    ComposeEntry();
+  }
+
+  void SeekToFirst() override {
+    current_ = 0;
+    ComposeEntry();
+  }
+
+  void SeekToLast() override {
+    // For an empty block current_ == NumEntry() == 0, i.e. invalid
+    current_ = block_->NumEntry() == 0 ? 0 : block_->NumEntry() - 1;
+    ComposeEntry();
+  }
+
+  void Next() override {
+    assert(Valid());
+    current_++;
+    ComposeEntry();
+  }
+
+  void Prev() override {
+    assert(Valid());
+    if (current_ == 0) {
+      current_ = block_->NumEntry();
+    } else {
+      current_--;
+    }
+    ComposeEntry();
+  }
+
+  Slice key() const override {
+    assert(Valid());
+    return Slice(key_buffer_, 12);
+  }
+
+  Slice value() const override {
+    assert(Valid());
+    return Slice(value_buffer_);
+  }
+
+  Status status() const override { return status_; }
+};
+
+Iterator* VertIndexBlockCore::NewIterator(const Comparator* comparator) {
+  return new IIter(this);
+}
+
+}  // namespace colsm
@@ -0,0 +1,81 @@
+//
+// Created by harper on 10/19/26.
+//
+
+#ifndef LEVELDB_VERT_INDEX_BLOCK_H
+#define LEVELDB_VERT_INDEX_BLOCK_H
+
+#include <cstdint>
+#include <string>
+
+#include "leveldb/iterator.h"
+#include "leveldb/slice.h"
+
+#include "table/block.h"
+#include "table/format.h"
+
+using namespace leveldb;
+namespace colsm {
+
+const uint32_t INDEX_MAGIC = 0xCAAED1DE;
+
+// Size of the fixed header in front of the index columns
+const uint32_t INDEX_HEADER_SIZE = 28;
+
+/**
+ * Read-only view of a vertical index block. See vert_index_block_builder.h
+ * for the layout.
+ */
+class VertIndexBlockCore : public BlockCore {
+ public:
+  explicit VertIndexBlockCore(const BlockContents&);
+
+  VertIndexBlockCore(const VertIndexBlockCore&) = delete;
+
+  VertIndexBlockCore& operator=(const VertIndexBlockCore&) = delete;
+
+  ~VertIndexBlockCore();
+
+  size_t size() const override { return size_; }
+
+  uint32_t NumEntry() const { return num_entry_; }
+
+  uint32_t Key(uint32_t index) const;
+
+  uint64_t Tag(uint32_t index) const;
+
+  uint64_t Offset(uint32_t index) const;
+
+  uint64_t Size(uint32_t index) const;
+
+  /**
+   * Find the first entry whose internal key is geq the given one
+   * @return NumEntry() if all entries are smaller
+   */
+  uint32_t Find(uint32_t user_key, uint64_t tag) const;
+
+  Iterator* NewIterator(const Comparator* comparator) override;
+
+ private:
+  class IIter;
+
+  const uint8_t* raw_data_;
+  size_t size_;
+  bool owned_;
+
+  uint32_t num_entry_;
+  uint32_t key_min_;
+  uint32_t size_min_;
+  uint8_t key_bitwidth_;
+  uint8_t offset_bitwidth_;
+  uint8_t size_bitwidth_;
+
+  const uint8_t* keys_;
+  const uint8_t* tags_;
+  const uint8_t* offsets_;
+  const uint8_t* sizes_;
+};
+
+}  // namespace colsm
+
+#endif  // LEVELDB_VERT_INDEX_BLOCK_H
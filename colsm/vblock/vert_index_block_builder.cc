@@ -0,0 +1,138 @@
+//
+// Created by harper on 10/19/26.
+//
+
+#include "vert_index_block_builder.h"
+
+#include <immintrin.h>
+
+#include <algorithm>
+#include <cstring>
+
+#include "table/format.h"
+#include "util/coding.h"
+
+#include "byteutils.h"
+
+namespace colsm {
+
+// Bytes for a bit-packed column, with padding for the 64-bit reads of the
+// search kernels
+static inline uint32_t PackedSize(uint32_t num_entry, uint8_t bitwidth) {
+  return ((num_entry + 7) >> 3) * bitwidth + 8;
+}
+
+static inline uint32_t Align8(uint32_t pos) { return (pos + 7) & ~7u; }
+
+static inline uint8_t BitWidth(uint32_t max_value) {
+  return 32 - _lzcnt_u32(max_value);
+}
+
+VertIndexBlockBuilder::VertIndexBlockBuilder(const Options* options)
+    : BlockBuilder(options), vertical_(true) {}
+
+void VertIndexBlockBuilder::Reset() {
+  BlockBuilder::Reset();
+  vertical_ = true;
+  keys_.clear();
+  tags_.clear();
+  offsets_.clear();
+  sizes_.clear();
+  buffer_.clear();
+}
+
+void VertIndexBlockBuilder::Add(const Slice& key, const Slice& value) {
+  BlockBuilder::Add(key, value);
+  if (!vertical_) {
+    return;
+  }
+  BlockHandle handle;
+  Slice input = value;
+  if (key.size() != 12 || !handle.DecodeFrom(&input).ok() ||
+      handle.offset() > UINT32_MAX || handle.size() > UINT32_MAX) {
+    vertical_ = false;
+    return;
+  }
+  uint32_t user_key = *reinterpret_cast<const uint32_t*>(key.data());
+  uint64_t tag = DecodeFixed64(key.data() + 4);
+  if (!keys_.empty() &&
+      (user_key < keys_.back() ||
+       (user_key == keys_.back() && tag >= tags_.back()))) {
+    // Not in int order, the packed search would be wrong
+    vertical_ = false;
+    return;
+  }
+  keys_.push_back(user_key);
+  tags_.push_back(tag);
+  offsets_.push_back(handle.offset());
+  sizes_.push_back(handle.size());
+}
+
+Slice VertIndexBlockBuilder::Finish() {
+  if (!vertical_ || keys_.empty()) {
+    return BlockBuilder::Finish();
+  }
+  uint32_t num_entry = keys_.size();
+
+  uint32_t key_min = keys_[0];
+  for (auto& key : keys_) {
+    key -= key_min;
+  }
+  uint32_t size_min = sizes_[0];
+  uint32_t size_max = sizes_[0];
+  for (auto size : sizes_) {
+    size_min = std::min(size_min, size);
+    size_max = std::max(size_max, size);
+  }
+  for (auto& size : sizes_) {
+    size -= size_min;
+  }
+  uint8_t key_bitwidth = BitWidth(keys_.back());
+  uint8_t offset_bitwidth = BitWidth(offsets_.back());
+  uint8_t size_bitwidth = BitWidth(size_max - size_min);
+
+  uint32_t tags_pos =
+      Align8(INDEX_HEADER_SIZE + PackedSize(num_entry, key_bitwidth));
+  uint32_t offsets_pos = tags_pos + num_entry * 8;
+  uint32_t sizes_pos = offsets_pos + PackedSize(num_entry, offset_bitwidth);
+  uint32_t total = sizes_pos + PackedSize(num_entry, size_bitwidth) + 4;
+
+  buffer_.assign(total, 0);
+  auto pointer = buffer_.data();
+  *reinterpret_cast<uint32_t*>(pointer) = num_entry;
+  *reinterpret_cast<uint32_t*>(pointer + 4) = key_min;
+  *reinterpret_cast<uint32_t*>(pointer + 8) = size_min;
+  pointer[12] = key_bitwidth;
+  pointer[13] = offset_bitwidth;
+  pointer[14] = size_bitwidth;
+  *reinterpret_cast<uint32_t*>(pointer + 16) = tags_pos;
+  *reinterpret_cast<uint32_t*>(pointer + 20) = offsets_pos;
+  *reinterpret_cast<uint32_t*>(pointer + 24) = sizes_pos;
+
+  if (key_bitwidth > 0) {
+    sboost::byteutils::bitpack(keys_.data(), num_entry, key_bitwidth,
+                               pointer + INDEX_HEADER_SIZE);
+  }
+  memcpy(pointer + tags_pos, tags_.data(), num_entry * 8);
+  if (offset_bitwidth > 0) {
+    sboost::byteutils::bitpack(offsets_.data(), num_entry, offset_bitwidth,
+                               pointer + offsets_pos);
+  }
+  if (size_bitwidth > 0) {
+    sboost::byteutils::bitpack(sizes_.data(), num_entry, size_bitwidth,
+                               pointer + sizes_pos);
+  }
+  *reinterpret_cast<uint32_t*>(pointer + total - 4) = INDEX_MAGIC;
+
+  return Slice((const char*)buffer_.data(), buffer_.size());
+}
+
+size_t VertIndexBlockBuilder::CurrentSizeEstimate() const {
+  if (!vertical_) {
+    return BlockBuilder::CurrentSizeEstimate();
+  }
+  // Upper bound with 32-bit wide packed columns
+  return INDEX_HEADER_SIZE + keys_.size() * 20 + 32;
+}
+
+}  // namespace colsm
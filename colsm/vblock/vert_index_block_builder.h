@@ -0,0 +1,83 @@
+//
+// Created by harper on 10/19/26.
+//
+//
+// VertIndexBlockBuilder generates index blocks that are columnar encoded
+//
+// The index block of a vertical table maps the last internal key of each data
+// block to its BlockHandle. With 4-byte int keys, all columns can be packed
+// and searched in place without decoding varint entries. The data format is
+// as following:
+//
+//    header:    num_entry      : uint32_t
+//               key_min        : uint32_t
+//               size_min       : uint32_t
+//               key_bitwidth   : uint8_t
+//               offset_bitwidth: uint8_t
+//               size_bitwidth  : uint8_t
+//               reserved       : uint8_t
+//               tags_pos       : uint32_t
+//               offsets_pos    : uint32_t
+//               sizes_pos      : uint32_t
+//    keys:      bit-packed (user_key - key_min) {num_entry}
+//    tags:      uint64_t (seq << 8 | type) {num_entry}
+//    offsets:   bit-packed block offset {num_entry}
+//    sizes:     bit-packed (block size - size_min) {num_entry}
+//               INDEX_MAGIC
+//
+// If an entry cannot be represented (keys are not 12-byte internal keys in
+// ascending int order, or the file is larger than 4GB), the builder falls back
+// to the horizontal format of BlockBuilder, which it maintains in parallel.
+
+#ifndef LEVELDB_VERT_INDEX_BLOCK_BUILDER_H
+#define LEVELDB_VERT_INDEX_BLOCK_BUILDER_H
+
+#include <cstdint>
+#include <vector>
+
+#include "table/block_builder.h"
+
+#include "vert_index_block.h"
+
+using namespace leveldb;
+namespace colsm {
+
+class VertIndexBlockBuilder : public BlockBuilder {
+ public:
+  explicit VertIndexBlockBuilder(const Options* options);
+
+  VertIndexBlockBuilder(const VertIndexBlockBuilder&) = delete;
+
+  VertIndexBlockBuilder& operator=(const VertIndexBlockBuilder&) = delete;
+
+  virtual ~VertIndexBlockBuilder() = default;
+
+  void Reset() override;
+
+  // REQUIRES: key is larger than any previously added key
+  // REQUIRES: value is an encoded BlockHandle
+  void Add(const Slice& key, const Slice& value) override;
+
+  Slice Finish() override;
+
+  size_t CurrentSizeEstimate() const override;
+
+  bool empty() const override { return BlockBuilder::empty(); }
+
+  // Whether the entries added so far can be written vertically
+  bool vertical() const { return vertical_; }
+
+ private:
+  bool vertical_;
+
+  std::vector<uint32_t> keys_;
+  std::vector<uint64_t> tags_;
+  std::vector<uint32_t> offsets_;
+  std::vector<uint32_t> sizes_;
+
+  std::vector<uint8_t> buffer_;
+};
+
+}  // namespace colsm
+
+#endif  // LEVELDB_VERT_INDEX_BLOCK_BUILDER_H
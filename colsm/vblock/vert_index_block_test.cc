@@ -0,0 +1,177 @@
+//
+// Created by harper on 10/19/26.
+//
+
+#include <colsm/comparators.h>
+#include <gtest/gtest.h>
+
+#include "db/dbformat.h"
+#include "util/coding.h"
+
+#include "vert_index_block.h"
+#include "vert_index_block_builder.h"
+
+using namespace colsm;
+
+namespace {
+auto int_comparator = intComparator();
+InternalKeyComparator internal_comparator(int_comparator.get());
+
+std::string IndexKey(uint32_t user_key, uint64_t seq) {
+  char buffer[12];
+  *((uint32_t*)buffer) = user_key;
+  EncodeFixed64(buffer + 4, (seq << 8) | ValueType::kTypeValue);
+  return std::string(buffer, 12);
+}
+
+std::string Handle(uint64_t offset, uint64_t size) {
+  BlockHandle handle;
+  handle.set_offset(offset);
+  handle.set_size(size);
+  std::string encoding;
+  handle.EncodeTo(&encoding);
+  return encoding;
+}
+
+BlockHandle DecodeHandle(Slice value) {
+  BlockHandle handle;
+  EXPECT_TRUE(handle.DecodeFrom(&value).ok());
+  return handle;
+}
+}  // namespace
+
+TEST(VertIndexBlock, Build) {
+  Options options;
+  options.block_restart_interval = 1;
+  options.comparator = &internal_comparator;
+  VertIndexBlockBuilder builder(&options);
+  for (uint32_t i = 0; i < 1000; ++i) {
+    builder.Add(IndexKey(100 + i * 7, 50), Handle(i * 4000, 3990 + i % 10));
+  }
+  EXPECT_TRUE(builder.vertical());
+  auto result = builder.Finish();
+  EXPECT_EQ(INDEX_MAGIC, *(uint32_t*)(result.data() + result.size() - 4));
+
+  BlockContents content;
+  content.data = result;
+  content.cachable = false;
+  content.heap_allocated = false;
+  VertIndexBlockCore block(content);
+
+  ASSERT_EQ(1000, block.NumEntry());
+  for (uint32_t i = 0; i < 1000; ++i) {
+    EXPECT_EQ(100 + i * 7, block.Key(i));
+    EXPECT_EQ((50 << 8) | ValueType::kTypeValue, block.Tag(i));
+    EXPECT_EQ(i * 4000, block.Offset(i));
+    EXPECT_EQ(3990 + i % 10, block.Size(i));
+  }
+}
+
+TEST(VertIndexBlock, Seek) {
+  Options options;
+  options.block_restart_interval = 1;
+  options.comparator = &internal_comparator;
+  VertIndexBlockBuilder builder(&options);
+  for (uint32_t i = 0; i < 1000; ++i) {
+    builder.Add(IndexKey(100 + i * 7, 50), Handle(i * 4000, 4000));
+  }
+  auto result = builder.Finish();
+  BlockContents content;
+  content.data = result;
+  content.cachable = false;
+  content.heap_allocated = false;
+  VertIndexBlockCore block(content);
+
+  auto ite = block.NewIterator(nullptr);
+  // Before the first key
+  ite->Seek(IndexKey(3, 100));
+  ASSERT_TRUE(ite->Valid());
+  EXPECT_EQ(0, DecodeHandle(ite->value()).offset());
+
+  for (uint32_t i = 0; i < 1000; ++i) {
+    // Exact and in-between keys map to the block containing them
+    ite->Seek(IndexKey(100 + i * 7, 100));
+    ASSERT_TRUE(ite->Valid());
+    EXPECT_EQ(i * 4000, DecodeHandle(ite->value()).offset());
+    ite->Seek(IndexKey(100 + i * 7 - 3, 100));
+    ASSERT_TRUE(ite->Valid());
+    EXPECT_EQ(i * 4000, DecodeHandle(ite->value()).offset());
+    ParsedInternalKey pkey;
+    ParseInternalKey(ite->key(), &pkey);
+    EXPECT_EQ(100 + i * 7, *(uint32_t*)pkey.user_key.data());
+    EXPECT_EQ(50, pkey.sequence);
+  }
+  // Same user key with an older sequence is after the separator
+  ite->Seek(IndexKey(100, 10));
+  ASSERT_TRUE(ite->Valid());
+  EXPECT_EQ(4000, DecodeHandle(ite->value()).offset());
+
+  // Past the last key
+  ite->Seek(IndexKey(100 + 999 * 7 + 1, 100));
+  EXPECT_FALSE(ite->Valid());
+
+  ite->SeekToLast();
+  ASSERT_TRUE(ite->Valid());
+  EXPECT_EQ(999 * 4000, DecodeHandle(ite->value()).offset());
+  ite->Prev();
+  ASSERT_TRUE(ite->Valid());
+  EXPECT_EQ(998 * 4000, DecodeHandle(ite->value()).offset());
+  delete ite;
+}
+
+TEST(VertIndexBlock, DuplicateUserKey) {
+  Options options;
+  options.block_restart_interval = 1;
+  options.comparator = &internal_comparator;
+  VertIndexBlockBuilder builder(&options);
+  // A user key with many versions spanning several blocks
+  builder.Add(IndexKey(5, 100), Handle(0, 100));
+  for (uint32_t i = 0; i < 10; ++i) {
+    builder.Add(IndexKey(10, 90 - i * 5), Handle(100 * (i + 1), 100));
+  }
+  builder.Add(IndexKey(20, 100), Handle(1100, 100));
+  auto result = builder.Finish();
+  BlockContents content;
+  content.data = result;
+  content.cachable = false;
+  content.heap_allocated = false;
+  VertIndexBlockCore block(content);
+
+  EXPECT_EQ(1, block.Find(10, (95 << 8) | 1));
+  EXPECT_EQ(1, block.Find(10, (90 << 8) | 1));
+  EXPECT_EQ(2, block.Find(10, (87 << 8) | 1));
+  EXPECT_EQ(10, block.Find(10, (45 << 8) | 1));
+  EXPECT_EQ(11, block.Find(10, (10 << 8) | 1));
+  EXPECT_EQ(11, block.Find(11, (100 << 8) | 1));
+  EXPECT_EQ(12, block.Find(21, (100 << 8) | 1));
+}
+
+TEST(VertIndexBlock, Fallback) {
+  Options options;
+  options.block_restart_interval = 1;
+  VertIndexBlockBuilder builder(&options);
+  builder.Add("abc", Handle(0, 100));
+  builder.Add("abd", Handle(100, 100));
+  EXPECT_FALSE(builder.vertical());
+  auto result = builder.Finish();
+
+  BlockContents content;
+  content.data = result;
+  content.cachable = false;
+  content.heap_allocated = false;
+  Block block(content);
+  auto ite = block.NewIterator(BytewiseComparator());
+  ite->SeekToFirst();
+  ASSERT_TRUE(ite->Valid());
+  EXPECT_EQ("abc", ite->key().ToString());
+  ite->Next();
+  ASSERT_TRUE(ite->Valid());
+  EXPECT_EQ(100, DecodeHandle(ite->value()).offset());
+  delete ite;
+}
+
+// LevelDB test did not use gtest_main
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -12,15 +12,34 @@
 #include "leveldb/db.h"
 #include "leveldb/env.h"
 #include "leveldb/iterator.h"
-
-#include "colsm/cost/cost_model.h"
+#include "leveldb/layout_policy.h"
 
 namespace leveldb {
 
+Options LevelTableOptions(const Options& options, int level, bool* vertical) {
+  LevelLayout layout;
+  layout.block_size = options.block_size;
+  layout.compression = options.compression;
+  layout.section_limit = options.section_limit;
+  if (options.layout_policy != nullptr) {
+    options.layout_policy->GetLayout(level, &layout);
+  }
+
+  Options result = options;
+  result.block_size = layout.block_size;
+  result.compression = layout.compression;
+  result.section_limit = layout.section_limit;
+  *vertical = layout.vertical;
+  return result;
+}
+
 Status BuildTable(const std::string& dbname, Env* env, const Options& options,
-                  TableCache* table_cache, Iterator* iter, FileMetaData* meta) {
+                  bool vertical, TableCache* table_cache, Iterator* iter,
+                  FileMetaData* meta) {
   Status s;
   meta->file_size = 0;
+  meta->num_entries = 0;
+  meta->num_deletions = 0;
   iter->SeekToFirst();
 
   std::string fname = TableFileName(dbname, meta->number);
@@ -31,18 +50,18 @@ Status BuildTable(const std::string& dbname, Env* env, const Options& options,
       return s;
     }
 
-    // Only writing level 0 will call this function
-    // The function `BuildTable` is called by WriteLevel0Table and ConvertLogToTable, which
-    // are both level 0 tables
-    // July 5th, 2021
-    TableBuilder* builder = new TableBuilder(
-            options, colsm::CostModel::INSTANCE->ShouldVertical(0), file);
+    TableBuilder* builder = new TableBuilder(options, vertical, file);
     meta->smallest.DecodeFrom(iter->key());
     Slice key;
+    ParsedInternalKey ikey;
     for (; iter->Valid(); iter->Next()) {
       key = iter->key();
       builder->Add(key, iter->value());
+      if (ParseInternalKey(key, &ikey) && ikey.type == kTypeDeletion) {
+        meta->num_deletions++;
+      }
     }
+    meta->num_entries = builder->NumEntries();
     if (!key.empty()) {
       meta->largest.DecodeFrom(key);
     }
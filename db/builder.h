@@ -5,11 +5,11 @@
 #ifndef STORAGE_LEVELDB_DB_BUILDER_H_
 #define STORAGE_LEVELDB_DB_BUILDER_H_
 
+#include "leveldb/options.h"
 #include "leveldb/status.h"
 
 namespace leveldb {
 
-struct Options;
 struct FileMetaData;
 
 class Env;
@@ -17,13 +17,20 @@ class Iterator;
 class TableCache;
 class VersionEdit;
 
+// Options for the tables written to "level", with the block parameters
+// chosen by options.layout_policy.  Stores in *vertical whether the tables
+// use vertical blocks.
+Options LevelTableOptions(const Options& options, int level, bool* vertical);
+
 // Build a Table file from the contents of *iter.  The generated file
 // will be named according to meta->number.  On success, the rest of
 // *meta will be filled with metadata about the generated table.
 // If no data is present in *iter, meta->file_size will be set to
-// zero, and no Table file will be produced.
+// zero, and no Table file will be produced.  The table uses vertical
+// blocks if "vertical" is true.
 Status BuildTable(const std::string& dbname, Env* env, const Options& options,
-                  TableCache* table_cache, Iterator* iter, FileMetaData* meta);
+                  bool vertical, TableCache* table_cache, Iterator* iter,
+                  FileMetaData* meta);
 
 }  // namespace leveldb
 
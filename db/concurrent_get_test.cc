@@ -0,0 +1,101 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "colsm/comparators.h"
+#include "db/db_impl.h"
+#include "gtest/gtest.h"
+#include "helpers/memenv/memenv.h"
+#include "leveldb/db.h"
+#include "leveldb/env.h"
+#include "util/coding.h"
+
+namespace leveldb {
+
+static std::string Key(uint32_t i) {
+  std::string result;
+  PutFixed32(&result, i);
+  return result;
+}
+
+// Readers run Get() while the writer switches memtables and compactions
+// install new versions under them
+static void ReadWhileInstalling(int num_readers) {
+  std::unique_ptr<Env> env(NewMemEnv(Env::Default()));
+  auto comparator = colsm::intComparator();
+  Options options;
+  options.env = env.get();
+  options.comparator = comparator.get();
+  options.create_if_missing = true;
+  options.write_buffer_size = 64 * 1024;
+
+  DB* db;
+  ASSERT_TRUE(DB::Open(options, "/getdb", &db).ok());
+
+  const uint32_t kNumKeys = 1000;
+  for (uint32_t i = 0; i < kNumKeys; i++) {
+    ASSERT_TRUE(db->Put(WriteOptions(), Key(i), "0").ok());
+  }
+
+  // Values of a key only grow, so a reader must never see one below what
+  // it has seen before
+  std::atomic<bool> done(false);
+  std::atomic<int> errors(0);
+  std::vector<std::thread> readers;
+  for (int t = 0; t < num_readers; t++) {
+    readers.emplace_back([&, t]() {
+      std::vector<int> seen(kNumKeys, 0);
+      uint32_t i = t;
+      while (!done.load()) {
+        i = (i + 7) % kNumKeys;
+        std::string value;
+        Status s = db->Get(ReadOptions(), Key(i), &value);
+        int round = s.ok() ? std::stoi(value) : -1;
+        if (round < seen[i]) {
+          errors++;
+        }
+        seen[i] = round;
+      }
+    });
+  }
+
+  for (int round = 1; round <= 20; round++) {
+    for (uint32_t i = 0; i < kNumKeys; i++) {
+      ASSERT_TRUE(
+          db->Put(WriteOptions(), Key(i), std::to_string(round)).ok());
+    }
+    if (round % 5 == 0) {
+      db->CompactRange(nullptr, nullptr);
+    }
+  }
+  done = true;
+  for (auto& reader : readers) {
+    reader.join();
+  }
+  ASSERT_EQ(0, errors.load());
+  // Freed by their last readers
+  DBImpl* dbi = reinterpret_cast<DBImpl*>(db);
+  ASSERT_EQ(0, dbi->TEST_NumRetiredSuperVersions());
+
+  std::string value;
+  ASSERT_TRUE(db->Get(ReadOptions(), Key(5), &value).ok());
+  ASSERT_EQ("20", value);
+  delete db;
+}
+
+TEST(ConcurrentGetTest, ReadWhileInstalling) { ReadWhileInstalling(4); }
+
+// Readers beyond the pinning slots fall back to taking references
+TEST(ConcurrentGetTest, MoreReadersThanSlots) { ReadWhileInstalling(100); }
+
+}  // namespace leveldb
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,77 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "colsm/comparators.h"
+#include "gtest/gtest.h"
+#include "helpers/memenv/memenv.h"
+#include "leveldb/db.h"
+#include "leveldb/env.h"
+#include "leveldb/write_batch.h"
+#include "util/coding.h"
+
+namespace leveldb {
+
+static std::string Key(uint32_t i) {
+  std::string result;
+  PutFixed32(&result, i);
+  return result;
+}
+
+// Writers of a group insert their own batches into the memtable
+TEST(ConcurrentWriteTest, ParallelMemTableInserts) {
+  std::unique_ptr<Env> env(NewMemEnv(Env::Default()));
+  auto comparator = colsm::intComparator();
+  Options options;
+  options.env = env.get();
+  options.comparator = comparator.get();
+  options.create_if_missing = true;
+  options.write_buffer_size = 256 * 1024;
+  options.allow_concurrent_memtable_write = true;
+
+  DB* db;
+  ASSERT_TRUE(DB::Open(options, "/writedb", &db).ok());
+
+  const int kThreads = 8;
+  const uint32_t kPerThread = 5000;
+  std::vector<std::thread> writers;
+  for (int t = 0; t < kThreads; t++) {
+    writers.emplace_back([&, t]() {
+      for (uint32_t i = 0; i < kPerThread; i += 2) {
+        // Two keys per batch, a thread writes every kThreads-th key
+        WriteBatch batch;
+        batch.Put(Key(i * kThreads + t), std::to_string(i));
+        batch.Put(Key((i + 1) * kThreads + t), std::to_string(i + 1));
+        ASSERT_TRUE(db->Write(WriteOptions(), &batch).ok());
+      }
+    });
+  }
+  for (auto& writer : writers) {
+    writer.join();
+  }
+
+  // Every write is visible, before and after a reopen
+  for (int round = 0; round < 2; round++) {
+    for (uint32_t i = 0; i < kPerThread; i++) {
+      for (int t = 0; t < kThreads; t++) {
+        std::string value;
+        ASSERT_TRUE(db->Get(ReadOptions(), Key(i * kThreads + t), &value).ok());
+        ASSERT_EQ(std::to_string(i), value);
+      }
+    }
+    delete db;
+    ASSERT_TRUE(DB::Open(options, "/writedb", &db).ok());
+  }
+  delete db;
+}
+
+}  // namespace leveldb
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
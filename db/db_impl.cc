@@ -16,10 +16,13 @@
 #include "db/write_batch_internal.h"
 #include <algorithm>
 #include <atomic>
+#include <cmath>
 #include <cstdint>
 #include <cstdio>
+#include <cstring>
 #include <set>
 #include <string>
+#include <thread>
 #include <vector>
 
 #include "leveldb/db.h"
@@ -28,6 +31,10 @@
 #include "leveldb/table.h"
 #include "leveldb/table_builder.h"
 
+#include "colsm/cost/filter_allocation.h"
+#include "colsm/cost/level_solver.h"
+#include "colsm/vblock/vert_helper.h"
+
 #include "port/port.h"
 #include "table/block.h"
 #include "table/merger.h"
@@ -43,12 +50,29 @@ const int kNumNonTableCacheFiles = 10;
 // Information kept for every waiting writer
 struct DBImpl::Writer {
   explicit Writer(port::Mutex* mu)
-      : batch(nullptr), sync(false), done(false), cv(mu) {}
+      : batch(nullptr),
+        sync(false),
+        done(false),
+        insert(false),
+        leader(nullptr),
+        pending_inserts(0),
+        last_sequence(0),
+        cv(mu) {}
 
   Status status;
   WriteBatch* batch;
   bool sync;
   bool done;
+
+  // Set by the leader of a group whose members insert their own batches
+  // into the memtable, see Options::allow_concurrent_memtable_write
+  bool insert;
+  Writer* leader;
+  int pending_inserts;  // Of the leader, members still inserting
+
+  // Of a pipelined group leader, the last sequence number of its group
+  SequenceNumber last_sequence;
+
   port::CondVar cv;
 };
 
@@ -58,19 +82,32 @@ struct DBImpl::CompactionState {
     uint64_t number;
     uint64_t file_size;
     InternalKey smallest, largest;
+    uint64_t num_entries;
+    uint64_t num_deletions;
+    bool vertical;
   };
 
   Output* current_output() { return &outputs[outputs.size() - 1]; }
 
   explicit CompactionState(Compaction* c)
       : compaction(c),
+        start(nullptr),
+        end(nullptr),
         smallest_snapshot(0),
         outfile(nullptr),
         builder(nullptr),
-        total_bytes(0) {}
+        total_bytes(0),
+        imm_micros(0) {}
 
   Compaction* const compaction;
 
+  // User key range [*start, *end) merged by this state, nullptr means
+  // unbounded.  A compaction split into subcompactions has one state per
+  // range.
+  const std::string* start;
+  const std::string* end;
+  CompactionCursor cursor;
+
   // Sequence numbers < smallest_snapshot are not significant since we
   // will never have to service a snapshot below smallest_snapshot.
   // Therefore if we have seen a sequence number S <= smallest_snapshot,
@@ -84,6 +121,7 @@ struct DBImpl::CompactionState {
   TableBuilder* builder;
 
   uint64_t total_bytes;
+  int64_t imm_micros;  // Micros spent doing imm_ compactions
 };
 
 // Fix user-supplied options to be reasonable
@@ -95,6 +133,7 @@ static void ClipToRange(T* ptr, V minvalue, V maxvalue) {
 Options SanitizeOptions(const std::string& dbname,
                         const InternalKeyComparator* icmp,
                         const InternalFilterPolicy* ipolicy,
+                        ClosablePersistentCache* persistent_cache,
                         const Options& src) {
   Options result = src;
   result.comparator = icmp;
@@ -103,6 +142,10 @@ Options SanitizeOptions(const std::string& dbname,
   ClipToRange(&result.write_buffer_size, 64 << 10, 1 << 30);
   ClipToRange(&result.max_file_size, 1 << 20, 1 << 30);
   ClipToRange(&result.block_size, 1 << 10, 4 << 20);
+  if (result.int_key_memtable &&
+      std::strcmp(icmp->user_comparator()->Name(), "IntComparator") != 0) {
+    result.int_key_memtable = false;
+  }
   if (result.info_log == nullptr) {
     // Open a log file in the same directory as the db
     src.env->CreateDir(dbname);  // In case it does not exist
@@ -115,6 +158,9 @@ Options SanitizeOptions(const std::string& dbname,
   }
   if (result.block_cache == nullptr) {
     result.block_cache = NewLRUCache(8 << 20);
+    if (result.persistent_cache != nullptr) {
+      result.persistent_cache = persistent_cache;
+    }
   }
   return result;
 }
@@ -124,12 +170,37 @@ static int TableCacheSize(const Options& sanitized_options) {
   return sanitized_options.max_open_files - kNumNonTableCacheFiles;
 }
 
+// Block format of each level chosen by the layout policy
+static std::vector<bool> PolicyFormats(const Options& options) {
+  std::vector<bool> formats;
+  for (int level = 0; level < config::kNumLevels; level++) {
+    bool vertical;
+    LevelTableOptions(options, level, &vertical);
+    formats.push_back(vertical);
+  }
+  return formats;
+}
+
+// Lookups served by the files and their bytes
+static colsm::KeyRangeStats SumLookups(
+    const std::vector<FileMetaData*>& files) {
+  colsm::KeyRangeStats stats{0, 0, 0};
+  for (const FileMetaData* f : files) {
+    stats.point_lookups += f->reads.load(std::memory_order_relaxed);
+    stats.range_lookups += f->scans.load(std::memory_order_relaxed);
+    stats.bytes += f->file_size;
+  }
+  return stats;
+}
+
 DBImpl::DBImpl(const Options& raw_options, const std::string& dbname)
     : env_(raw_options.env),
       internal_comparator_(raw_options.comparator),
       internal_filter_policy_(raw_options.filter_policy),
+      closable_persistent_cache_(raw_options.persistent_cache),
       options_(SanitizeOptions(dbname, &internal_comparator_,
-                               &internal_filter_policy_, raw_options)),
+                               &internal_filter_policy_,
+                               &closable_persistent_cache_, raw_options)),
       owns_info_log_(options_.info_log != raw_options.info_log),
       owns_cache_(options_.block_cache != raw_options.block_cache),
       dbname_(dbname),
@@ -144,19 +215,131 @@ DBImpl::DBImpl(const Options& raw_options, const std::string& dbname)
       logfile_number_(0),
       log_(nullptr),
       seed_(0),
+      first_recyclable_log_(0),
       tmp_batch_(new WriteBatch),
-      background_compaction_scheduled_(false),
+      memtable_writers_drained_signal_(&mutex_),
+      background_compactions_scheduled_(0),
+      background_flush_running_(false),
+      running_compactions_(0),
+      manifest_writing_(false),
+      manifest_written_signal_(&mutex_),
       manual_compaction_(nullptr),
       versions_(new VersionSet(dbname_, &options_, table_cache_,
-                               &internal_comparator_)) {}
+                               &internal_comparator_)),
+      layout_(PolicyFormats(options_)),
+      cost_parameter_(colsm::DefaultParameter()),
+      relayout_pending_(true),
+      relayout_running_(false),
+      relayout_next_micros_(0),
+      relayout_polled_micros_(0),
+      super_version_(nullptr) {
+  // Subcompactions run on the same threads as the compactions
+  const int background_threads = std::max(options_.max_background_compactions,
+                                          options_.max_subcompactions);
+  if (background_threads > 1) {
+    env_->SetBackgroundThreads(background_threads);
+  }
+  if (raw_options.filter_policy != nullptr &&
+      options_.filter_memory_budget > 0) {
+    for (int bits = 1; bits <= kMaxFilterBitsPerKey; bits++) {
+      const FilterPolicy* policy =
+          raw_options.filter_policy->NewWithBitsPerKey(bits);
+      if (policy == nullptr) {
+        // DB::Open rejects the options
+        sized_filter_policies_.clear();
+        budget_filter_policies_.clear();
+        break;
+      }
+      sized_filter_policies_.emplace_back(policy);
+      budget_filter_policies_.emplace_back(
+          new InternalFilterPolicy(sized_filter_policies_.back().get()));
+    }
+  }
+  for (int level = 0; level < config::kNumLevels; level++) {
+    level_filter_bits_[level].store(-1, std::memory_order_relaxed);
+  }
+}
+
+Options DBImpl::TableOptions(int level) const {
+  bool vertical;
+  Options options = LevelTableOptions(options_, level, &vertical);
+  if (!budget_filter_policies_.empty()) {
+    const int bits = level_filter_bits_[std::min(level, config::kNumLevels - 1)]
+                         .load(std::memory_order_relaxed);
+    if (bits == 0) {
+      options.filter_policy = nullptr;
+    } else if (bits > 0) {
+      options.filter_policy = budget_filter_policies_[bits - 1].get();
+    }
+  }
+  return options;
+}
+
+void DBImpl::UpdateFilterAllocation() {
+  mutex_.AssertHeld();
+  if (budget_filter_policies_.empty()) {
+    return;
+  }
+
+  // Estimate the entries of each level from the tables whose entries are
+  // counted
+  Version* current = versions_->current();
+  uint64_t counted_bytes = 0;
+  uint64_t counted_entries = 0;
+  int last = 0;
+  for (int level = 0; level < config::kNumLevels; level++) {
+    for (FileMetaData* f : current->LevelFiles(level)) {
+      if (f->num_entries > 0) {
+        counted_bytes += f->file_size;
+        counted_entries += f->num_entries;
+      }
+      last = level;
+    }
+  }
+  if (counted_entries == 0) {
+    return;
+  }
+  const double entries_per_byte =
+      static_cast<double>(counted_entries) / counted_bytes;
+
+  // Flushes may write down to level-2 and compactions one level below the
+  // deepest one, until the allocation is recomputed.  Such a level gets the
+  // bits of a level holding at least one write buffer.
+  const int last_written = std::max(last + 1, 2);
+  std::vector<double> level_entries(config::kNumLevels, 0);
+  for (int level = 0; level <= last_written && level < config::kNumLevels;
+       level++) {
+    const double bytes =
+        std::max<double>(versions_->NumLevelBytes(level),
+                         options_.write_buffer_size);
+    level_entries[level] = bytes * entries_per_byte;
+  }
+  const std::vector<double> fpr = colsm::AllocateFilterFpr(
+      level_entries, options_.filter_memory_budget * 8.0);
+  for (int level = 0; level < config::kNumLevels; level++) {
+    // A level whose filter would have less than one bit per key is left
+    // without one
+    const long bits = std::lround(colsm::FilterBitsForFpr(fpr[level]));
+    level_filter_bits_[level].store(
+        static_cast<int>(std::min<long>(bits, kMaxFilterBitsPerKey)),
+        std::memory_order_relaxed);
+  }
+}
 
 DBImpl::~DBImpl() {
   // Wait for background work to finish.
   mutex_.Lock();
   shutting_down_.store(true, std::memory_order_release);
-  while (background_compaction_scheduled_) {
+  while (background_compactions_scheduled_ > 0) {
     background_work_finished_signal_.Wait();
   }
+  // No reader is left, so all SuperVersions are freed
+  SuperVersion* sv = super_version_.exchange(nullptr);
+  if (sv != nullptr) {
+    retired_super_versions_.push_back(sv);
+  }
+  ReclaimSuperVersions();
+  assert(retired_super_versions_.empty());
   mutex_.Unlock();
 
   if (db_lock_ != nullptr) {
@@ -175,6 +358,8 @@ DBImpl::~DBImpl() {
     delete options_.info_log;
   }
   if (owns_cache_) {
+    // The blocks are not read again
+    closable_persistent_cache_.Close();
     delete options_.block_cache;
   }
 }
@@ -244,7 +429,8 @@ void DBImpl::RemoveObsoleteFiles() {
       switch (type) {
         case kLogFile:
           keep = ((number >= versions_->LogNumber()) ||
-                  (number == versions_->PrevLogNumber()));
+                  (number == versions_->PrevLogNumber()) ||
+                  KeepLogForRecycling(number));
           break;
         case kDescriptorFile:
           // Keep my manifest file, and any newer incarnations'
@@ -270,6 +456,7 @@ void DBImpl::RemoveObsoleteFiles() {
         files_to_delete.push_back(std::move(filename));
         if (type == kTableFile) {
           table_cache_->Evict(number);
+          table_formats_.erase(number);
         }
         Log(options_.info_log, "Delete type=%d #%lld\n", static_cast<int>(type),
             static_cast<unsigned long long>(number));
@@ -287,6 +474,55 @@ void DBImpl::RemoveObsoleteFiles() {
   mutex_.Lock();
 }
 
+bool DBImpl::KeepLogForRecycling(uint64_t number) {
+  mutex_.AssertHeld();
+  if (std::find(recycle_logs_.begin(), recycle_logs_.end(), number) !=
+      recycle_logs_.end()) {
+    return true;
+  }
+  if (first_recyclable_log_ == 0 || number < first_recyclable_log_ ||
+      recycle_logs_.size() >= options_.recycle_log_file_num) {
+    return false;
+  }
+  Log(options_.info_log, "Recycle log #%llu\n",
+      static_cast<unsigned long long>(number));
+  recycle_logs_.push_back(number);
+  return true;
+}
+
+Status DBImpl::NewLogFile(uint64_t number) {
+  mutex_.AssertHeld();
+  const bool recyclable = options_.recycle_log_file_num > 0;
+  const std::string fname = LogFileName(dbname_, number);
+  WritableFile* lfile = nullptr;
+  Status s;
+  if (!recycle_logs_.empty()) {
+    uint64_t old_number = recycle_logs_.front();
+    recycle_logs_.pop_front();
+    s = env_->ReuseWritableFile(fname, LogFileName(dbname_, old_number),
+                                &lfile);
+  } else {
+    s = env_->NewWritableFile(fname, &lfile);
+  }
+  if (!s.ok()) {
+    return s;
+  }
+  if (recyclable) {
+    if (first_recyclable_log_ == 0) {
+      first_recyclable_log_ = number;
+    }
+    // Only a hint, the log works without the space reserved
+    lfile->Preallocate(options_.write_buffer_size);
+  }
+
+  delete log_;
+  delete logfile_;
+  logfile_ = lfile;
+  logfile_number_ = number;
+  log_ = new log::Writer(lfile, number, recyclable);
+  return s;
+}
+
 Status DBImpl::Recover(VersionEdit* edit, bool* save_manifest) {
   mutex_.AssertHeld();
 
@@ -415,7 +651,8 @@ Status DBImpl::RecoverLogFile(uint64_t log_number, bool last_log,
   // paranoid_checks==false so that corruptions cause entire commits
   // to be skipped instead of propagating bad information (like overly
   // large sequence numbers).
-  log::Reader reader(file, &reporter, true /*checksum*/, 0 /*initial_offset*/);
+  log::Reader reader(file, &reporter, true /*checksum*/, 0 /*initial_offset*/,
+                     log_number);
   Log(options_.info_log, "Recovering log #%llu",
       (unsigned long long)log_number);
 
@@ -425,47 +662,56 @@ Status DBImpl::RecoverLogFile(uint64_t log_number, bool last_log,
   WriteBatch batch;
   int compactions = 0;
   MemTable* mem = nullptr;
-  while (reader.ReadRecord(&record, &scratch) && status.ok()) {
-    if (record.size() < 12) {
-      reporter.Corruption(record.size(),
-                          Status::Corruption("log record too small"));
-      continue;
-    }
-    WriteBatchInternal::SetContents(&batch, record);
-
-    if (mem == nullptr) {
-      mem = new MemTable(internal_comparator_);
-      mem->Ref();
-    }
-    status = WriteBatchInternal::InsertInto(&batch, mem);
-    MaybeIgnoreError(&status);
-    if (!status.ok()) {
-      break;
-    }
-    const SequenceNumber last_seq = WriteBatchInternal::Sequence(&batch) +
-                                    WriteBatchInternal::Count(&batch) - 1;
-    if (last_seq > *max_sequence) {
-      *max_sequence = last_seq;
+  if (options_.recovery_threads > 1) {
+    ReplayLogConcurrently(&reader, &reporter, &status, edit, max_sequence,
+                          &compactions, &mem);
+    if (compactions > 0) {
+      *save_manifest = true;
     }
+  } else {
+    while (reader.ReadRecord(&record, &scratch) && status.ok()) {
+      if (record.size() < 12) {
+        reporter.Corruption(record.size(),
+                            Status::Corruption("log record too small"));
+        continue;
+      }
+      WriteBatchInternal::SetContents(&batch, record);
 
-    if (mem->ApproximateMemoryUsage() > options_.write_buffer_size) {
-      compactions++;
-      *save_manifest = true;
-      status = WriteLevel0Table(mem, edit, nullptr);
-      mem->Unref();
-      mem = nullptr;
+      if (mem == nullptr) {
+        mem = new MemTable(internal_comparator_, options_.int_key_memtable);
+        mem->Ref();
+      }
+      status = WriteBatchInternal::InsertInto(&batch, mem);
+      MaybeIgnoreError(&status);
       if (!status.ok()) {
-        // Reflect errors immediately so that conditions like full
-        // file-systems cause the DB::Open() to fail.
         break;
       }
+      const SequenceNumber last_seq = WriteBatchInternal::Sequence(&batch) +
+                                      WriteBatchInternal::Count(&batch) - 1;
+      if (last_seq > *max_sequence) {
+        *max_sequence = last_seq;
+      }
+
+      if (mem->ApproximateMemoryUsage() > options_.write_buffer_size) {
+        compactions++;
+        *save_manifest = true;
+        status = WriteLevel0Table(mem, edit, nullptr);
+        mem->Unref();
+        mem = nullptr;
+        if (!status.ok()) {
+          // Reflect errors immediately so that conditions like full
+          // file-systems cause the DB::Open() to fail.
+          break;
+        }
+      }
     }
   }
 
   delete file;
 
   // See if we should keep reusing the last log file.
-  if (status.ok() && options_.reuse_logs && last_log && compactions == 0) {
+  if (status.ok() && options_.reuse_logs &&
+      options_.recycle_log_file_num == 0 && last_log && compactions == 0) {
     assert(logfile_ == nullptr);
     assert(log_ == nullptr);
     assert(mem_ == nullptr);
@@ -480,7 +726,7 @@ Status DBImpl::RecoverLogFile(uint64_t log_number, bool last_log,
         mem = nullptr;
       } else {
         // mem can be nullptr if lognum exists but was empty.
-        mem_ = new MemTable(internal_comparator_);
+        mem_ = new MemTable(internal_comparator_, options_.int_key_memtable);
         mem_->Ref();
       }
     }
@@ -498,6 +744,163 @@ Status DBImpl::RecoverLogFile(uint64_t log_number, bool last_log,
   return status;
 }
 
+// Records of a log being replayed, see ReplayLogConcurrently
+struct DBImpl::ReplayState {
+  // A memtable being filled from the log
+  struct Chunk {
+    MemTable* mem;
+    int inserting;  // Queued batches not yet inserted
+  };
+
+  ReplayState() : cv(&mu), reading(true) {}
+
+  port::Mutex mu;
+  port::CondVar cv GUARDED_BY(mu);
+  std::deque<Chunk> chunks GUARDED_BY(mu);
+  // Batches to insert, and the chunk each goes to
+  std::deque<std::pair<WriteBatch, Chunk*>> batches GUARDED_BY(mu);
+  // Full chunks to write to level-0 tables, in log order
+  std::deque<Chunk*> full GUARDED_BY(mu);
+  bool reading GUARDED_BY(mu);
+  Status status GUARDED_BY(mu);  // First insert or table write error
+};
+
+void DBImpl::ReplayLogConcurrently(log::Reader* reader,
+                                   log::Reader::Reporter* reporter,
+                                   Status* status, VersionEdit* edit,
+                                   SequenceNumber* max_sequence,
+                                   int* compactions, MemTable** mem) {
+  mutex_.AssertHeld();
+  // Bounds the records and memtables held in memory
+  const size_t kMaxQueuedBatches = 1024;
+  const size_t kMaxFullChunks = 2;
+  ReplayState state;
+
+  // Inserts the batches into their memtables concurrently
+  auto insert = [this, &state]() {
+    MutexLock l(&state.mu);
+    while (true) {
+      while (state.batches.empty() && state.reading) {
+        state.cv.Wait();
+      }
+      if (state.batches.empty()) break;
+      WriteBatch batch = std::move(state.batches.front().first);
+      ReplayState::Chunk* chunk = state.batches.front().second;
+      state.batches.pop_front();
+      state.cv.SignalAll();  // Room in the queue
+      state.mu.Unlock();
+      Status s = WriteBatchInternal::InsertInto(&batch, chunk->mem, true);
+      MaybeIgnoreError(&s);
+      state.mu.Lock();
+      chunk->inserting--;
+      if (!s.ok() && state.status.ok()) {
+        state.status = s;
+      }
+      state.cv.SignalAll();
+    }
+  };
+
+  // Writes the full memtables to level-0 tables in log order, so newer
+  // records get larger file numbers
+  auto flush = [this, &state, edit]() {
+    MutexLock l(&state.mu);
+    while (true) {
+      while ((state.full.empty() && state.reading) ||
+             (!state.full.empty() && state.full.front()->inserting > 0)) {
+        state.cv.Wait();
+      }
+      if (state.full.empty()) break;
+      ReplayState::Chunk* chunk = state.full.front();
+      const bool write = state.status.ok();
+      state.mu.Unlock();
+      Status s;
+      if (write) {
+        MutexLock db_lock(&mutex_);
+        s = WriteLevel0Table(chunk->mem, edit, nullptr);
+      }
+      chunk->mem->Unref();
+      state.mu.Lock();
+      state.full.pop_front();
+      if (!s.ok() && state.status.ok()) {
+        state.status = s;
+      }
+      state.cv.SignalAll();
+    }
+  };
+
+  mutex_.Unlock();
+  std::vector<std::thread> threads;
+  for (int i = 0; i < options_.recovery_threads; i++) {
+    threads.emplace_back(insert);
+  }
+  threads.emplace_back(flush);
+
+  std::string scratch;
+  Slice record;
+  ReplayState::Chunk* chunk = nullptr;
+  while (reader->ReadRecord(&record, &scratch) && status->ok()) {
+    if (record.size() < 12) {
+      reporter->Corruption(record.size(),
+                           Status::Corruption("log record too small"));
+      continue;
+    }
+    WriteBatch batch;
+    WriteBatchInternal::SetContents(&batch, record);
+    const SequenceNumber last_seq = WriteBatchInternal::Sequence(&batch) +
+                                    WriteBatchInternal::Count(&batch) - 1;
+    if (last_seq > *max_sequence) {
+      *max_sequence = last_seq;
+    }
+
+    MutexLock l(&state.mu);
+    while (state.batches.size() >= kMaxQueuedBatches && state.status.ok()) {
+      state.cv.Wait();
+    }
+    if (!state.status.ok()) {
+      // Reflect errors immediately so that conditions like full
+      // file-systems cause the DB::Open() to fail.
+      break;
+    }
+    if (chunk == nullptr) {
+      MemTable* chunk_mem =
+          new MemTable(internal_comparator_, options_.int_key_memtable);
+      chunk_mem->Ref();
+      state.chunks.push_back(ReplayState::Chunk{chunk_mem, 0});
+      chunk = &state.chunks.back();
+    }
+    chunk->inserting++;
+    state.batches.emplace_back(std::move(batch), chunk);
+    state.cv.SignalAll();
+
+    if (chunk->mem->ApproximateMemoryUsage() > options_.write_buffer_size) {
+      (*compactions)++;
+      state.full.push_back(chunk);
+      chunk = nullptr;
+      while (state.full.size() > kMaxFullChunks && state.status.ok()) {
+        state.cv.Wait();
+      }
+    }
+  }
+
+  {
+    MutexLock l(&state.mu);
+    state.reading = false;
+    state.cv.SignalAll();
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  mutex_.Lock();
+
+  if (status->ok()) {
+    *status = state.status;
+  }
+  if (chunk != nullptr) {
+    // The last memtable is flushed or reused by the caller
+    *mem = chunk->mem;
+  }
+}
+
 Status DBImpl::WriteLevel0Table(MemTable* mem, VersionEdit* edit,
                                 Version* base) {
   mutex_.AssertHeld();
@@ -510,9 +913,11 @@ Status DBImpl::WriteLevel0Table(MemTable* mem, VersionEdit* edit,
       (unsigned long long)meta.number);
 
   Status s;
+  const bool vertical = layout_.ShouldVertical(0);
   {
     mutex_.Unlock();
-    s = BuildTable(dbname_, env_, options_, table_cache_, iter, &meta);
+    s = BuildTable(dbname_, env_, TableOptions(0), vertical, table_cache_, iter,
+                   &meta);
     mutex_.Lock();
   }
 
@@ -530,9 +935,14 @@ Status DBImpl::WriteLevel0Table(MemTable* mem, VersionEdit* edit,
     const Slice max_user_key = meta.largest.user_key();
     if (base != nullptr) {
       level = base->PickLevelForMemTableOutput(min_user_key, max_user_key);
+      // Only place the table on a level using its block format
+      while (level > 0 && layout_.ShouldVertical(level) != vertical) {
+        level--;
+      }
     }
     edit->AddFile(level, meta.number, meta.file_size, meta.smallest,
-                  meta.largest);
+                  meta.largest, meta.num_entries, meta.num_deletions);
+    table_formats_[meta.number] = vertical;
   }
 
   CompactionStats stats;
@@ -545,6 +955,10 @@ Status DBImpl::WriteLevel0Table(MemTable* mem, VersionEdit* edit,
 void DBImpl::CompactMemTable() {
   mutex_.AssertHeld();
   assert(imm_ != nullptr);
+  assert(!background_flush_running_);
+  background_flush_running_ = true;
+  // Other compactions need not stop for this memtable any more
+  has_imm_.store(false, std::memory_order_release);
 
   // Save the contents of the memtable as a new Table
   VersionEdit edit;
@@ -561,16 +975,19 @@ void DBImpl::CompactMemTable() {
   if (s.ok()) {
     edit.SetPrevLogNumber(0);
     edit.SetLogNumber(logfile_number_);  // Earlier logs no longer needed
-    s = versions_->LogAndApply(&edit, &mutex_);
+    s = LogAndApply(&edit);
   }
+  background_flush_running_ = false;
 
   if (s.ok()) {
     // Commit to the new state
     imm_->Unref();
     imm_ = nullptr;
     has_imm_.store(false, std::memory_order_release);
+    InstallSuperVersion();
     RemoveObsoleteFiles();
   } else {
+    has_imm_.store(true, std::memory_order_release);
     RecordBackgroundError(s);
   }
 }
@@ -657,17 +1074,19 @@ void DBImpl::RecordBackgroundError(const Status& s) {
 
 void DBImpl::MaybeScheduleCompaction() {
   mutex_.AssertHeld();
-  if (background_compaction_scheduled_) {
+  if (background_compactions_scheduled_ >=
+      std::max(options_.max_background_compactions, 1)) {
     // Already scheduled
   } else if (shutting_down_.load(std::memory_order_acquire)) {
     // DB is being deleted; no more background compactions
   } else if (!bg_error_.ok()) {
     // Already got an error; no more changes
-  } else if (imm_ == nullptr && manual_compaction_ == nullptr &&
-             !versions_->NeedsCompaction()) {
+  } else if ((imm_ == nullptr || background_flush_running_) &&
+             manual_compaction_ == nullptr && !versions_->NeedsCompaction() &&
+             !RelayoutDue()) {
     // No work to be done
   } else {
-    background_compaction_scheduled_ = true;
+    background_compactions_scheduled_++;
     env_->Schedule(&DBImpl::BGWork, this);
   }
 }
@@ -678,33 +1097,271 @@ void DBImpl::BGWork(void* db) {
 
 void DBImpl::BackgroundCall() {
   MutexLock l(&mutex_);
-  assert(background_compaction_scheduled_);
+  assert(background_compactions_scheduled_ > 0);
+  bool did_work = false;
   if (shutting_down_.load(std::memory_order_acquire)) {
     // No more background work when shutting down.
   } else if (!bg_error_.ok()) {
     // No more background work after a background error.
   } else {
-    BackgroundCompaction();
+    did_work = BackgroundCompaction();
   }
 
-  background_compaction_scheduled_ = false;
+  background_compactions_scheduled_--;
 
   // Previous compaction may have produced too many files in a level,
-  // so reschedule another compaction if needed.
-  MaybeScheduleCompaction();
+  // so reschedule another compaction if needed.  A call that found all
+  // work taken leaves the rescheduling to the calls that took it.
+  if (did_work) {
+    MaybeScheduleCompaction();
+  }
   background_work_finished_signal_.SignalAll();
 }
 
-void DBImpl::BackgroundCompaction() {
+void DBImpl::MaybeAdaptLayout() {
+  mutex_.AssertHeld();
+  if (options_.layout_adaptation_ops == 0 ||
+      workload_.Operations() < options_.layout_adaptation_ops) {
+    return;
+  }
+  const std::vector<colsm::Workload> workloads =
+      workload_.TakeWorkloads(config::kNumLevels);
+  colsm::Parameter param = cost_parameter_;
+  // Cost the levels with the merge policy in use
+  param.m = versions_->LevelingStart();
+  std::vector<colsm::Workload> padded(workloads);
+  padded.resize(std::max<size_t>(padded.size(), param.l),
+                colsm::Workload{0, 0, 0});
+  if (options_.tiered_compaction) {
+    // Levels above m are tiered, the formats are solved for that m
+    colsm::LevelSolver().SolveMergePolicy(param, padded);
+    const int leveling_start = versions_->LevelingStart();
+    versions_->SetLevelingStart(param.m);
+    param.m = versions_->LevelingStart();
+    if (param.m != leveling_start) {
+      Log(options_.info_log, "Leveling starts at level %d\n", param.m);
+    }
+  }
+  if (options_.dynamic_level_bytes) {
+    // A leveled level merges each update about t times, a tiered one once
+    const int size_factor = static_cast<int>(options_.size_factor);
+    colsm::LevelSolver().SolveFanouts(param, padded,
+                                      std::max(size_factor / 2, 2),
+                                      std::max(size_factor * 2, 2));
+    std::vector<int> fanouts(param.t);
+    fanouts.resize(config::kNumLevels, size_factor);
+    bool changed = false;
+    for (int level = 2; level < config::kNumLevels; level++) {
+      changed |= (fanouts[level] != versions_->Fanout(level));
+    }
+    if (changed) {
+      versions_->SetFanouts(fanouts);
+      std::string message;
+      for (int level = 2; level < config::kNumLevels; level++) {
+        message.append(" " + std::to_string(versions_->Fanout(level)));
+      }
+      Log(options_.info_log, "Level fanouts changed to%s\n", message.c_str());
+    }
+  }
+  if (layout_.Adapt(param, workloads)) {
+    std::string layout;
+    for (int level = 0; level < config::kNumLevels; level++) {
+      layout.push_back(layout_.ShouldVertical(level) ? 'V' : 'H');
+    }
+    Log(options_.info_log, "Layout changed to %s\n", layout.c_str());
+    UpdateReadWeights();
+    relayout_pending_.store(true, std::memory_order_relaxed);
+  } else if (options_.key_range_layout) {
+    // The format of a key range follows the new workloads too
+    relayout_pending_.store(true, std::memory_order_relaxed);
+  }
+}
+
+void DBImpl::UpdateReadWeights() {
+  mutex_.AssertHeld();
+  // A lookup in a vertical table costs v_epsilon / h_epsilon times one in a
+  // horizontal table, as far as the model tells
+  double vertical = 1;
+  if (cost_parameter_.h_epsilon > 0 && cost_parameter_.v_epsilon > 0) {
+    vertical = cost_parameter_.v_epsilon / cost_parameter_.h_epsilon;
+  }
+  for (int level = 0; level < config::kNumLevels; level++) {
+    versions_->SetReadWeight(level, layout_.ShouldVertical(level) ? vertical
+                                                                  : 1.0);
+  }
+}
+
+bool DBImpl::KeyRangeVertical(int level, const colsm::KeyRangeStats& range,
+                              const colsm::KeyRangeStats& level_stats) {
   mutex_.AssertHeld();
+  if (!options_.key_range_layout) {
+    return layout_.ShouldVertical(level);
+  }
+  return layout_.ShouldVertical(cost_parameter_, level, range, level_stats);
+}
 
-  if (imm_ != nullptr) {
+bool DBImpl::TrivialMoveKeepsFormat(Compaction* c) {
+  mutex_.AssertHeld();
+  const int level = c->level() + 1;
+  if (!options_.key_range_layout) {
+    return layout_.ShouldVertical(c->level()) == layout_.ShouldVertical(level);
+  }
+  FileMetaData* f = c->input(0, 0);
+  auto format = table_formats_.find(f->number);
+  const bool vertical = format != table_formats_.end()
+                            ? format->second
+                            : layout_.ShouldVertical(c->level());
+  return vertical ==
+         KeyRangeVertical(level, SumLookups({f}),
+                          SumLookups(versions_->current()->LevelFiles(level)));
+}
+
+bool DBImpl::RelayoutDue() {
+  mutex_.AssertHeld();
+  return options_.relayout_bytes_per_second > 0 &&
+         relayout_pending_.load(std::memory_order_relaxed) &&
+         !relayout_running_.load(std::memory_order_relaxed) &&
+         env_->NowMicros() >=
+             relayout_next_micros_.load(std::memory_order_relaxed);
+}
+
+bool DBImpl::BackgroundRelayout() {
+  mutex_.AssertHeld();
+  if (!RelayoutDue()) {
+    return false;
+  }
+
+  // Level-0 tables are ordered by file number, so they are not rewritten.
+  // They are compacted soon anyway. So are the runs of tiered levels, and of
+  // levels still holding several runs. With key range layouts, a table keeps
+  // the format it was written in until it serves lookups.
+  Version* current = versions_->current();
+  FileMetaData* f = nullptr;
+  int level = -1;
+  bool vertical = false;
+  uint32_t most_reads = 0;
+  for (int l = versions_->LevelingStart(); l < config::kNumLevels; l++) {
+    if (current->Overlapping(l)) {
+      continue;
+    }
+    const colsm::KeyRangeStats level_stats = SumLookups(current->LevelFiles(l));
+    for (FileMetaData* candidate : current->LevelFiles(l)) {
+      if (candidate->being_compacted) {
+        continue;
+      }
+      const colsm::KeyRangeStats range = SumLookups({candidate});
+      if (options_.key_range_layout &&
+          range.point_lookups + range.range_lookups == 0) {
+        continue;
+      }
+      const bool target = KeyRangeVertical(l, range, level_stats);
+      auto format = table_formats_.find(candidate->number);
+      if (format != table_formats_.end() && format->second == target) {
+        continue;
+      }
+      const uint32_t reads = candidate->reads.load(std::memory_order_relaxed);
+      if (f == nullptr || reads > most_reads) {
+        f = candidate;
+        level = l;
+        vertical = target;
+        most_reads = reads;
+      }
+    }
+  }
+  if (f == nullptr) {
+    relayout_pending_.store(false, std::memory_order_relaxed);
+    return false;
+  }
+
+  current->Ref();
+  f->being_compacted = true;
+  running_compactions_++;
+  relayout_running_.store(true, std::memory_order_relaxed);
+  auto format = table_formats_.find(f->number);
+  const bool known = format != table_formats_.end();
+  bool was_vertical = known && format->second;
+  FileMetaData meta;
+  meta.number = versions_->NewFileNumber();
+  pending_outputs_.insert(meta.number);
+
+  Status s;
+  bool rewrite = false;
+  {
+    mutex_.Unlock();
+    if (!known) {
+      was_vertical =
+          colsm::IsVerticalTable(env_, TableFileName(dbname_, f->number));
+    }
+    rewrite = (was_vertical != vertical);
+    if (rewrite) {
+      ReadOptions read_options;
+      read_options.fill_cache = false;
+      Iterator* iter =
+          table_cache_->NewIterator(read_options, f->number, f->file_size);
+      s = BuildTable(dbname_, env_, TableOptions(level), vertical, table_cache_,
+                     iter, &meta);
+      if (s.ok()) {
+        s = iter->status();
+      }
+      delete iter;
+    }
+    mutex_.Lock();
+  }
+
+  table_formats_[f->number] = was_vertical;
+  if (rewrite && s.ok()) {
+    VersionEdit edit;
+    edit.RemoveFile(level, f->number);
+    edit.AddFile(level, meta.number, meta.file_size, meta.smallest,
+                 meta.largest, meta.num_entries, meta.num_deletions);
+    s = LogAndApply(&edit);
+    if (s.ok()) {
+      table_formats_[meta.number] = vertical;
+      InstallSuperVersion();
+    }
+    Log(options_.info_log, "Relayout #%llu@%d => #%llu %s: %s\n",
+        static_cast<unsigned long long>(f->number), level,
+        static_cast<unsigned long long>(meta.number),
+        vertical ? "vertical" : "horizontal", s.ToString().c_str());
+
+    // Wait until the bytes written fit in the rate
+    const uint64_t now = env_->NowMicros();
+    relayout_next_micros_.store(
+        std::max(relayout_next_micros_.load(std::memory_order_relaxed), now) +
+            meta.file_size * 1000000 / options_.relayout_bytes_per_second,
+        std::memory_order_relaxed);
+  }
+  if (!s.ok()) {
+    RecordBackgroundError(s);
+  }
+  pending_outputs_.erase(meta.number);
+  f->being_compacted = false;
+  running_compactions_--;
+  relayout_running_.store(false, std::memory_order_relaxed);
+  current->Unref();
+  if (rewrite) {
+    RemoveObsoleteFiles();
+  }
+  return true;
+}
+
+bool DBImpl::BackgroundCompaction() {
+  mutex_.AssertHeld();
+  // Choose the format of the tables about to be written
+  MaybeAdaptLayout();
+
+  if (imm_ != nullptr && !background_flush_running_) {
     CompactMemTable();
-    return;
+    return true;
   }
 
   Compaction* c;
   bool is_manual = (manual_compaction_ != nullptr);
+  if (is_manual && running_compactions_ > 0) {
+    // A manual compaction runs alone, it starts once the running ones
+    // are done
+    return false;
+  }
   InternalKey manual_end;
   if (is_manual) {
     ManualCompaction* m = manual_compaction_;
@@ -720,20 +1377,37 @@ void DBImpl::BackgroundCompaction() {
         (m->done ? "(end)" : manual_end.DebugString().c_str()));
   } else {
     c = versions_->PickCompaction();
+    if (c == nullptr) {
+      // Nothing to do, or all of it is being compacted. Tables in the
+      // format their level no longer uses are rewritten at low priority.
+      return BackgroundRelayout();
+    }
+  }
+
+  // Let another background call pick a compaction that does not overlap
+  // this one
+  if (c != nullptr) {
+    c->MarkBeingCompacted(true);
+    running_compactions_++;
+    if (!is_manual) {
+      MaybeScheduleCompaction();
+    }
   }
 
   Status status;
   if (c == nullptr) {
     // Nothing to do
-  } else if (!is_manual && c->IsTrivialMove()) {
+  } else if (!is_manual && c->IsTrivialMove() && TrivialMoveKeepsFormat(c)) {
     // Move file to next level
     assert(c->num_input_files(0) == 1);
     FileMetaData* f = c->input(0, 0);
     c->edit()->RemoveFile(c->level(), f->number);
     c->edit()->AddFile(c->level() + 1, f->number, f->file_size, f->smallest,
-                       f->largest);
-    status = versions_->LogAndApply(c->edit(), &mutex_);
-    if (!status.ok()) {
+                       f->largest, f->num_entries, f->num_deletions);
+    status = LogAndApply(c->edit());
+    if (status.ok()) {
+      InstallSuperVersion();
+    } else {
       RecordBackgroundError(status);
     }
     VersionSet::LevelSummaryStorage tmp;
@@ -741,6 +1415,7 @@ void DBImpl::BackgroundCompaction() {
         static_cast<unsigned long long>(f->number), c->level() + 1,
         static_cast<unsigned long long>(f->file_size),
         status.ToString().c_str(), versions_->LevelSummary(&tmp));
+    c->MarkBeingCompacted(false);
   } else {
     CompactionState* compact = new CompactionState(c);
     status = DoCompactionWork(compact);
@@ -748,9 +1423,13 @@ void DBImpl::BackgroundCompaction() {
       RecordBackgroundError(status);
     }
     CleanupCompaction(compact);
+    c->MarkBeingCompacted(false);
     c->ReleaseInputs();
     RemoveObsoleteFiles();
   }
+  if (c != nullptr) {
+    running_compactions_--;
+  }
   delete c;
 
   if (status.ok()) {
@@ -774,6 +1453,7 @@ void DBImpl::BackgroundCompaction() {
     }
     manual_compaction_ = nullptr;
   }
+  return true;
 }
 
 void DBImpl::CleanupCompaction(CompactionState* compact) {
@@ -793,18 +1473,40 @@ void DBImpl::CleanupCompaction(CompactionState* compact) {
   delete compact;
 }
 
-Status DBImpl::OpenCompactionOutputFile(CompactionState* compact) {
+Status DBImpl::OpenCompactionOutputFile(CompactionState* compact,
+                                        const Slice& first) {
   assert(compact != nullptr);
   assert(compact->builder == nullptr);
+  const int level = compact->compaction->level() + 1;
   uint64_t file_number;
+  bool vertical;
   {
     mutex_.Lock();
+    // The output gets the format of the key range of the inputs that hold
+    // its first key, those of the output level if any
+    std::vector<FileMetaData*> inputs;
+    const Slice user_key = ExtractUserKey(first);
+    for (int which = 1; which >= 0 && inputs.empty(); which--) {
+      for (int i = 0; i < compact->compaction->num_input_files(which); i++) {
+        FileMetaData* f = compact->compaction->input(which, i);
+        if (user_comparator()->Compare(user_key, f->smallest.user_key()) >=
+                0 &&
+            user_comparator()->Compare(user_key, f->largest.user_key()) <= 0) {
+          inputs.push_back(f);
+        }
+      }
+    }
+    vertical = KeyRangeVertical(
+        level, SumLookups(inputs),
+        SumLookups(versions_->current()->LevelFiles(level)));
     file_number = versions_->NewFileNumber();
     pending_outputs_.insert(file_number);
     CompactionState::Output out;
     out.number = file_number;
     out.smallest.Clear();
     out.largest.Clear();
+    out.num_entries = 0;
+    out.num_deletions = 0;
     compact->outputs.push_back(out);
     mutex_.Unlock();
   }
@@ -813,9 +1515,9 @@ Status DBImpl::OpenCompactionOutputFile(CompactionState* compact) {
   std::string fname = TableFileName(dbname_, file_number);
   Status s = env_->NewWritableFile(fname, &compact->outfile);
   if (s.ok()) {
-    auto level = compact->compaction->level();
-    compact->builder = new TableBuilder(
-            options_, colsm::CostModel::INSTANCE->ShouldVertical(level), compact->outfile);
+    compact->current_output()->vertical = vertical;
+    compact->builder =
+        new TableBuilder(TableOptions(level), vertical, compact->outfile);
   }
   return s;
 }
@@ -839,6 +1541,7 @@ Status DBImpl::FinishCompactionOutputFile(CompactionState* compact,
   }
   const uint64_t current_bytes = compact->builder->FileSize();
   compact->current_output()->file_size = current_bytes;
+  compact->current_output()->num_entries = current_entries;
   compact->total_bytes += current_bytes;
   delete compact->builder;
   compact->builder = nullptr;
@@ -882,14 +1585,91 @@ Status DBImpl::InstallCompactionResults(CompactionState* compact) {
   for (size_t i = 0; i < compact->outputs.size(); i++) {
     const CompactionState::Output& out = compact->outputs[i];
     compact->compaction->edit()->AddFile(level + 1, out.number, out.file_size,
-                                         out.smallest, out.largest);
+                                         out.smallest, out.largest,
+                                         out.num_entries, out.num_deletions);
+    table_formats_[out.number] = out.vertical;
+  }
+  Status s = LogAndApply(compact->compaction->edit());
+  if (s.ok()) {
+    InstallSuperVersion();
+  }
+  return s;
+}
+
+Status DBImpl::LogAndApply(VersionEdit* edit) {
+  mutex_.AssertHeld();
+  // VersionSet::LogAndApply() releases mutex_ while writing the MANIFEST,
+  // so concurrent compactions take turns
+  while (manifest_writing_) {
+    manifest_written_signal_.Wait();
+  }
+  manifest_writing_ = true;
+  Status s = versions_->LogAndApply(edit, &mutex_);
+  manifest_writing_ = false;
+  manifest_written_signal_.SignalAll();
+  return s;
+}
+
+struct DBImpl::SubcompactionState {
+  SubcompactionState(DBImpl* db, const std::vector<CompactionState*>& ranges,
+                     const std::vector<Iterator*>& inputs)
+      : db(db),
+        ranges(ranges),
+        inputs(inputs),
+        cv(&mu),
+        next(0),
+        running(0),
+        refs(static_cast<int>(ranges.size())),
+        status(ranges.size()) {}
+
+  DBImpl* const db;
+  const std::vector<CompactionState*> ranges;
+  const std::vector<Iterator*> inputs;
+
+  port::Mutex mu;
+  port::CondVar cv GUARDED_BY(mu);
+  size_t next GUARDED_BY(mu);  // First range not merged by any thread
+  int running GUARDED_BY(mu);  // Ranges being merged
+  // The compaction and each scheduled call hold a reference.  A call that
+  // starts after every range is taken only drops its reference, and may
+  // run after the compaction is over.
+  int refs GUARDED_BY(mu);
+  std::vector<Status> status GUARDED_BY(mu);
+};
+
+void DBImpl::SubcompactionWork(void* arg) {
+  SubcompactionState* state = reinterpret_cast<SubcompactionState*>(arg);
+  MergeRanges(state);
+  UnrefSubcompactions(state);
+}
+
+void DBImpl::MergeRanges(SubcompactionState* state) {
+  state->mu.Lock();
+  while (state->next < state->ranges.size()) {
+    const size_t i = state->next++;
+    state->running++;
+    state->mu.Unlock();
+    Status s = state->db->DoCompactionRange(state->ranges[i], state->inputs[i]);
+    state->mu.Lock();
+    state->status[i] = s;
+    if (--state->running == 0) {
+      state->cv.SignalAll();
+    }
+  }
+  state->mu.Unlock();
+}
+
+void DBImpl::UnrefSubcompactions(SubcompactionState* state) {
+  state->mu.Lock();
+  const bool last = --state->refs == 0;
+  state->mu.Unlock();
+  if (last) {
+    delete state;
   }
-  return versions_->LogAndApply(compact->compaction->edit(), &mutex_);
 }
 
 Status DBImpl::DoCompactionWork(CompactionState* compact) {
   const uint64_t start_micros = env_->NowMicros();
-  int64_t imm_micros = 0;  // Micros spent doing imm_ compactions
 
   Log(options_.info_log, "Compacting %d@%d + %d@%d files",
       compact->compaction->num_input_files(0), compact->compaction->level(),
@@ -905,12 +1685,95 @@ Status DBImpl::DoCompactionWork(CompactionState* compact) {
     compact->smallest_snapshot = snapshots_.oldest()->sequence_number();
   }
 
-  Iterator* input = versions_->MakeInputIterator(compact->compaction);
+  // Split the input into key ranges of whole level+1 files, and merge them
+  // in parallel.  compact takes the first range.
+  const std::vector<std::string> splits =
+      compact->compaction->SplitKeys(options_.max_subcompactions);
+  std::vector<CompactionState*> ranges(1, compact);
+  for (size_t i = 0; i < splits.size(); i++) {
+    ranges.back()->end = &splits[i];
+    CompactionState* range = new CompactionState(compact->compaction);
+    range->start = &splits[i];
+    range->smallest_snapshot = compact->smallest_snapshot;
+    ranges.push_back(range);
+  }
+  std::vector<Iterator*> inputs;
+  for (size_t i = 0; i < ranges.size(); i++) {
+    inputs.push_back(versions_->MakeInputIterator(compact->compaction));
+  }
+  if (ranges.size() > 1) {
+    Log(options_.info_log, "Compacting in %d subcompactions",
+        static_cast<int>(ranges.size()));
+  }
 
   // Release mutex while we're actually doing the compaction work
   mutex_.Unlock();
 
-  input->SeekToFirst();
+  // The other ranges are scheduled on the Env's background threads, and
+  // this thread merges ranges too until none is left.  It never waits for
+  // a scheduled call that has not started, so a busy pool only slows the
+  // compaction down.
+  SubcompactionState* state = new SubcompactionState(this, ranges, inputs);
+  for (size_t i = 1; i < ranges.size(); i++) {
+    env_->Schedule(&DBImpl::SubcompactionWork, state);
+  }
+  MergeRanges(state);
+  Status status;
+  state->mu.Lock();
+  while (state->running > 0) {
+    state->cv.Wait();
+  }
+  for (size_t i = 0; i < ranges.size() && status.ok(); i++) {
+    status = state->status[i];
+  }
+  state->mu.Unlock();
+  UnrefSubcompactions(state);
+
+  CompactionStats stats;
+  stats.micros = env_->NowMicros() - start_micros;
+  for (size_t i = 0; i < ranges.size(); i++) {
+    stats.micros -= ranges[i]->imm_micros;
+    for (size_t j = 0; j < ranges[i]->outputs.size(); j++) {
+      stats.bytes_written += ranges[i]->outputs[j].file_size;
+    }
+  }
+  for (int which = 0; which < 2; which++) {
+    for (int i = 0; i < compact->compaction->num_input_files(which); i++) {
+      stats.bytes_read += compact->compaction->input(which, i)->file_size;
+    }
+  }
+
+  mutex_.Lock();
+  stats_[compact->compaction->level() + 1].Add(stats);
+
+  // Hand the outputs of the other ranges to compact, in key order
+  for (size_t i = 1; i < ranges.size(); i++) {
+    compact->outputs.insert(compact->outputs.end(), ranges[i]->outputs.begin(),
+                            ranges[i]->outputs.end());
+    compact->total_bytes += ranges[i]->total_bytes;
+    ranges[i]->outputs.clear();
+    CleanupCompaction(ranges[i]);
+  }
+
+  if (status.ok()) {
+    status = InstallCompactionResults(compact);
+  }
+  if (!status.ok()) {
+    RecordBackgroundError(status);
+  }
+  VersionSet::LevelSummaryStorage tmp;
+  Log(options_.info_log, "compacted to: %s", versions_->LevelSummary(&tmp));
+  return status;
+}
+
+Status DBImpl::DoCompactionRange(CompactionState* compact, Iterator* input) {
+  if (compact->start != nullptr) {
+    // Start at the newest entry of the first user key
+    InternalKey start(*compact->start, kMaxSequenceNumber, kValueTypeForSeek);
+    input->Seek(start.Encode());
+  } else {
+    input->SeekToFirst();
+  }
   Status status;
   ParsedInternalKey ikey;
   std::string current_user_key;
@@ -921,17 +1784,22 @@ Status DBImpl::DoCompactionWork(CompactionState* compact) {
     if (has_imm_.load(std::memory_order_relaxed)) {
       const uint64_t imm_start = env_->NowMicros();
       mutex_.Lock();
-      if (imm_ != nullptr) {
+      if (imm_ != nullptr && !background_flush_running_) {
         CompactMemTable();
         // Wake up MakeRoomForWrite() if necessary.
         background_work_finished_signal_.SignalAll();
       }
       mutex_.Unlock();
-      imm_micros += (env_->NowMicros() - imm_start);
+      compact->imm_micros += (env_->NowMicros() - imm_start);
     }
 
     Slice key = input->key();
-    if (compact->compaction->ShouldStopBefore(key) &&
+    if (compact->end != nullptr &&
+        user_comparator()->Compare(ExtractUserKey(key), *compact->end) >= 0) {
+      // The rest belongs to the next range
+      break;
+    }
+    if (compact->compaction->ShouldStopBefore(key, &compact->cursor) &&
         compact->builder != nullptr) {
       status = FinishCompactionOutputFile(compact, input);
       if (!status.ok()) {
@@ -961,7 +1829,8 @@ Status DBImpl::DoCompactionWork(CompactionState* compact) {
         drop = true;  // (A)
       } else if (ikey.type == kTypeDeletion &&
                  ikey.sequence <= compact->smallest_snapshot &&
-                 compact->compaction->IsBaseLevelForKey(ikey.user_key)) {
+                 compact->compaction->IsBaseLevelForKey(ikey.user_key,
+                                                        &compact->cursor)) {
         // For this user key:
         // (1) there is no data in higher levels
         // (2) data in lower levels will have larger sequence numbers
@@ -987,7 +1856,7 @@ Status DBImpl::DoCompactionWork(CompactionState* compact) {
     if (!drop) {
       // Open output file if necessary
       if (compact->builder == nullptr) {
-        status = OpenCompactionOutputFile(compact);
+        status = OpenCompactionOutputFile(compact, key);
         if (!status.ok()) {
           break;
         }
@@ -997,6 +1866,9 @@ Status DBImpl::DoCompactionWork(CompactionState* compact) {
       }
       compact->current_output()->largest.DecodeFrom(key);
       compact->builder->Add(key, input->value());
+      if (has_current_user_key && ikey.type == kTypeDeletion) {
+        compact->current_output()->num_deletions++;
+      }
 
       // Close output file if it is big enough
       if (compact->builder->FileSize() >=
@@ -1021,30 +1893,6 @@ Status DBImpl::DoCompactionWork(CompactionState* compact) {
     status = input->status();
   }
   delete input;
-  input = nullptr;
-
-  CompactionStats stats;
-  stats.micros = env_->NowMicros() - start_micros - imm_micros;
-  for (int which = 0; which < 2; which++) {
-    for (int i = 0; i < compact->compaction->num_input_files(which); i++) {
-      stats.bytes_read += compact->compaction->input(which, i)->file_size;
-    }
-  }
-  for (size_t i = 0; i < compact->outputs.size(); i++) {
-    stats.bytes_written += compact->outputs[i].file_size;
-  }
-
-  mutex_.Lock();
-  stats_[compact->compaction->level() + 1].Add(stats);
-
-  if (status.ok()) {
-    status = InstallCompactionResults(compact);
-  }
-  if (!status.ok()) {
-    RecordBackgroundError(status);
-  }
-  VersionSet::LevelSummaryStorage tmp;
-  Log(options_.info_log, "compacted to: %s", versions_->LevelSummary(&tmp));
   return status;
 }
 
@@ -1086,7 +1934,9 @@ Iterator* DBImpl::NewInternalIterator(const ReadOptions& options,
     list.push_back(imm_->NewIterator());
     imm_->Ref();
   }
-  versions_->current()->AddIterators(options, &list);
+  if (versions_->current()->AddIterators(options, &list)) {
+    MaybeScheduleCompaction();
+  }
   Iterator* internal_iter =
       NewMergingIterator(&internal_comparator_, &list[0], list.size());
   versions_->current()->Ref();
@@ -1110,10 +1960,110 @@ int64_t DBImpl::TEST_MaxNextLevelOverlappingBytes() {
   return versions_->MaxNextLevelOverlappingBytes();
 }
 
+size_t DBImpl::TEST_NumRetiredSuperVersions() {
+  MutexLock l(&mutex_);
+  return retired_super_versions_.size();
+}
+
+void DBImpl::InstallSuperVersion() {
+  mutex_.AssertHeld();
+  UpdateFilterAllocation();
+  SuperVersion* sv = new SuperVersion{mem_, imm_, versions_->current()};
+  sv->mem->Ref();
+  if (sv->imm != nullptr) sv->imm->Ref();
+  sv->current->Ref();
+  SuperVersion* old = super_version_.exchange(sv);
+  if (old != nullptr) {
+    retired_super_versions_.push_back(old);
+  }
+  ReclaimSuperVersions();
+}
+
+void DBImpl::ReclaimSuperVersions() {
+  mutex_.AssertHeld();
+  // A reader pins before checking the SuperVersion is still current, so a
+  // replaced SuperVersion not found in any slot cannot be pinned any more
+  std::set<SuperVersion*> pinned;
+  for (int i = 0; i < kNumReaderSlots; i++) {
+    SuperVersion* sv = reader_slots_[i].pinned.load();
+    if (sv != nullptr) {
+      pinned.insert(sv);
+    }
+  }
+  size_t kept = 0;
+  for (SuperVersion* sv : retired_super_versions_) {
+    if (pinned.count(sv) > 0) {
+      retired_super_versions_[kept++] = sv;
+    } else {
+      DeleteSuperVersion(sv);
+    }
+  }
+  retired_super_versions_.resize(kept);
+}
+
+void DBImpl::DeleteSuperVersion(SuperVersion* sv) {
+  mutex_.AssertHeld();
+  sv->mem->Unref();
+  if (sv->imm != nullptr) sv->imm->Unref();
+  sv->current->Unref();
+  delete sv;
+}
+
+DBImpl::SuperVersion* DBImpl::PinSuperVersion(ReaderSlot** slot) {
+  // Give each thread its own first slot to try, so readers rarely contend
+  static std::atomic<uint32_t> next_thread_slot(0);
+  thread_local uint32_t thread_slot =
+      next_thread_slot.fetch_add(1, std::memory_order_relaxed);
+
+  uint32_t index = thread_slot;
+  for (int i = 0; i < kNumReaderSlots; i++) {
+    ReaderSlot* candidate = &reader_slots_[index++ % kNumReaderSlots];
+    SuperVersion* sv = super_version_.load();
+    SuperVersion* expected = nullptr;
+    if (!candidate->pinned.compare_exchange_strong(expected, sv)) {
+      continue;  // Used by another reader
+    }
+    if (super_version_.load() == sv) {
+      *slot = candidate;
+      return sv;
+    }
+    // Replaced before it was pinned, retry with the new one
+    UnpinSuperVersion(sv, candidate);
+  }
+
+  // More readers than slots, reference the parts under the lock instead
+  MutexLock l(&mutex_);
+  SuperVersion* sv = new SuperVersion{mem_, imm_, versions_->current()};
+  sv->mem->Ref();
+  if (sv->imm != nullptr) sv->imm->Ref();
+  sv->current->Ref();
+  *slot = nullptr;
+  return sv;
+}
+
+void DBImpl::UnpinSuperVersion(SuperVersion* sv, ReaderSlot* slot) {
+  if (slot == nullptr) {
+    MutexLock l(&mutex_);
+    DeleteSuperVersion(sv);
+    return;
+  }
+  slot->pinned.store(nullptr);
+  // The last reader of a replaced SuperVersion frees it, rather than the
+  // next install
+  if (super_version_.load() != sv) {
+    MutexLock l(&mutex_);
+    ReclaimSuperVersions();
+  }
+}
+
 Status DBImpl::Get(const ReadOptions& options, const Slice& key,
                    std::string* value) {
   Status s;
-  MutexLock l(&mutex_);
+  ReaderSlot* slot;
+  SuperVersion* sv = PinSuperVersion(&slot);
+
+  // Take the sequence after pinning. A compaction in the pinned version only
+  // dropped the entries shadowed at an earlier sequence.
   SequenceNumber snapshot;
   if (options.snapshot != nullptr) {
     snapshot =
@@ -1122,42 +2072,52 @@ Status DBImpl::Get(const ReadOptions& options, const Slice& key,
     snapshot = versions_->LastSequence();
   }
 
-  MemTable* mem = mem_;
-  MemTable* imm = imm_;
-  Version* current = versions_->current();
-  mem->Ref();
-  if (imm != nullptr) imm->Ref();
-  current->Ref();
-
-  bool have_stat_update = false;
+  // First look in the memtable, then in the immutable memtable (if any).
   Version::GetStats stats;
-
-  // Unlock while reading from files and memtables
-  {
-    mutex_.Unlock();
-    // First look in the memtable, then in the immutable memtable (if any).
-    LookupKey lkey(key, snapshot);
-    if (mem->Get(lkey, value, &s)) {
-      // Done
-    } else if (imm != nullptr && imm->Get(lkey, value, &s)) {
-      // Done
-    } else {
-      s = current->Get(options, lkey, value, &stats);
-      have_stat_update = true;
+  stats.seek_file = nullptr;
+  stats.read_cost_exceeded = false;
+  LookupKey lkey(key, snapshot);
+  if (sv->mem->Get(lkey, value, &s)) {
+    // Done
+  } else if (sv->imm != nullptr && sv->imm->Get(lkey, value, &s)) {
+    // Done
+  } else {
+    s = sv->current->Get(options, lkey, value, &stats);
+    if (options_.layout_adaptation_ops > 0) {
+      workload_.RecordPointLookup(stats.probed_levels);
     }
-    mutex_.Lock();
   }
 
-  if (have_stat_update && current->UpdateStats(stats)) {
-    MaybeScheduleCompaction();
+  // Only lock if a seek is charged to a file, a file read in vain is due for
+  // compaction, or a table re-layout waited for its rate limit
+  if (stats.seek_file != nullptr || stats.read_cost_exceeded) {
+    MutexLock l(&mutex_);
+    if (sv->current->UpdateStats(stats)) {
+      MaybeScheduleCompaction();
+    }
   }
-  mem->Unref();
-  if (imm != nullptr) imm->Unref();
-  current->Unref();
+  if (options_.relayout_bytes_per_second > 0 &&
+      relayout_pending_.load(std::memory_order_relaxed) &&
+      !relayout_running_.load(std::memory_order_relaxed)) {
+    // At most one reader per millisecond schedules it
+    const uint64_t now = env_->NowMicros();
+    uint64_t polled = relayout_polled_micros_.load(std::memory_order_relaxed);
+    if (now >= relayout_next_micros_.load(std::memory_order_relaxed) &&
+        now >= polled + 1000 &&
+        relayout_polled_micros_.compare_exchange_strong(
+            polled, now, std::memory_order_relaxed)) {
+      MutexLock l(&mutex_);
+      MaybeScheduleCompaction();
+    }
+  }
+  UnpinSuperVersion(sv, slot);
   return s;
 }
 
 Iterator* DBImpl::NewIterator(const ReadOptions& options) {
+  if (options_.layout_adaptation_ops > 0) {
+    workload_.RecordRangeLookup();
+  }
   SequenceNumber latest_snapshot;
   uint32_t seed;
   Iterator* iter = NewInternalIterator(options, &latest_snapshot, &seed);
@@ -1166,7 +2126,8 @@ Iterator* DBImpl::NewIterator(const ReadOptions& options) {
                             ? static_cast<const SnapshotImpl*>(options.snapshot)
                                   ->sequence_number()
                             : latest_snapshot),
-                       seed);
+                       seed, options.iterate_lower_bound,
+                       options.iterate_upper_bound);
 }
 
 void DBImpl::RecordReadSample(Slice key) {
@@ -1196,6 +2157,9 @@ Status DBImpl::Delete(const WriteOptions& options, const Slice& key) {
 }
 
 Status DBImpl::Write(const WriteOptions& options, WriteBatch* updates) {
+  if (updates != nullptr && options_.layout_adaptation_ops > 0) {
+    workload_.RecordUpdates(WriteBatchInternal::Count(updates));
+  }
   Writer w(&mutex_);
   w.batch = updates;
   w.sync = options.sync;
@@ -1203,12 +2167,34 @@ Status DBImpl::Write(const WriteOptions& options, WriteBatch* updates) {
 
   MutexLock l(&mutex_);
   writers_.push_back(&w);
-  while (!w.done && &w != writers_.front()) {
+  // A pipelined group leaves writers_ once logged, so writers_ may be empty
+  while (!w.done && !w.insert &&
+         (writers_.empty() || &w != writers_.front())) {
     w.cv.Wait();
   }
+  if (w.insert) {
+    // The leader logged our batch, apply it along with the rest of the group
+    MemTable* mem = mem_;
+    mutex_.Unlock();
+    Status s = WriteBatchInternal::InsertInto(w.batch, mem, true);
+    mutex_.Lock();
+    w.insert = false;
+    if (!s.ok() && w.leader->status.ok()) {
+      w.leader->status = s;
+    }
+    if (--w.leader->pending_inserts == 0) {
+      w.leader->cv.Signal();
+    }
+    while (!w.done) {
+      w.cv.Wait();
+    }
+  }
   if (w.done) {
     return w.status;
   }
+  if (options_.enable_pipelined_write) {
+    return PipelinedWrite(&w);
+  }
 
   // May temporarily unlock and wait.
   Status status = MakeRoomForWrite(updates == nullptr);
@@ -1218,6 +2204,8 @@ Status DBImpl::Write(const WriteOptions& options, WriteBatch* updates) {
     WriteBatch* write_batch = BuildBatchGroup(&last_writer);
     WriteBatchInternal::SetSequence(write_batch, last_sequence + 1);
     last_sequence += WriteBatchInternal::Count(write_batch);
+    const bool concurrent =
+        options_.allow_concurrent_memtable_write && last_writer != &w;
 
     // Add to log and apply to memtable.  We can release the lock
     // during this phase since &w is currently responsible for logging
@@ -1233,7 +2221,7 @@ Status DBImpl::Write(const WriteOptions& options, WriteBatch* updates) {
           sync_error = true;
         }
       }
-      if (status.ok()) {
+      if (status.ok() && !concurrent) {
         status = WriteBatchInternal::InsertInto(write_batch, mem_);
       }
       mutex_.Lock();
@@ -1244,6 +2232,9 @@ Status DBImpl::Write(const WriteOptions& options, WriteBatch* updates) {
         RecordBackgroundError(status);
       }
     }
+    if (status.ok() && concurrent) {
+      status = InsertGroupConcurrently(last_writer);
+    }
     if (write_batch == tmp_batch_) tmp_batch_->Clear();
 
     versions_->SetLastSequence(last_sequence);
@@ -1268,6 +2259,125 @@ Status DBImpl::Write(const WriteOptions& options, WriteBatch* updates) {
   return status;
 }
 
+// REQUIRES: w is at the front of writers_
+Status DBImpl::PipelinedWrite(Writer* w) {
+  mutex_.AssertHeld();
+  // May temporarily unlock and wait.
+  Status status = MakeRoomForWrite(w->batch == nullptr);
+  Writer* last_writer = w;
+  std::vector<Writer*> group;
+  bool logged = false;
+  if (status.ok() && w->batch != nullptr) {
+    logged = true;
+    WriteBatch* write_batch = BuildBatchGroup(&last_writer);
+    // Groups still in the memtable stage have not published their sequences
+    SequenceNumber last_sequence = memtable_writers_.empty()
+                                       ? versions_->LastSequence()
+                                       : memtable_writers_.back()->last_sequence;
+    WriteBatchInternal::SetSequence(write_batch, last_sequence + 1);
+    w->last_sequence = last_sequence + WriteBatchInternal::Count(write_batch);
+
+    // Only the front of writers_ logs, so the log is written in sequence
+    // order while earlier groups are still applying to mem_
+    mutex_.Unlock();
+    status = log_->AddRecord(WriteBatchInternal::Contents(write_batch));
+    bool sync_error = false;
+    if (status.ok() && w->sync) {
+      status = logfile_->Sync();
+      if (!status.ok()) {
+        sync_error = true;
+      }
+    }
+    mutex_.Lock();
+    if (sync_error) {
+      // The state of the log file is indeterminate, see Write()
+      RecordBackgroundError(status);
+    }
+    if (write_batch == tmp_batch_) tmp_batch_->Clear();
+  }
+
+  // Leave writers_ so the next group can start logging
+  while (true) {
+    Writer* ready = writers_.front();
+    writers_.pop_front();
+    group.push_back(ready);
+    if (ready == last_writer) break;
+  }
+  if (!writers_.empty()) {
+    writers_.front()->cv.Signal();
+  }
+
+  if (logged) {
+    // Apply the groups to mem_ one at a time, in the order they were logged
+    memtable_writers_.push_back(w);
+    while (memtable_writers_.front() != w) {
+      w->cv.Wait();
+    }
+    if (status.ok()) {
+      MemTable* mem = mem_;
+      SequenceNumber sequence = versions_->LastSequence() + 1;
+      mutex_.Unlock();
+      // tmp_batch_ already holds the next group, apply the writers' batches
+      for (Writer* member : group) {
+        if (member->batch != nullptr && status.ok()) {
+          WriteBatchInternal::SetSequence(member->batch, sequence);
+          sequence += WriteBatchInternal::Count(member->batch);
+          status = WriteBatchInternal::InsertInto(member->batch, mem);
+        }
+      }
+      mutex_.Lock();
+    }
+    versions_->SetLastSequence(w->last_sequence);
+    memtable_writers_.pop_front();
+    if (memtable_writers_.empty()) {
+      memtable_writers_drained_signal_.SignalAll();
+    } else {
+      memtable_writers_.front()->cv.Signal();
+    }
+  }
+
+  for (Writer* ready : group) {
+    if (ready != w) {
+      ready->status = status;
+      ready->done = true;
+      ready->cv.Signal();
+    }
+  }
+  return status;
+}
+
+// REQUIRES: the group up to last_writer is logged
+Status DBImpl::InsertGroupConcurrently(Writer* last_writer) {
+  mutex_.AssertHeld();
+  Writer* leader = writers_.front();
+  SequenceNumber sequence = versions_->LastSequence() + 1;
+  for (Writer* w : writers_) {
+    if (w->batch != nullptr) {
+      WriteBatchInternal::SetSequence(w->batch, sequence);
+      sequence += WriteBatchInternal::Count(w->batch);
+      if (w != leader) {
+        w->insert = true;
+        w->leader = leader;
+        leader->pending_inserts++;
+        w->cv.Signal();
+      }
+    }
+    if (w == last_writer) break;
+  }
+
+  MemTable* mem = mem_;
+  mutex_.Unlock();
+  Status status = WriteBatchInternal::InsertInto(leader->batch, mem, true);
+  mutex_.Lock();
+  while (leader->pending_inserts > 0) {
+    leader->cv.Wait();
+  }
+  if (status.ok()) {
+    status = leader->status;
+  }
+  return status;
+}
+
 // REQUIRES: Writer list must be non-empty
 // REQUIRES: First writer must have a non-null batch
 WriteBatch* DBImpl::BuildBatchGroup(Writer** last_writer) {
@@ -1355,26 +2465,25 @@ Status DBImpl::MakeRoomForWrite(bool force) {
       // There are too many level-0 files.
       Log(options_.info_log, "Too many L0 files; waiting...\n");
       background_work_finished_signal_.Wait();
+    } else if (!memtable_writers_.empty()) {
+      // Pipelined groups logged to the current log must reach mem_ before
+      // it is switched out
+      memtable_writers_drained_signal_.Wait();
     } else {
       // Attempt to switch to a new memtable and trigger compaction of old
       assert(versions_->PrevLogNumber() == 0);
       uint64_t new_log_number = versions_->NewFileNumber();
-      WritableFile* lfile = nullptr;
-      s = env_->NewWritableFile(LogFileName(dbname_, new_log_number), &lfile);
+      s = NewLogFile(new_log_number);
       if (!s.ok()) {
         // Avoid chewing through file number space in a tight loop.
         versions_->ReuseFileNumber(new_log_number);
         break;
       }
-      delete log_;
-      delete logfile_;
-      logfile_ = lfile;
-      logfile_number_ = new_log_number;
-      log_ = new log::Writer(lfile);
       imm_ = mem_;
       has_imm_.store(true, std::memory_order_release);
-      mem_ = new MemTable(internal_comparator_);
+      mem_ = new MemTable(internal_comparator_, options_.int_key_memtable);
       mem_->Ref();
+      InstallSuperVersion();
       force = false;  // Do not force another compaction if have room
       MaybeScheduleCompaction();
     }
@@ -1426,6 +2535,40 @@ bool DBImpl::GetProperty(const Slice& property, std::string* value) {
   } else if (in == "sstables") {
     *value = versions_->current()->DebugString();
     return true;
+  } else if (in == "layout") {
+    for (int level = 0; level < config::kNumLevels; level++) {
+      value->push_back(layout_.ShouldVertical(level) ? 'V' : 'H');
+    }
+    return true;
+  } else if (in == "merge-policy") {
+    // Level-0 is always tiered
+    for (int level = 0; level < config::kNumLevels; level++) {
+      value->push_back(level < versions_->LevelingStart() ? 'T' : 'L');
+    }
+    return true;
+  } else if (in == "level-fanouts") {
+    if (!options_.dynamic_level_bytes) {
+      return false;
+    }
+    for (int level = 2; level < config::kNumLevels; level++) {
+      if (level > 2) {
+        value->push_back(' ');
+      }
+      value->append(std::to_string(versions_->Fanout(level)));
+    }
+    return true;
+  } else if (in == "filter-bits-per-key") {
+    if (budget_filter_policies_.empty()) {
+      return false;
+    }
+    for (int level = 0; level < config::kNumLevels; level++) {
+      if (level > 0) {
+        value->push_back(' ');
+      }
+      value->append(std::to_string(
+          level_filter_bits_[level].load(std::memory_order_relaxed)));
+    }
+    return true;
   } else if (in == "approximate-memory-usage") {
     size_t total_usage = options_.block_cache->TotalCharge();
     if (mem_) {
@@ -1486,19 +2629,28 @@ Status DB::Open(const Options& options, const std::string& dbname, DB** dbptr) {
   VersionEdit edit;
   // Recover handles create_if_missing, error_if_exists
   bool save_manifest = false;
-  Status s = impl->Recover(&edit, &save_manifest);
+  Status s;
+  if (options.filter_policy != nullptr && options.filter_memory_budget > 0 &&
+      impl->budget_filter_policies_.empty()) {
+    s = Status::InvalidArgument("filter_memory_budget",
+                                "filter_policy cannot size its filters");
+  }
+  if (s.ok() && options.cost_parameter_file != nullptr) {
+    s = colsm::ReadParameterFile(impl->env_, options.cost_parameter_file,
+                                 &impl->cost_parameter_);
+  }
+  if (s.ok()) {
+    impl->UpdateReadWeights();
+    s = impl->Recover(&edit, &save_manifest);
+  }
   if (s.ok() && impl->mem_ == nullptr) {
     // Create new log and a corresponding memtable.
     uint64_t new_log_number = impl->versions_->NewFileNumber();
-    WritableFile* lfile;
-    s = options.env->NewWritableFile(LogFileName(dbname, new_log_number),
-                                     &lfile);
+    s = impl->NewLogFile(new_log_number);
     if (s.ok()) {
       edit.SetLogNumber(new_log_number);
-      impl->logfile_ = lfile;
-      impl->logfile_number_ = new_log_number;
-      impl->log_ = new log::Writer(lfile);
-      impl->mem_ = new MemTable(impl->internal_comparator_);
+      impl->mem_ = new MemTable(impl->internal_comparator_,
+                                impl->options_.int_key_memtable);
       impl->mem_->Ref();
     }
   }
@@ -1508,6 +2660,7 @@ Status DB::Open(const Options& options, const std::string& dbname, DB** dbptr) {
     s = impl->versions_->LogAndApply(&edit, &impl->mutex_);
   }
   if (s.ok()) {
+    impl->InstallSuperVersion();
     impl->RemoveObsoleteFiles();
     impl->MaybeScheduleCompaction();
   }
@@ -7,26 +7,60 @@
 
 #include <atomic>
 #include <deque>
+#include <map>
+#include <memory>
 #include <set>
 #include <string>
+#include <vector>
 
 #include "db/dbformat.h"
+#include "db/log_reader.h"
 #include "db/log_writer.h"
 #include "db/snapshot.h"
 #include "leveldb/db.h"
 #include "leveldb/env.h"
+#include "leveldb/persistent_cache.h"
 #include "port/port.h"
 #include "port/thread_annotations.h"
 #include "colsm/cost/cost_model.h"
 
 namespace leveldb {
 
+class Compaction;
 class MemTable;
 class TableCache;
 class Version;
 class VersionEdit;
 class VersionSet;
 
+// Forwards to a persistent cache until closed.  A DB that creates its own
+// block cache spills into the persistent cache through this, so the blocks
+// dropped when it deletes the block cache on close are not written out.
+class ClosablePersistentCache : public PersistentCache {
+ public:
+  explicit ClosablePersistentCache(PersistentCache* target)
+      : target_(target), closed_(false) {}
+
+  // Drop the inserts from now on
+  void Close() { closed_.store(true, std::memory_order_release); }
+
+  void Insert(const Slice& key, const Slice& contents) override {
+    if (!closed_.load(std::memory_order_acquire)) {
+      target_->Insert(key, contents);
+    }
+  }
+
+  bool Lookup(const Slice& key, std::string* contents) override {
+    return target_->Lookup(key, contents);
+  }
+
+  size_t TotalCharge() const override { return target_->TotalCharge(); }
+
+ private:
+  PersistentCache* const target_;
+  std::atomic<bool> closed_;
+};
+
 class DBImpl : public DB {
  public:
   DBImpl(const Options& options, const std::string& dbname);
@@ -67,6 +101,9 @@ class DBImpl : public DB {
   // file at a level >= 1.
   int64_t TEST_MaxNextLevelOverlappingBytes();
 
+  // Return the number of replaced SuperVersions not freed yet
+  size_t TEST_NumRetiredSuperVersions();
+
   // Record a sample of bytes read at the specified internal key.
   // Samples are taken approximately once every config::kReadBytesPeriod
   // bytes.
@@ -76,6 +113,8 @@ class DBImpl : public DB {
   friend class DB;
   struct CompactionState;
   struct Writer;
+  struct ReplayState;
+  struct SubcompactionState;
 
   // Information for a manual compaction
   struct ManualCompaction {
@@ -119,6 +158,13 @@ class DBImpl : public DB {
   // Delete any unneeded files and stale in-memory entries.
   void RemoveObsoleteFiles() EXCLUSIVE_LOCKS_REQUIRED(mutex_);
 
+  // Returns true if the obsolete log file "number" is kept to be recycled
+  bool KeepLogForRecycling(uint64_t number) EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+  // Create log file "number", recycling an obsolete log file if there is one,
+  // and make it the current log
+  Status NewLogFile(uint64_t number) EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
   // Compact the in-memory write buffer to disk.  Switches to a new
   // log-file/memtable and writes a new descriptor iff successful.
   // Errors are recorded in bg_error_.
@@ -128,6 +174,15 @@ class DBImpl : public DB {
                         VersionEdit* edit, SequenceNumber* max_sequence)
       EXCLUSIVE_LOCKS_REQUIRED(mutex_);
 
+  // Replay the records of reader with options_.recovery_threads threads
+  // inserting into memtables.  Full memtables are written to level-0 tables
+  // on another thread, the last one is stored in *mem.
+  void ReplayLogConcurrently(log::Reader* reader,
+                             log::Reader::Reporter* reporter, Status* status,
+                             VersionEdit* edit, SequenceNumber* max_sequence,
+                             int* compactions, MemTable** mem)
+      EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
   Status WriteLevel0Table(MemTable* mem, VersionEdit* edit, Version* base)
       EXCLUSIVE_LOCKS_REQUIRED(mutex_);
 
@@ -135,23 +190,107 @@ class DBImpl : public DB {
       EXCLUSIVE_LOCKS_REQUIRED(mutex_);
   WriteBatch* BuildBatchGroup(Writer** last_writer)
       EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  // Have every writer of the group up to last_writer insert its own batch
+  // into mem_, and wait for all of them
+  Status InsertGroupConcurrently(Writer* last_writer)
+      EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  // Log the group led by w, hand it to the memtable stage so the next group
+  // can be logged, then apply it to mem_ and publish its sequence in order
+  Status PipelinedWrite(Writer* w) EXCLUSIVE_LOCKS_REQUIRED(mutex_);
 
   void RecordBackgroundError(const Status& s);
 
   void MaybeScheduleCompaction() EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  // Re-solve layout_ if enough operations were tracked since the last time
+  void MaybeAdaptLayout() EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  // Weigh the wasted reads of each level by the cost of a read in its format
+  void UpdateReadWeights() EXCLUSIVE_LOCKS_REQUIRED(mutex_);
   static void BGWork(void* db);
   void BackgroundCall();
-  void BackgroundCompaction() EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  // Returns true if it did some work, false if all pending work is taken
+  // by other background calls
+  bool BackgroundCompaction() EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  // Is a re-layout of tables allowed to start now and maybe needed?
+  bool RelayoutDue() EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  // Rewrite the most read table whose block format differs from its
+  // level's in that format.  Returns false if there was none.
+  bool BackgroundRelayout() EXCLUSIVE_LOCKS_REQUIRED(mutex_);
   void CleanupCompaction(CompactionState* compact)
       EXCLUSIVE_LOCKS_REQUIRED(mutex_);
   Status DoCompactionWork(CompactionState* compact)
       EXCLUSIVE_LOCKS_REQUIRED(mutex_);
-
-  Status OpenCompactionOutputFile(CompactionState* compact);
+  // Merge the input of compact's key range into its outputs and delete input
+  Status DoCompactionRange(CompactionState* compact, Iterator* input)
+      LOCKS_EXCLUDED(mutex_);
+  // Merge the key ranges of a compaction on a background thread
+  static void SubcompactionWork(void* state);
+  // Merge the ranges of state no other thread took yet
+  static void MergeRanges(SubcompactionState* state);
+  static void UnrefSubcompactions(SubcompactionState* state);
+
+  // Apply *edit to the current version, waiting for the edits of concurrent
+  // compactions to be written first
+  Status LogAndApply(VersionEdit* edit) EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+  // Open the output that starts at internal key "first"
+  Status OpenCompactionOutputFile(CompactionState* compact, const Slice& first);
   Status FinishCompactionOutputFile(CompactionState* compact, Iterator* input);
   Status InstallCompactionResults(CompactionState* compact)
       EXCLUSIVE_LOCKS_REQUIRED(mutex_);
 
+  // Options to build a table of the given output level
+  Options TableOptions(int level) const;
+
+  // Split Options::filter_memory_budget between the levels of the current
+  // version
+  void UpdateFilterAllocation() EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  static const int kMaxFilterBitsPerKey = 32;
+
+  // Block format of the tables written to a level for a key range whose
+  // tables served the lookups of "range", while those of the whole level
+  // served "level_stats".  The format of the level unless
+  // Options::key_range_layout is set.
+  bool KeyRangeVertical(int level, const colsm::KeyRangeStats& range,
+                        const colsm::KeyRangeStats& level_stats)
+      EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  // Is the table a trivial move would put one level down in the format it
+  // should have there?
+  bool TrivialMoveKeepsFormat(Compaction* c) EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+  // The memtables and the version a read needs. A new SuperVersion is
+  // installed whenever one of them changes, so Get() can use them without
+  // locking mutex_.
+  struct SuperVersion {
+    MemTable* mem;
+    MemTable* imm;
+    Version* current;
+  };
+
+  // A reader publishes the SuperVersion it uses in a slot, so it is not
+  // freed under the reader (a hazard pointer)
+  struct alignas(64) ReaderSlot {
+    std::atomic<SuperVersion*> pinned{nullptr};
+  };
+  static const int kNumReaderSlots = 64;
+
+  // Install a SuperVersion of mem_, imm_ and the current version
+  void InstallSuperVersion() EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+  // Free the replaced SuperVersions that no reader uses
+  void ReclaimSuperVersions() EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+  // Drop the references of a SuperVersion and free it
+  void DeleteSuperVersion(SuperVersion* sv) EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+  // Pin the current SuperVersion in a free slot, stored in *slot. If every
+  // slot is taken, return a copy holding its own references instead, and
+  // store nullptr in *slot.
+  SuperVersion* PinSuperVersion(ReaderSlot** slot) LOCKS_EXCLUDED(mutex_);
+
+  // Release a SuperVersion returned by PinSuperVersion()
+  void UnpinSuperVersion(SuperVersion* sv, ReaderSlot* slot)
+      LOCKS_EXCLUDED(mutex_);
+
   const Comparator* user_comparator() const {
     return internal_comparator_.user_comparator();
   }
@@ -160,6 +299,13 @@ class DBImpl : public DB {
   Env* const env_;
   const InternalKeyComparator internal_comparator_;
   const InternalFilterPolicy internal_filter_policy_;
+  // Used by the block cache the DB creates, if any
+  ClosablePersistentCache closable_persistent_cache_;
+  // Options::filter_policy with 1 to kMaxFilterBitsPerKey bits per key and
+  // their wrappers, empty unless Options::filter_memory_budget is positive
+  // and the policy can size its filters
+  std::vector<std::unique_ptr<const FilterPolicy>> sized_filter_policies_;
+  std::vector<std::unique_ptr<InternalFilterPolicy>> budget_filter_policies_;
   const Options options_;  // options_.comparator == &internal_comparator_
   const bool owns_info_log_;
   const bool owns_cache_;
@@ -177,24 +323,45 @@ class DBImpl : public DB {
   port::CondVar background_work_finished_signal_ GUARDED_BY(mutex_);
   MemTable* mem_;
   MemTable* imm_ GUARDED_BY(mutex_);  // Memtable being compacted
-  std::atomic<bool> has_imm_;         // So bg thread can detect non-null imm_
+  std::atomic<bool> has_imm_;  // So bg threads can detect imm_ awaiting flush
   WritableFile* logfile_;
   uint64_t logfile_number_ GUARDED_BY(mutex_);
   log::Writer* log_;
   uint32_t seed_ GUARDED_BY(mutex_);  // For sampling.
 
+  // Obsolete log files kept to be recycled, see Options::recycle_log_file_num.
+  // Only logs numbered from first_recyclable_log_ on (0 if none yet) were
+  // written in the recyclable format by this DBImpl.
+  std::deque<uint64_t> recycle_logs_ GUARDED_BY(mutex_);
+  uint64_t first_recyclable_log_ GUARDED_BY(mutex_);
+
   // Queue of writers.
   std::deque<Writer*> writers_ GUARDED_BY(mutex_);
   WriteBatch* tmp_batch_ GUARDED_BY(mutex_);
 
+  // Leaders of pipelined write groups that are logged but not yet applied
+  // to mem_, in sequence order.  See Options::enable_pipelined_write
+  std::deque<Writer*> memtable_writers_ GUARDED_BY(mutex_);
+  port::CondVar memtable_writers_drained_signal_ GUARDED_BY(mutex_);
+
   SnapshotList snapshots_ GUARDED_BY(mutex_);
 
   // Set of table files to protect from deletion because they are
   // part of ongoing compactions.
   std::set<uint64_t> pending_outputs_ GUARDED_BY(mutex_);
 
-  // Has a background compaction been scheduled or is running?
-  bool background_compaction_scheduled_ GUARDED_BY(mutex_);
+  // Number of background compactions scheduled or running
+  int background_compactions_scheduled_ GUARDED_BY(mutex_);
+
+  // Is imm_ being compacted?
+  bool background_flush_running_ GUARDED_BY(mutex_);
+
+  // Number of table compactions running
+  int running_compactions_ GUARDED_BY(mutex_);
+
+  // Is a LogAndApply() writing the MANIFEST?
+  bool manifest_writing_ GUARDED_BY(mutex_);
+  port::CondVar manifest_written_signal_ GUARDED_BY(mutex_);
 
   ManualCompaction* manual_compaction_ GUARDED_BY(mutex_);
 
@@ -204,6 +371,34 @@ class DBImpl : public DB {
   Status bg_error_ GUARDED_BY(mutex_);
 
   CompactionStats stats_[config::kNumLevels] GUARDED_BY(mutex_);
+
+  // Format of the tables written to each level, re-solved for the tracked
+  // workload every Options::layout_adaptation_ops operations
+  colsm::CostModel layout_;
+  colsm::WorkloadTracker workload_;
+  // Only changed by DB::Open, before any background work
+  colsm::Parameter cost_parameter_;
+
+  // Block format of the tables known to be vertical or not, tables written
+  // before the DB was opened are probed by the re-layout job
+  std::map<uint64_t, bool> table_formats_ GUARDED_BY(mutex_);
+  // Some table may have a block format its level does not use.  Read by
+  // Get() without the lock, like the three below
+  std::atomic<bool> relayout_pending_;
+  std::atomic<bool> relayout_running_;
+  // Earliest time the next table may be rewritten, for the rate limit
+  std::atomic<uint64_t> relayout_next_micros_;
+  // Last time a reader scheduled the re-layout job
+  std::atomic<uint64_t> relayout_polled_micros_;
+
+  // Bits per key of the filters of the tables written to each level under
+  // Options::filter_memory_budget, 0 for no filter and -1 for filter_policy
+  // until the levels hold counted tables.  Read without the lock.
+  std::atomic<int> level_filter_bits_[config::kNumLevels];
+
+  std::atomic<SuperVersion*> super_version_;
+  ReaderSlot reader_slots_[kNumReaderSlots];
+  std::vector<SuperVersion*> retired_super_versions_ GUARDED_BY(mutex_);
 };
 
 // Sanitize db options.  The caller should delete result.info_log if
@@ -211,6 +406,7 @@ class DBImpl : public DB {
 Options SanitizeOptions(const std::string& db,
                         const InternalKeyComparator* icmp,
                         const InternalFilterPolicy* ipolicy,
+                        ClosablePersistentCache* persistent_cache,
                         const Options& src);
 
 }  // namespace leveldb
@@ -0,0 +1,177 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#include "colsm/comparators.h"
+#include "gtest/gtest.h"
+#include "helpers/memenv/memenv.h"
+#include "leveldb/db.h"
+#include "leveldb/env.h"
+#include "util/coding.h"
+#include "util/logging.h"
+
+namespace leveldb {
+
+static std::string Key(uint32_t i) {
+  std::string result;
+  PutFixed32(&result, i);
+  return result;
+}
+
+static std::string Value(uint32_t i) {
+  std::string result = std::to_string(i);
+  result.resize(1000, 'v');
+  return result;
+}
+
+class DynamicLevelBytesTest : public testing::Test {
+ public:
+  DynamicLevelBytesTest()
+      : env_(NewMemEnv(Env::Default())),
+        comparator_(colsm::intComparator()),
+        db_(nullptr) {
+    Open(CurrentOptions());
+  }
+
+  ~DynamicLevelBytesTest() { delete db_; }
+
+  Options CurrentOptions() {
+    Options options;
+    options.env = env_.get();
+    options.comparator = comparator_.get();
+    options.create_if_missing = true;
+    options.compression = kNoCompression;
+    options.write_buffer_size = 64 * 1024;
+    options.max_file_size = kFileSize;
+    options.size_factor = kSizeFactor;
+    options.dynamic_level_bytes = true;
+    return options;
+  }
+
+  void Open(const Options& options) {
+    delete db_;
+    db_ = nullptr;
+    EXPECT_TRUE(DB::Open(options, "/dynamicdb", &db_).ok());
+  }
+
+  // Table bytes of each level
+  void LevelBytes(std::vector<uint64_t>* bytes) {
+    bytes->clear();
+    std::string sstables;
+    ASSERT_TRUE(db_->GetProperty("leveldb.sstables", &sstables));
+    Slice input(sstables);
+    while (!input.empty()) {
+      // Table lines look like " 17:123['a' .. 'd']"
+      const char* eol =
+          static_cast<const char*>(memchr(input.data(), '\n', input.size()));
+      Slice line(input.data(), eol - input.data());
+      input.remove_prefix(line.size() + 1);
+      uint64_t number, size;
+      if (line.starts_with(" ")) {
+        line.remove_prefix(1);
+        ASSERT_TRUE(ConsumeDecimalNumber(&line, &number));
+        ASSERT_TRUE(line.starts_with(":"));
+        line.remove_prefix(1);
+        ASSERT_TRUE(ConsumeDecimalNumber(&line, &size));
+        bytes->back() += size;
+      } else {
+        // Next level header
+        bytes->push_back(0);
+      }
+    }
+  }
+
+  // Whether each level between level-0 and the deepest level holding tables
+  // is at most size_factor times smaller than the level below it, or no
+  // larger than level-1
+  bool Bounded() {
+    std::vector<uint64_t> bytes;
+    LevelBytes(&bytes);
+    int last = bytes.size() - 1;
+    while (last > 1 && bytes[last] == 0) {
+      last--;
+    }
+    const double base = kSizeFactor * kFileSize;
+    double target = bytes[last];
+    for (int level = last - 1; level >= 1; level--) {
+      target /= kSizeFactor;
+      if (bytes[level] > std::max(target, base)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  static const int kSizeFactor = 4;
+  static const int kFileSize = 1 << 20;
+  static const uint32_t kNumKeys = 40000;
+
+  std::unique_ptr<Env> env_;
+  std::unique_ptr<const Comparator> comparator_;
+  DB* db_;
+};
+
+TEST_F(DynamicLevelBytesTest, GrowingData) {
+  uint32_t num_keys = 0;
+  for (uint32_t target : {kNumKeys / 100, kNumKeys / 10, kNumKeys}) {
+    // New keys land all over the existing ones
+    for (uint32_t i = num_keys; i < target; i++) {
+      const uint32_t key = (i * 7919) % kNumKeys;
+      ASSERT_TRUE(db_->Put(WriteOptions(), Key(key), Value(key)).ok());
+    }
+    num_keys = target;
+
+    // Compactions stop once every level fits its target
+    bool bounded = false;
+    for (int i = 0; i < 1000 && !bounded; i++) {
+      bounded = Bounded();
+      Env::Default()->SleepForMicroseconds(10000);
+    }
+    ASSERT_TRUE(bounded) << num_keys;
+
+    for (uint32_t i = 0; i < num_keys; i++) {
+      const uint32_t key = (i * 7919) % kNumKeys;
+      std::string value;
+      ASSERT_TRUE(db_->Get(ReadOptions(), Key(key), &value).ok());
+      ASSERT_EQ(Value(key), value);
+    }
+  }
+}
+
+TEST_F(DynamicLevelBytesTest, UpdatesDoNotWidenFanouts) {
+  Options options = CurrentOptions();
+  options.layout_adaptation_ops = 1000;
+  Open(options);
+
+  // Every level uses leveling, where an update is merged into a level about
+  // fanout times, so an update-only workload narrows the fanouts
+  for (int round = 0; round < 3; round++) {
+    for (uint32_t i = 0; i < kNumKeys / 10; i++) {
+      ASSERT_TRUE(db_->Put(WriteOptions(), Key(i), Value(i)).ok());
+    }
+  }
+  std::string fanouts;
+  ASSERT_TRUE(db_->GetProperty("leveldb.level-fanouts", &fanouts));
+  ASSERT_NE("4 4 4 4 4", fanouts);
+  Slice input(fanouts);
+  while (!input.empty()) {
+    uint64_t fanout;
+    ASSERT_TRUE(ConsumeDecimalNumber(&input, &fanout)) << fanouts;
+    ASSERT_LE(fanout, static_cast<uint64_t>(kSizeFactor)) << fanouts;
+    if (input.starts_with(" ")) {
+      input.remove_prefix(1);
+    }
+  }
+}
+
+}  // namespace leveldb
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
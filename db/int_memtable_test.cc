@@ -0,0 +1,143 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include <memory>
+
+#include "colsm/comparators.h"
+#include "db/dbformat.h"
+#include "db/memtable.h"
+#include "gtest/gtest.h"
+#include "helpers/memenv/memenv.h"
+#include "leveldb/db.h"
+#include "leveldb/env.h"
+#include "util/coding.h"
+#include "util/random.h"
+
+namespace leveldb {
+
+static std::string Key(uint32_t i) {
+  std::string result;
+  PutFixed32(&result, i);
+  return result;
+}
+
+class IntMemTableTest : public testing::Test {
+ public:
+  IntMemTableTest()
+      : comparator_(colsm::intComparator()),
+        icmp_(comparator_.get()),
+        mem_(new MemTable(icmp_, true)),
+        generic_(new MemTable(icmp_)) {
+    mem_->Ref();
+    generic_->Ref();
+  }
+
+  ~IntMemTableTest() {
+    mem_->Unref();
+    generic_->Unref();
+  }
+
+  void Add(SequenceNumber seq, ValueType type, uint32_t key,
+           const std::string& value) {
+    mem_->Add(seq, type, Key(key), value);
+    generic_->Add(seq, type, Key(key), value);
+  }
+
+  std::string Get(uint32_t key, SequenceNumber seq) {
+    LookupKey lkey(Key(key), seq);
+    std::string value;
+    Status s;
+    if (!mem_->Get(lkey, &value, &s)) {
+      return "MISSING";
+    }
+    return s.IsNotFound() ? "DELETED" : value;
+  }
+
+  std::unique_ptr<const Comparator> comparator_;
+  InternalKeyComparator icmp_;
+  MemTable* mem_;
+  MemTable* generic_;
+};
+
+TEST_F(IntMemTableTest, GetAtSnapshots) {
+  Add(1, kTypeValue, 7, "a");
+  Add(2, kTypeValue, 7, "b");
+  Add(3, kTypeDeletion, 7, "");
+  Add(4, kTypeValue, 0x80000001, "high");
+
+  ASSERT_EQ("MISSING", Get(7, 0));
+  ASSERT_EQ("a", Get(7, 1));
+  ASSERT_EQ("b", Get(7, 2));
+  ASSERT_EQ("DELETED", Get(7, 3));
+  ASSERT_EQ("DELETED", Get(7, 10));
+  ASSERT_EQ("MISSING", Get(8, 10));
+  ASSERT_EQ("high", Get(0x80000001, 10));
+}
+
+TEST_F(IntMemTableTest, SameOrderAsComparator) {
+  Random rnd(301);
+  for (SequenceNumber seq = 1; seq <= 2000; seq++) {
+    // Few distinct keys, so most have several versions
+    uint32_t key = rnd.Next() % 300;
+    if (rnd.OneIn(2)) {
+      key |= 0x80000000;
+    }
+    Add(seq, rnd.OneIn(5) ? kTypeDeletion : kTypeValue, key,
+        std::to_string(seq));
+  }
+
+  std::unique_ptr<Iterator> iter(mem_->NewIterator());
+  std::unique_ptr<Iterator> expected(generic_->NewIterator());
+  for (iter->SeekToFirst(), expected->SeekToFirst(); expected->Valid();
+       iter->Next(), expected->Next()) {
+    ASSERT_TRUE(iter->Valid());
+    ASSERT_EQ(expected->key().ToString(), iter->key().ToString());
+    ASSERT_EQ(expected->value().ToString(), iter->value().ToString());
+  }
+  ASSERT_FALSE(iter->Valid());
+
+  InternalKey target(Key(150), 1000, kValueTypeForSeek);
+  iter->Seek(target.Encode());
+  expected->Seek(target.Encode());
+  ASSERT_TRUE(iter->Valid());
+  ASSERT_EQ(expected->key().ToString(), iter->key().ToString());
+}
+
+TEST_F(IntMemTableTest, Database) {
+  std::unique_ptr<Env> env(NewMemEnv(Env::Default()));
+  Options options;
+  options.env = env.get();
+  options.comparator = comparator_.get();
+  options.create_if_missing = true;
+  options.int_key_memtable = true;
+
+  DB* db;
+  ASSERT_TRUE(DB::Open(options, "/intmemdb", &db).ok());
+  ASSERT_TRUE(db->Put(WriteOptions(), Key(5), "old").ok());
+  const Snapshot* snapshot = db->GetSnapshot();
+  ASSERT_TRUE(db->Put(WriteOptions(), Key(5), "new").ok());
+
+  std::string value;
+  ASSERT_TRUE(db->Get(ReadOptions(), Key(5), &value).ok());
+  ASSERT_EQ("new", value);
+  ReadOptions read_options;
+  read_options.snapshot = snapshot;
+  ASSERT_TRUE(db->Get(read_options, Key(5), &value).ok());
+  ASSERT_EQ("old", value);
+  db->ReleaseSnapshot(snapshot);
+
+  // Recovery replays the log into an int key memtable too
+  delete db;
+  ASSERT_TRUE(DB::Open(options, "/intmemdb", &db).ok());
+  ASSERT_TRUE(db->Get(ReadOptions(), Key(5), &value).ok());
+  ASSERT_EQ("new", value);
+  delete db;
+}
+
+}  // namespace leveldb
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,140 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#include "colsm/comparators.h"
+#include "colsm/vblock/vert_helper.h"
+#include "db/filename.h"
+#include "gtest/gtest.h"
+#include "helpers/memenv/memenv.h"
+#include "leveldb/db.h"
+#include "leveldb/env.h"
+#include "util/coding.h"
+#include "util/logging.h"
+
+namespace leveldb {
+
+static std::string Key(uint32_t i) {
+  std::string result;
+  PutFixed32(&result, i);
+  return result;
+}
+
+static std::string Value(uint32_t i) {
+  std::string result = std::to_string(i);
+  result.resize(1000, 'v');
+  return result;
+}
+
+class KeyRangeLayoutTest : public testing::Test {
+ public:
+  KeyRangeLayoutTest()
+      : env_(NewMemEnv(Env::Default())),
+        comparator_(colsm::intComparator()),
+        db_(nullptr) {
+    Options options;
+    options.env = env_.get();
+    options.comparator = comparator_.get();
+    options.create_if_missing = true;
+    options.compression = kNoCompression;
+    options.layout_adaptation_ops = 20000;
+    options.key_range_layout = true;
+    // Compactions split at the tables of their output level, so their
+    // outputs follow the key ranges of those tables
+    options.max_subcompactions = 4;
+    EXPECT_TRUE(DB::Open(options, "/keyrangedb", &db_).ok());
+  }
+
+  ~KeyRangeLayoutTest() { delete db_; }
+
+  void Fill() {
+    for (uint32_t i = 0; i < kNumKeys; i++) {
+      ASSERT_TRUE(db_->Put(WriteOptions(), Key(i), Value(i)).ok());
+    }
+  }
+
+  void Verify() {
+    for (uint32_t i = 0; i < kNumKeys; i++) {
+      std::string value;
+      ASSERT_TRUE(db_->Get(ReadOptions(), Key(i), &value).ok());
+      ASSERT_EQ(Value(i), value);
+    }
+  }
+
+  // Whether the tables of the deepest non-empty level are vertical, in key
+  // order
+  void LastLevelFormats(std::vector<bool>* formats) {
+    formats->clear();
+    std::vector<bool> level;
+    std::string sstables;
+    ASSERT_TRUE(db_->GetProperty("leveldb.sstables", &sstables));
+    Slice input(sstables);
+    while (!input.empty()) {
+      // Table lines look like " 17:123['a' .. 'd']"
+      const char* eol =
+          static_cast<const char*>(memchr(input.data(), '\n', input.size()));
+      Slice line(input.data(), eol - input.data());
+      input.remove_prefix(line.size() + 1);
+      uint64_t number;
+      if (line.starts_with(" ")) {
+        line.remove_prefix(1);
+        ASSERT_TRUE(ConsumeDecimalNumber(&line, &number));
+        level.push_back(colsm::IsVerticalTable(
+            env_.get(), TableFileName("/keyrangedb", number)));
+      } else if (!level.empty()) {
+        // Next level header
+        formats->swap(level);
+        level.clear();
+      }
+    }
+    if (!level.empty()) {
+      formats->swap(level);
+    }
+  }
+
+  static const uint32_t kNumKeys = 10000;
+
+  std::unique_ptr<Env> env_;
+  std::unique_ptr<const Comparator> comparator_;
+  DB* db_;
+};
+
+TEST_F(KeyRangeLayoutTest, HotRangeHorizontal) {
+  Fill();
+  db_->CompactRange(nullptr, nullptr);
+  std::vector<bool> formats;
+  LastLevelFormats(&formats);
+  ASSERT_GT(formats.size(), 2);
+  for (bool vertical : formats) {
+    ASSERT_TRUE(vertical);
+  }
+
+  // The first keys are looked up over and over, the others never. Once the
+  // keys are updated, the compaction writes the tables of the first keys
+  // with horizontal blocks, the tables of the rest stay vertical, whatever
+  // the format of their level.
+  std::string value;
+  for (int round = 0; round < 50; round++) {
+    for (uint32_t i = 0; i < 1000; i++) {
+      ASSERT_TRUE(db_->Get(ReadOptions(), Key(i), &value).ok());
+    }
+  }
+  Fill();
+  db_->CompactRange(nullptr, nullptr);
+  LastLevelFormats(&formats);
+  ASSERT_GT(formats.size(), 2);
+  ASSERT_FALSE(formats.front());
+  ASSERT_TRUE(formats.back());
+  Verify();
+}
+
+}  // namespace leveldb
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
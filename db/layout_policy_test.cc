@@ -0,0 +1,154 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "leveldb/layout_policy.h"
+
+#include <memory>
+#include <vector>
+
+#include "colsm/comparators.h"
+#include "colsm/vblock/vert_helper.h"
+#include "db/filename.h"
+#include "gtest/gtest.h"
+#include "helpers/memenv/memenv.h"
+#include "leveldb/db.h"
+#include "leveldb/env.h"
+#include "util/coding.h"
+
+namespace leveldb {
+
+static std::string Key(uint32_t i) {
+  std::string result;
+  PutFixed32(&result, i);
+  return result;
+}
+
+class LayoutPolicyTest : public testing::Test {
+ public:
+  LayoutPolicyTest()
+      : env_(NewMemEnv(Env::Default())), comparator_(colsm::intComparator()) {}
+
+  Options NewOptions(const LayoutPolicy* policy) {
+    Options options;
+    options.env = env_.get();
+    options.comparator = comparator_.get();
+    options.create_if_missing = true;
+    options.layout_policy = policy;
+    return options;
+  }
+
+  void Fill(DB* db, uint32_t num_keys) {
+    for (uint32_t i = 0; i < num_keys; i++) {
+      ASSERT_TRUE(db->Put(WriteOptions(), Key(i), std::to_string(i)).ok());
+    }
+  }
+
+  void Verify(DB* db, uint32_t num_keys) {
+    for (uint32_t i = 0; i < num_keys; i++) {
+      std::string value;
+      ASSERT_TRUE(db->Get(ReadOptions(), Key(i), &value).ok());
+      ASSERT_EQ(std::to_string(i), value);
+    }
+  }
+
+  // Number of vertical and horizontal tables in the DB
+  void CountTables(const std::string& dbname, int* vertical,
+                   int* horizontal) {
+    *vertical = *horizontal = 0;
+    std::vector<std::string> children;
+    ASSERT_TRUE(env_->GetChildren(dbname, &children).ok());
+    for (const std::string& child : children) {
+      uint64_t number;
+      FileType type;
+      if (ParseFileName(child, &number, &type) && type == kTableFile) {
+        if (colsm::IsVerticalTable(env_.get(), dbname + "/" + child)) {
+          (*vertical)++;
+        } else {
+          (*horizontal)++;
+        }
+      }
+    }
+  }
+
+  std::unique_ptr<Env> env_;
+  std::unique_ptr<const Comparator> comparator_;
+};
+
+TEST_F(LayoutPolicyTest, LevelLayouts) {
+  LevelLayout level0;
+  LevelLayout lower;
+  lower.vertical = false;
+  lower.block_size = 16 * 1024;
+  lower.compression = kNoCompression;
+  std::unique_ptr<const LayoutPolicy> policy(
+      NewLevelLayoutPolicy({level0, lower}));
+
+  LevelLayout layout;
+  policy->GetLayout(0, &layout);
+  ASSERT_TRUE(layout.vertical);
+  policy->GetLayout(5, &layout);
+  ASSERT_FALSE(layout.vertical);
+  ASSERT_EQ(16 * 1024, layout.block_size);
+
+  // Two DBs in a process, each with its own layout
+  DB* horizontal_db;
+  DB* vertical_db;
+  ASSERT_TRUE(
+      DB::Open(NewOptions(policy.get()), "/horizontal", &horizontal_db).ok());
+  ASSERT_TRUE(DB::Open(NewOptions(nullptr), "/vertical", &vertical_db).ok());
+  std::string property;
+  ASSERT_TRUE(horizontal_db->GetProperty("leveldb.layout", &property));
+  ASSERT_EQ("VHHHHHH", property);
+  ASSERT_TRUE(vertical_db->GetProperty("leveldb.layout", &property));
+  ASSERT_EQ("VVVVVVV", property);
+
+  const uint32_t kNumKeys = 5000;
+  for (DB* db : {horizontal_db, vertical_db}) {
+    Fill(db, kNumKeys);
+    db->CompactRange(nullptr, nullptr);
+    Verify(db, kNumKeys);
+  }
+
+  // The compactions moved every key below level 0
+  int vertical, horizontal;
+  CountTables("/horizontal", &vertical, &horizontal);
+  ASSERT_EQ(0, vertical);
+  ASSERT_GT(horizontal, 0);
+  CountTables("/vertical", &vertical, &horizontal);
+  ASSERT_GT(vertical, 0);
+  ASSERT_EQ(0, horizontal);
+
+  delete horizontal_db;
+  delete vertical_db;
+}
+
+TEST_F(LayoutPolicyTest, Repair) {
+  LevelLayout layout;
+  layout.vertical = false;
+  std::unique_ptr<const LayoutPolicy> policy(NewLevelLayoutPolicy({layout}));
+  Options options = NewOptions(policy.get());
+
+  // The keys stay in the log, the repairer writes them to a level-0 table
+  DB* db;
+  ASSERT_TRUE(DB::Open(options, "/repair", &db).ok());
+  Fill(db, 1000);
+  delete db;
+  ASSERT_TRUE(RepairDB("/repair", options).ok());
+
+  int vertical, horizontal;
+  CountTables("/repair", &vertical, &horizontal);
+  ASSERT_EQ(0, vertical);
+  ASSERT_EQ(1, horizontal);
+
+  ASSERT_TRUE(DB::Open(options, "/repair", &db).ok());
+  Verify(db, 1000);
+  delete db;
+}
+
+}  // namespace leveldb
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -40,8 +40,12 @@ class Reader {
   //
   // The Reader will start reading at the first record located at physical
   // position >= initial_offset within the file.
+  //
+  // Recyclable records are only returned if they carry "log_number".  Any
+  // record that follows them and is not a valid recyclable record of this
+  // log is taken to be left over from an older log and ends the input.
   Reader(SequentialFile* file, Reporter* reporter, bool checksum,
-         uint64_t initial_offset);
+         uint64_t initial_offset, uint64_t log_number = 0);
 
   Reader(const Reader&) = delete;
   Reader& operator=(const Reader&) = delete;
@@ -69,7 +73,10 @@ class Reader {
     // * The record has an invalid CRC (ReadPhysicalRecord reports a drop)
     // * The record is a 0-length record (No drop is reported)
     // * The record is below constructor's initial_offset (No drop is reported)
-    kBadRecord = kMaxRecordType + 2
+    kBadRecord = kMaxRecordType + 2,
+    // Returned when we find a record left over from an older log that was
+    // recycled for this one
+    kOldRecord = kMaxRecordType + 3
   };
 
   // Skips all blocks that are completely before "initial_offset_".
@@ -104,6 +111,12 @@ class Reader {
   // particular, a run of kMiddleType and kLastType records can be silently
   // skipped in this mode
   bool resyncing_;
+
+  // Low 32 bits of the number of the log being read
+  uint32_t const log_number_;
+
+  // True once a recyclable record of this log has been read
+  bool recycled_;
 };
 
 }  // namespace log
@@ -54,6 +54,25 @@ class LogTest : public testing::Test {
     writer_ = new Writer(&dest_, dest_.contents_.size());
   }
 
+  // Start writing recyclable log "log_number" over the current contents
+  void RecycleLog(uint64_t log_number) {
+    delete writer_;
+    delete reader_;
+    old_contents_ = dest_.contents_;
+    dest_.contents_.clear();
+    writer_ = new Writer(&dest_, log_number, true /*recyclable*/);
+    reader_ = new Reader(&source_, &report_, true /*checksum*/,
+                         0 /*initial_offset*/, log_number);
+  }
+
+  // Leave the older contents past what the recycled log wrote
+  void KeepOldTail() {
+    if (old_contents_.size() > dest_.contents_.size()) {
+      dest_.contents_.append(old_contents_, dest_.contents_.size(),
+                             std::string::npos);
+    }
+  }
+
   void Write(const std::string& msg) {
     ASSERT_TRUE(!reading_) << "Write() after starting to read";
     writer_->AddRecord(Slice(msg));
@@ -228,6 +247,7 @@ class LogTest : public testing::Test {
   static int num_initial_offset_records_;
 
   StringDest dest_;
+  std::string old_contents_;
   StringSource source_;
   ReportCollector report_;
   bool reading_;
@@ -554,6 +574,70 @@ TEST_F(LogTest, ReadEnd) { CheckOffsetPastEndReturnsNoRecords(0); }
 
 TEST_F(LogTest, ReadPastEnd) { CheckOffsetPastEndReturnsNoRecords(5); }
 
+TEST_F(LogTest, RecyclableRecords) {
+  RecycleLog(5);
+  Write("foo");
+  Write(BigString("bar", 3 * kBlockSize));
+  Write("");
+  Write("xxxx");
+  ASSERT_EQ("foo", Read());
+  ASSERT_EQ(BigString("bar", 3 * kBlockSize), Read());
+  ASSERT_EQ("", Read());
+  ASSERT_EQ("xxxx", Read());
+  ASSERT_EQ("EOF", Read());
+  ASSERT_EQ(0, DroppedBytes());
+}
+
+TEST_F(LogTest, RecyclableBlockTrailer) {
+  RecycleLog(5);
+  // Leaves fewer bytes than a recyclable header at the end of the block
+  const int n = kBlockSize - 2 * kRecyclableHeaderSize + 4;
+  Write(BigString("foo", n));
+  ASSERT_EQ(kBlockSize - kRecyclableHeaderSize + 4, WrittenBytes());
+  Write("bar");
+  ASSERT_EQ(BigString("foo", n), Read());
+  ASSERT_EQ("bar", Read());
+  ASSERT_EQ("EOF", Read());
+  ASSERT_EQ(0, DroppedBytes());
+}
+
+TEST_F(LogTest, RecycledLogStopsAtOlderRecords) {
+  RecycleLog(5);
+  for (int i = 0; i < 100; i++) {
+    Write(BigString(NumberString(i), 1000));
+  }
+  RecycleLog(6);
+  Write("foo");
+  Write(BigString("bar", 1500));
+  KeepOldTail();
+  ASSERT_EQ("foo", Read());
+  ASSERT_EQ(BigString("bar", 1500), Read());
+  ASSERT_EQ("EOF", Read());
+  ASSERT_EQ(0, DroppedBytes());
+}
+
+TEST_F(LogTest, RecycledLogStopsAtOlderRecordBoundary) {
+  RecycleLog(5);
+  Write("foo");
+  Write("bar");
+  Write("baz");
+  RecycleLog(6);
+  Write("xxx");
+  KeepOldTail();
+  ASSERT_EQ("xxx", Read());
+  ASSERT_EQ("EOF", Read());
+  ASSERT_EQ(0, DroppedBytes());
+}
+
+TEST_F(LogTest, EmptyRecycledLog) {
+  RecycleLog(5);
+  Write("foo");
+  RecycleLog(6);
+  KeepOldTail();
+  ASSERT_EQ("EOF", Read());
+  ASSERT_EQ(0, DroppedBytes());
+}
+
 }  // namespace log
 }  // namespace leveldb
 
@@ -29,6 +29,12 @@ class Writer {
   // "*dest" must remain live while this Writer is in use.
   Writer(WritableFile* dest, uint64_t dest_length);
 
+  // Create a writer that will write recyclable records tagged with
+  // "log_number" if "recyclable" is true.  "*dest" may hold an older
+  // recyclable log, which is overwritten from the start.
+  // "*dest" must remain live while this Writer is in use.
+  Writer(WritableFile* dest, uint64_t log_number, bool recyclable);
+
   Writer(const Writer&) = delete;
   Writer& operator=(const Writer&) = delete;
 
@@ -41,6 +47,9 @@ class Writer {
 
   WritableFile* dest_;
   int block_offset_;  // Current offset in block
+  const uint32_t log_number_;
+  const bool recyclable_;
+  const int header_size_;
 
   // crc32c values for all supported record types.  These are
   // pre-computed to reduce the overhead of computing the crc of the
@@ -18,8 +18,12 @@ static Slice GetLengthPrefixedSlice(const char* data) {
   return Slice(p, len);
 }
 
-MemTable::MemTable(const InternalKeyComparator& comparator)
-    : comparator_(comparator), refs_(0), table_(comparator_, &arena_) {}
+MemTable::MemTable(const InternalKeyComparator& comparator, bool int_keys)
+    : comparator_(comparator),
+      int_keys_(int_keys),
+      refs_(0),
+      table_(comparator_, &arena_),
+      int_table_(IntKeyComparator(), &arena_) {}
 
 MemTable::~MemTable() { assert(refs_ == 0); }
 
@@ -33,6 +37,23 @@ int MemTable::KeyComparator::operator()(const char* aptr,
   return comparator.Compare(a, b);
 }
 
+int MemTable::IntKeyComparator::operator()(const IntEntry& a,
+                                           const IntEntry& b) const {
+  // Order by increasing user key, then by decreasing tag, as
+  // InternalKeyComparator does with colsm::intComparator()
+  const uint32_t akey = DecodeFixed32(a.internal_key);
+  const uint32_t bkey = DecodeFixed32(b.internal_key);
+  if (akey != bkey) {
+    return akey < bkey ? -1 : +1;
+  }
+  const uint64_t atag = DecodeFixed64(a.internal_key + 4);
+  const uint64_t btag = DecodeFixed64(b.internal_key + 4);
+  if (atag != btag) {
+    return atag > btag ? -1 : +1;
+  }
+  return 0;
+}
+
 // Encode a suitable internal key target for "target" and return it.
 // Uses *scratch as scratch space, and the returned pointer will point
 // into this scratch space.
@@ -71,10 +92,53 @@ class MemTableIterator : public Iterator {
   std::string tmp_;  // For passing to EncodeKey
 };
 
-Iterator* MemTable::NewIterator() { return new MemTableIterator(&table_); }
+class IntMemTableIterator : public Iterator {
+ public:
+  explicit IntMemTableIterator(MemTable::IntTable* table) : iter_(table) {}
 
-void MemTable::Add(SequenceNumber s, ValueType type, const Slice& key,
-                   const Slice& value) {
+  IntMemTableIterator(const IntMemTableIterator&) = delete;
+  IntMemTableIterator& operator=(const IntMemTableIterator&) = delete;
+
+  ~IntMemTableIterator() override = default;
+
+  bool Valid() const override { return iter_.Valid(); }
+  void Seek(const Slice& k) override {
+    MemTable::IntEntry target;
+    std::memcpy(target.internal_key, k.data(), sizeof(target.internal_key));
+    iter_.Seek(target);
+  }
+  void SeekToFirst() override { iter_.SeekToFirst(); }
+  void SeekToLast() override { iter_.SeekToLast(); }
+  void Next() override { iter_.Next(); }
+  void Prev() override { iter_.Prev(); }
+  Slice key() const override {
+    return Slice(iter_.key().internal_key, sizeof(iter_.key().internal_key));
+  }
+  Slice value() const override {
+    return GetLengthPrefixedSlice(iter_.key().value);
+  }
+
+  Status status() const override { return Status::OK(); }
+
+ private:
+  MemTable::IntTable::Iterator iter_;
+};
+
+Iterator* MemTable::NewIterator() {
+  if (int_keys_) {
+    return new IntMemTableIterator(&int_table_);
+  }
+  return new MemTableIterator(&table_);
+}
+
+size_t MemTable::EntrySize(const Slice& key, const Slice& value) {
+  size_t internal_key_size = key.size() + 8;
+  return VarintLength(internal_key_size) + internal_key_size +
+         VarintLength(value.size()) + value.size();
+}
+
+void MemTable::EncodeEntry(char* buf, SequenceNumber s, ValueType type,
+                           const Slice& key, const Slice& value) {
   // Format of an entry is concatenation of:
   //  key_size     : varint32 of internal_key.size()
   //  key bytes    : char[internal_key.size()]
@@ -83,10 +147,6 @@ void MemTable::Add(SequenceNumber s, ValueType type, const Slice& key,
   size_t key_size = key.size();
   size_t val_size = value.size();
   size_t internal_key_size = key_size + 8;
-  const size_t encoded_len = VarintLength(internal_key_size) +
-                             internal_key_size + VarintLength(val_size) +
-                             val_size;
-  char* buf = arena_.Allocate(encoded_len);
   char* p = EncodeVarint32(buf, internal_key_size);
   std::memcpy(p, key.data(), key_size);
   p += key_size;
@@ -94,11 +154,76 @@ void MemTable::Add(SequenceNumber s, ValueType type, const Slice& key,
   p += 8;
   p = EncodeVarint32(p, val_size);
   std::memcpy(p, value.data(), val_size);
-  assert(p + val_size == buf + encoded_len);
-  table_.Insert(buf);
+  assert(p + val_size == buf + EntrySize(key, value));
+}
+
+void MemTable::Add(SequenceNumber s, ValueType type, const Slice& key,
+                   const Slice& value) {
+  Insert(s, type, key, value, false);
+}
+
+void MemTable::AddConcurrently(SequenceNumber s, ValueType type,
+                               const Slice& key, const Slice& value) {
+  Insert(s, type, key, value, true);
+}
+
+void MemTable::Insert(SequenceNumber s, ValueType type, const Slice& key,
+                      const Slice& value, bool concurrent) {
+  if (!int_keys_) {
+    const size_t size = EntrySize(key, value);
+    char* buf = concurrent ? arena_.AllocateConcurrently(size)
+                           : arena_.Allocate(size);
+    EncodeEntry(buf, s, type, key, value);
+    if (concurrent) {
+      table_.InsertConcurrently(buf);
+    } else {
+      table_.Insert(buf);
+    }
+    return;
+  }
+
+  assert(key.size() == 4);
+  IntEntry entry;
+  std::memcpy(entry.internal_key, key.data(), 4);
+  EncodeFixed64(entry.internal_key + 4, (s << 8) | type);
+  const size_t size = VarintLength(value.size()) + value.size();
+  char* buf =
+      concurrent ? arena_.AllocateConcurrently(size) : arena_.Allocate(size);
+  char* p = EncodeVarint32(buf, value.size());
+  std::memcpy(p, value.data(), value.size());
+  entry.value = buf;
+  if (concurrent) {
+    int_table_.InsertConcurrently(entry);
+  } else {
+    int_table_.Insert(entry);
+  }
 }
 
 bool MemTable::Get(const LookupKey& key, std::string* value, Status* s) {
+  if (int_keys_) {
+    IntEntry target;
+    std::memcpy(target.internal_key, key.internal_key().data(),
+                sizeof(target.internal_key));
+    IntTable::Iterator iter(&int_table_);
+    iter.Seek(target);
+    if (!iter.Valid() || std::memcmp(iter.key().internal_key,
+                                     target.internal_key, 4) != 0) {
+      return false;
+    }
+    const uint64_t tag = DecodeFixed64(iter.key().internal_key + 4);
+    switch (static_cast<ValueType>(tag & 0xff)) {
+      case kTypeValue: {
+        Slice v = GetLengthPrefixedSlice(iter.key().value);
+        value->assign(v.data(), v.size());
+        return true;
+      }
+      case kTypeDeletion:
+        *s = Status::NotFound(Slice());
+        return true;
+    }
+    return false;
+  }
+
   Slice memkey = key.memtable_key();
   Table::Iterator iter(&table_);
   iter.Seek(memkey.data());
@@ -21,7 +21,12 @@ class MemTable {
  public:
   // MemTables are reference counted.  The initial reference count
   // is zero and the caller must call Ref() at least once.
-  explicit MemTable(const InternalKeyComparator& comparator);
+  //
+  // If int_keys, user keys must be 4-byte integers ordered as by
+  // colsm::intComparator().  They are then kept inline in the skiplist
+  // nodes and compared without calling the comparator.
+  explicit MemTable(const InternalKeyComparator& comparator,
+                    bool int_keys = false);
 
   MemTable(const MemTable&) = delete;
   MemTable& operator=(const MemTable&) = delete;
@@ -56,6 +61,12 @@ class MemTable {
   void Add(SequenceNumber seq, ValueType type, const Slice& key,
            const Slice& value);
 
+  // Like Add(), but may run concurrently with other calls of
+  // AddConcurrently().
+  // REQUIRES: no concurrent call of Add()
+  void AddConcurrently(SequenceNumber seq, ValueType type, const Slice& key,
+                       const Slice& value);
+
   // If memtable contains a value for key, store it in *value and return true.
   // If memtable contains a deletion for key, store a NotFound() error
   // in *status and return true.
@@ -65,6 +76,7 @@ class MemTable {
  private:
   friend class MemTableIterator;
   friend class MemTableBackwardIterator;
+  friend class IntMemTableIterator;
 
   struct KeyComparator {
     const InternalKeyComparator comparator;
@@ -74,12 +86,39 @@ class MemTable {
 
   typedef SkipList<const char*, KeyComparator> Table;
 
+  // Entry of an int key table.  The internal key lives in the skiplist
+  // node itself, so searches do not follow a pointer at every hop.
+  struct IntEntry {
+    char internal_key[12];  // 4-byte user key followed by the tag
+    const char* value;      // Length-prefixed value
+  };
+
+  struct IntKeyComparator {
+    int operator()(const IntEntry& a, const IntEntry& b) const;
+  };
+
+  typedef SkipList<IntEntry, IntKeyComparator> IntTable;
+
   ~MemTable();  // Private since only Unref() should be used to delete it
 
+  // Size of the encoded entry of key and value
+  static size_t EntrySize(const Slice& key, const Slice& value);
+
+  // Encode an entry into buf of EntrySize() bytes
+  static void EncodeEntry(char* buf, SequenceNumber seq, ValueType type,
+                          const Slice& key, const Slice& value);
+
+  // Allocate and insert an entry, through the concurrent paths if
+  // concurrent
+  void Insert(SequenceNumber seq, ValueType type, const Slice& key,
+              const Slice& value, bool concurrent);
+
   KeyComparator comparator_;
+  const bool int_keys_;
   int refs_;
   Arena arena_;
-  Table table_;
+  Table table_;          // Used unless int_keys_
+  IntTable int_table_;  // Used if int_keys_
 };
 
 }  // namespace leveldb
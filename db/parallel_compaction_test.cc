@@ -0,0 +1,192 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include <atomic>
+#include <cstdarg>
+#include <cstring>
+#include <map>
+#include <memory>
+
+#include "colsm/comparators.h"
+#include "gtest/gtest.h"
+#include "helpers/memenv/memenv.h"
+#include "leveldb/db.h"
+#include "leveldb/env.h"
+#include "util/coding.h"
+
+namespace leveldb {
+
+// Records the background threads asked for
+class ThreadCountingEnv : public EnvWrapper {
+ public:
+  explicit ThreadCountingEnv(Env* target)
+      : EnvWrapper(target), background_threads_(0) {}
+
+  void SetBackgroundThreads(int number) override {
+    background_threads_ = number;
+    EnvWrapper::SetBackgroundThreads(number);
+  }
+
+  int background_threads() const { return background_threads_.load(); }
+
+ private:
+  std::atomic<int> background_threads_;
+};
+
+// Counts the compactions split into subcompactions
+class SplitCountingLogger : public Logger {
+ public:
+  SplitCountingLogger() : splits_(0) {}
+
+  void Logv(const char* format, std::va_list ap) override {
+    if (std::strstr(format, "subcompactions") != nullptr) {
+      splits_++;
+    }
+  }
+
+  int splits() const { return splits_.load(); }
+
+ private:
+  std::atomic<int> splits_;
+};
+
+class ParallelCompactionTest : public testing::Test {
+ public:
+  ParallelCompactionTest()
+      : mem_env_(NewMemEnv(Env::Default())),
+        env_(mem_env_.get()),
+        comparator_(colsm::intComparator()),
+        db_(nullptr) {
+    options_.env = &env_;
+    options_.comparator = comparator_.get();
+    options_.info_log = &logger_;
+    options_.create_if_missing = true;
+    options_.write_buffer_size = 256 * 1024;
+    options_.max_file_size = 1 << 20;
+    options_.max_background_compactions = 4;
+    options_.max_subcompactions = 4;
+  }
+
+  ~ParallelCompactionTest() { delete db_; }
+
+  void Open() {
+    delete db_;
+    db_ = nullptr;
+    ASSERT_TRUE(DB::Open(options_, "/pcdb", &db_).ok());
+  }
+
+  static std::string Key(uint32_t i) {
+    std::string result;
+    PutFixed32(&result, i);
+    return result;
+  }
+
+  static std::string Value(uint32_t i, int round) {
+    std::string result = std::to_string(round) + ":" + std::to_string(i);
+    result.resize(1000, 'x');
+    return result;
+  }
+
+  void Put(uint32_t i, int round) {
+    std::string value = Value(i, round);
+    ASSERT_TRUE(db_->Put(WriteOptions(), Key(i), value).ok());
+    model_[i] = value;
+  }
+
+  void Delete(uint32_t i) {
+    ASSERT_TRUE(db_->Delete(WriteOptions(), Key(i)).ok());
+    model_.erase(i);
+  }
+
+  void Verify(uint32_t num_keys) {
+    for (uint32_t i = 0; i < num_keys; i++) {
+      std::string value;
+      Status s = db_->Get(ReadOptions(), Key(i), &value);
+      auto it = model_.find(i);
+      if (it == model_.end()) {
+        ASSERT_TRUE(s.IsNotFound()) << i;
+      } else {
+        ASSERT_TRUE(s.ok()) << i;
+        ASSERT_EQ(it->second, value) << i;
+      }
+    }
+  }
+
+  std::unique_ptr<Env> mem_env_;
+  ThreadCountingEnv env_;
+  std::unique_ptr<const Comparator> comparator_;
+  SplitCountingLogger logger_;
+  Options options_;
+  DB* db_;
+  std::map<uint32_t, std::string> model_;
+};
+
+TEST_F(ParallelCompactionTest, AsksForThreads) {
+  Open();
+  ASSERT_EQ(4, env_.background_threads());
+}
+
+TEST_F(ParallelCompactionTest, SubcompactionsShareThreads) {
+  options_.max_background_compactions = 1;
+  Open();
+  // The subcompactions are scheduled on the Env's threads
+  ASSERT_EQ(4, env_.background_threads());
+
+  const uint32_t kNumKeys = 10000;
+  for (int round = 0; round < 2; round++) {
+    for (uint32_t i = 0; i < kNumKeys; i++) {
+      Put(i, round);
+    }
+    db_->CompactRange(nullptr, nullptr);
+  }
+  ASSERT_GT(logger_.splits(), 0);
+  Verify(kNumKeys);
+}
+
+TEST_F(ParallelCompactionTest, OverwriteAndDelete) {
+  Open();
+  const uint32_t kNumKeys = 10000;
+  for (int round = 0; round < 4; round++) {
+    for (uint32_t i = round; i < kNumKeys; i += 1 + round) {
+      Put(i, round);
+    }
+    for (uint32_t i = round; i < kNumKeys; i += 7 + round) {
+      Delete(i);
+    }
+  }
+  Verify(kNumKeys);
+
+  db_->CompactRange(nullptr, nullptr);
+  Verify(kNumKeys);
+
+  Open();
+  Verify(kNumKeys);
+}
+
+TEST_F(ParallelCompactionTest, SplitIntoRanges) {
+  Open();
+  const uint32_t kNumKeys = 10000;
+  for (uint32_t i = 0; i < kNumKeys; i++) {
+    Put(i, 0);
+  }
+  db_->CompactRange(nullptr, nullptr);
+
+  // Rewriting every key compacts it into several level+1 files
+  for (uint32_t i = 0; i < kNumKeys; i++) {
+    Put(i, 1);
+  }
+  db_->CompactRange(nullptr, nullptr);
+  ASSERT_GT(logger_.splits(), 0);
+  Verify(kNumKeys);
+
+  Open();
+  Verify(kNumKeys);
+}
+
+}  // namespace leveldb
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,125 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include <atomic>
+#include <cstdarg>
+#include <cstring>
+#include <map>
+#include <memory>
+
+#include "colsm/comparators.h"
+#include "gtest/gtest.h"
+#include "helpers/memenv/memenv.h"
+#include "leveldb/db.h"
+#include "leveldb/env.h"
+#include "util/coding.h"
+#include "util/random.h"
+
+namespace leveldb {
+
+// Counts the level-0 tables written
+class TableCountingLogger : public Logger {
+ public:
+  TableCountingLogger() : tables_(0) {}
+
+  void Logv(const char* format, std::va_list ap) override {
+    if (std::strstr(format, "Level-0 table") != nullptr &&
+        std::strstr(format, "started") != nullptr) {
+      tables_++;
+    }
+  }
+
+  int tables() const { return tables_.load(); }
+
+ private:
+  std::atomic<int> tables_;
+};
+
+class ParallelRecoveryTest : public testing::Test {
+ public:
+  ParallelRecoveryTest()
+      : env_(NewMemEnv(Env::Default())),
+        comparator_(colsm::intComparator()),
+        db_(nullptr) {
+    options_.env = env_.get();
+    options_.comparator = comparator_.get();
+    options_.info_log = &logger_;
+    options_.create_if_missing = true;
+    options_.paranoid_checks = true;
+  }
+
+  ~ParallelRecoveryTest() { delete db_; }
+
+  void Open() {
+    delete db_;
+    db_ = nullptr;
+    ASSERT_TRUE(DB::Open(options_, "/recoverydb", &db_).ok());
+  }
+
+  static std::string Key(uint32_t i) {
+    std::string result;
+    PutFixed32(&result, i);
+    return result;
+  }
+
+  void Verify(uint32_t num_keys) {
+    for (uint32_t i = 0; i < num_keys; i++) {
+      std::string value;
+      Status s = db_->Get(ReadOptions(), Key(i), &value);
+      auto it = model_.find(i);
+      if (it == model_.end()) {
+        ASSERT_TRUE(s.IsNotFound()) << i;
+      } else {
+        ASSERT_TRUE(s.ok()) << i;
+        ASSERT_EQ(it->second, value) << i;
+      }
+    }
+  }
+
+  std::unique_ptr<Env> env_;
+  std::unique_ptr<const Comparator> comparator_;
+  TableCountingLogger logger_;
+  Options options_;
+  DB* db_;
+  std::map<uint32_t, std::string> model_;
+};
+
+TEST_F(ParallelRecoveryTest, ReplayIntoSeveralTables) {
+  // Everything stays in the log
+  options_.write_buffer_size = 64 << 20;
+  Open();
+  const uint32_t kNumKeys = 2000;
+  Random rnd(301);
+  for (int i = 0; i < 20000; i++) {
+    uint32_t key = rnd.Uniform(kNumKeys);
+    if (rnd.OneIn(10)) {
+      ASSERT_TRUE(db_->Delete(WriteOptions(), Key(key)).ok());
+      model_.erase(key);
+    } else {
+      std::string value = std::to_string(i);
+      value.resize(100, 'v');
+      ASSERT_TRUE(db_->Put(WriteOptions(), Key(key), value).ok());
+      model_[key] = value;
+    }
+  }
+  Verify(kNumKeys);
+  ASSERT_EQ(0, logger_.tables());
+
+  // Newer versions of a key may land in later tables
+  options_.write_buffer_size = 64 << 10;
+  options_.recovery_threads = 4;
+  Open();
+  Verify(kNumKeys);
+  ASSERT_GT(logger_.tables(), 1);
+
+  Open();
+  Verify(kNumKeys);
+}
+
+}  // namespace leveldb
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
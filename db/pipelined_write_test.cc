@@ -0,0 +1,104 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "colsm/comparators.h"
+#include "gtest/gtest.h"
+#include "helpers/memenv/memenv.h"
+#include "leveldb/db.h"
+#include "leveldb/env.h"
+#include "util/coding.h"
+
+namespace leveldb {
+
+static const int kThreads = 4;
+static const uint32_t kPerThread = 3000;
+
+static std::string Key(int thread, uint32_t i) {
+  std::string result;
+  PutFixed32(&result, i * kThreads + thread);
+  return result;
+}
+
+// Groups are logged while earlier groups are still applied to the memtable
+TEST(PipelinedWriteTest, WritesBecomeVisibleInOrder) {
+  std::unique_ptr<Env> env(NewMemEnv(Env::Default()));
+  auto comparator = colsm::intComparator();
+  Options options;
+  options.env = env.get();
+  options.comparator = comparator.get();
+  options.create_if_missing = true;
+  // Small memtables, so they are switched while groups are in flight
+  options.write_buffer_size = 64 * 1024;
+  options.enable_pipelined_write = true;
+
+  DB* db;
+  ASSERT_TRUE(DB::Open(options, "/pipedb", &db).ok());
+
+  std::atomic<bool> writing(true);
+  std::vector<std::thread> writers;
+  for (int t = 0; t < kThreads; t++) {
+    writers.emplace_back([&, t]() {
+      WriteOptions write_options;
+      write_options.sync = (t % 2 == 0);
+      for (uint32_t i = 0; i < kPerThread; i++) {
+        ASSERT_TRUE(db->Put(write_options, Key(t, i), std::to_string(i)).ok());
+      }
+    });
+  }
+
+  // Every thread writes its keys in order, so a snapshot must see a prefix
+  // of each thread's keys
+  std::thread reader([&]() {
+    while (writing.load()) {
+      ReadOptions read_options;
+      read_options.snapshot = db->GetSnapshot();
+      for (int t = 0; t < kThreads; t++) {
+        bool missing = false;
+        for (uint32_t i = 0; i < kPerThread; i += 97) {
+          std::string value;
+          Status s = db->Get(read_options, Key(t, i), &value);
+          if (s.IsNotFound()) {
+            missing = true;
+          } else {
+            ASSERT_TRUE(s.ok());
+            ASSERT_FALSE(missing) << "thread " << t << " key " << i;
+            ASSERT_EQ(std::to_string(i), value);
+          }
+        }
+      }
+      db->ReleaseSnapshot(read_options.snapshot);
+    }
+  });
+
+  for (auto& writer : writers) {
+    writer.join();
+  }
+  writing.store(false);
+  reader.join();
+
+  for (int round = 0; round < 2; round++) {
+    for (int t = 0; t < kThreads; t++) {
+      for (uint32_t i = 0; i < kPerThread; i++) {
+        std::string value;
+        ASSERT_TRUE(db->Get(ReadOptions(), Key(t, i), &value).ok());
+        ASSERT_EQ(std::to_string(i), value);
+      }
+    }
+    delete db;
+    ASSERT_TRUE(DB::Open(options, "/pipedb", &db).ok());
+  }
+  delete db;
+}
+
+}  // namespace leveldb
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
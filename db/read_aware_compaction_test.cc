@@ -0,0 +1,128 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include <memory>
+
+#include "colsm/comparators.h"
+#include "db/db_impl.h"
+#include "gtest/gtest.h"
+#include "helpers/memenv/memenv.h"
+#include "leveldb/db.h"
+#include "leveldb/env.h"
+#include "util/coding.h"
+
+namespace leveldb {
+
+static std::string Key(uint32_t i) {
+  std::string result;
+  PutFixed32(&result, i);
+  return result;
+}
+
+static std::string Value(uint32_t i) {
+  std::string result = std::to_string(i);
+  result.resize(100, 'v');
+  return result;
+}
+
+class ReadAwareCompactionTest : public testing::Test {
+ public:
+  ReadAwareCompactionTest()
+      : env_(NewMemEnv(Env::Default())),
+        comparator_(colsm::intComparator()),
+        db_(nullptr) {}
+
+  ~ReadAwareCompactionTest() { delete db_; }
+
+  void Open(bool read_aware) {
+    Options options;
+    options.env = env_.get();
+    options.comparator = comparator_.get();
+    options.create_if_missing = true;
+    options.read_aware_compaction = read_aware;
+    ASSERT_TRUE(DB::Open(options, "/readawaredb", &db_).ok());
+  }
+
+  DBImpl* dbfull() { return reinterpret_cast<DBImpl*>(db_); }
+
+  // Leave two overlapping level-0 tables over the keys in the levels below,
+  // too few for a size compaction.  The first table flushed goes to
+  // level-1.
+  void Fill() {
+    for (uint32_t i = 0; i < kNumKeys; i++) {
+      ASSERT_TRUE(db_->Put(WriteOptions(), Key(i), Value(i)).ok());
+    }
+    db_->CompactRange(nullptr, nullptr);
+    for (int table = 0; table < 3; table++) {
+      ASSERT_TRUE(db_->Put(WriteOptions(), Key(0), Value(0)).ok());
+      ASSERT_TRUE(
+          db_->Put(WriteOptions(), Key(kNumKeys - 1), Value(kNumKeys - 1))
+              .ok());
+      ASSERT_TRUE(dbfull()->TEST_CompactMemTable().ok());
+    }
+    ASSERT_EQ("2", FilesAtLevel0());
+  }
+
+  std::string FilesAtLevel0() {
+    std::string files;
+    EXPECT_TRUE(db_->GetProperty("leveldb.num-files-at-level0", &files));
+    return files;
+  }
+
+  // Wait for level-0 to hold this many tables
+  void WaitForLevel0(const std::string& files) {
+    for (int i = 0; i < 1000 && FilesAtLevel0() != files; i++) {
+      Env::Default()->SleepForMicroseconds(1000);
+    }
+    ASSERT_EQ(files, FilesAtLevel0());
+  }
+
+  static const uint32_t kNumKeys = 1000;
+
+  std::unique_ptr<Env> env_;
+  std::unique_ptr<const Comparator> comparator_;
+  DB* db_;
+};
+
+TEST_F(ReadAwareCompactionTest, ScansCompactOverlappingTables) {
+  Open(true);
+  Fill();
+
+  // Short scans merge both level-0 tables with the levels below, until the
+  // reads they cost outweigh their compaction
+  for (int i = 0; i < 200; i++) {
+    Iterator* iter = db_->NewIterator(ReadOptions());
+    iter->Seek(Key(i));
+    ASSERT_TRUE(iter->Valid());
+    ASSERT_EQ(Value(i), iter->value().ToString());
+    delete iter;
+  }
+  WaitForLevel0("0");
+
+  for (uint32_t i = 0; i < kNumKeys; i++) {
+    std::string value;
+    ASSERT_TRUE(db_->Get(ReadOptions(), Key(i), &value).ok());
+    ASSERT_EQ(Value(i), value);
+  }
+}
+
+TEST_F(ReadAwareCompactionTest, ScansLeaveTablesWithoutOption) {
+  Open(false);
+  Fill();
+  for (int i = 0; i < 200; i++) {
+    Iterator* iter = db_->NewIterator(ReadOptions());
+    iter->Seek(Key(i));
+    ASSERT_TRUE(iter->Valid());
+    delete iter;
+  }
+  Env::Default()->SleepForMicroseconds(100000);
+  ASSERT_EQ("2", FilesAtLevel0());
+}
+
+}  // namespace leveldb
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
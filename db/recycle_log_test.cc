@@ -0,0 +1,131 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include "colsm/comparators.h"
+#include "db/filename.h"
+#include "gtest/gtest.h"
+#include "leveldb/db.h"
+#include "leveldb/env.h"
+#include "util/coding.h"
+
+namespace leveldb {
+
+// Counts the log files written over instead of created
+class ReuseCountingEnv : public EnvWrapper {
+ public:
+  explicit ReuseCountingEnv(Env* target) : EnvWrapper(target), reused_(0) {}
+
+  Status ReuseWritableFile(const std::string& fname,
+                           const std::string& old_fname,
+                           WritableFile** result) override {
+    reused_++;
+    return EnvWrapper::ReuseWritableFile(fname, old_fname, result);
+  }
+
+  int reused() const { return reused_.load(); }
+
+ private:
+  std::atomic<int> reused_;
+};
+
+class RecycleLogTest : public testing::Test {
+ public:
+  RecycleLogTest()
+      : env_(Env::Default()),
+        comparator_(colsm::intComparator()),
+        dbname_(testing::TempDir() + "recycle_log_test"),
+        db_(nullptr) {
+    options_.env = &env_;
+    options_.comparator = comparator_.get();
+    options_.create_if_missing = true;
+    // Recycled logs must hold nothing but valid records of their own log
+    options_.paranoid_checks = true;
+    options_.write_buffer_size = 64 * 1024;
+    options_.recycle_log_file_num = 2;
+    DestroyDB(dbname_, options_);
+  }
+
+  ~RecycleLogTest() {
+    delete db_;
+    DestroyDB(dbname_, options_);
+  }
+
+  void Open() {
+    delete db_;
+    db_ = nullptr;
+    ASSERT_TRUE(DB::Open(options_, dbname_, &db_).ok());
+  }
+
+  static std::string Key(uint32_t i) {
+    std::string result;
+    PutFixed32(&result, i);
+    return result;
+  }
+
+  static std::string Value(uint32_t i, int round) {
+    std::string result = std::to_string(round) + ":" + std::to_string(i);
+    result.resize(500, 'x');
+    return result;
+  }
+
+  int CountLogFiles() {
+    std::vector<std::string> filenames;
+    env_.GetChildren(dbname_, &filenames);
+    int count = 0;
+    uint64_t number;
+    FileType type;
+    for (const std::string& filename : filenames) {
+      if (ParseFileName(filename, &number, &type) && type == kLogFile) {
+        count++;
+      }
+    }
+    return count;
+  }
+
+  void Verify(uint32_t num_keys, int round) {
+    for (uint32_t i = 0; i < num_keys; i++) {
+      std::string value;
+      ASSERT_TRUE(db_->Get(ReadOptions(), Key(i), &value).ok()) << i;
+      ASSERT_EQ(Value(i, round), value) << i;
+    }
+  }
+
+  ReuseCountingEnv env_;
+  std::unique_ptr<const Comparator> comparator_;
+  std::string dbname_;
+  Options options_;
+  DB* db_;
+};
+
+TEST_F(RecycleLogTest, WriteOverOldLogs) {
+  Open();
+  const uint32_t kNumKeys = 3000;
+  for (int round = 0; round < 3; round++) {
+    // Shorter rounds leave records of longer logs past the end of the log
+    for (uint32_t i = 0; i < kNumKeys; i++) {
+      WriteOptions write_options;
+      write_options.sync = (i % 100 == 0);
+      ASSERT_TRUE(db_->Put(write_options, Key(i), Value(i, round)).ok());
+    }
+    Verify(kNumKeys, round);
+
+    // Current log, the one being flushed, and the recycled ones
+    ASSERT_LE(CountLogFiles(), 2 + 2);
+
+    Open();
+    Verify(kNumKeys, round);
+  }
+  ASSERT_GT(env_.reused(), 0);
+}
+
+}  // namespace leveldb
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,225 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#include "colsm/comparators.h"
+#include "colsm/vblock/vert_helper.h"
+#include "db/filename.h"
+#include "gtest/gtest.h"
+#include "helpers/memenv/memenv.h"
+#include "leveldb/db.h"
+#include "leveldb/env.h"
+#include "leveldb/layout_policy.h"
+#include "util/coding.h"
+#include "util/logging.h"
+
+namespace leveldb {
+
+// A clock that only moves when told to
+class ClockEnv : public EnvWrapper {
+ public:
+  explicit ClockEnv(Env* target) : EnvWrapper(target), now_(1000000) {}
+
+  uint64_t NowMicros() override { return now_.load(); }
+
+  void Advance(uint64_t micros) { now_.fetch_add(micros); }
+
+ private:
+  std::atomic<uint64_t> now_;
+};
+
+class RelayoutTest : public testing::Test {
+ public:
+  RelayoutTest()
+      : mem_env_(NewMemEnv(Env::Default())),
+        env_(mem_env_.get()),
+        comparator_(colsm::intComparator()),
+        db_(nullptr) {
+    LevelLayout horizontal;
+    horizontal.vertical = false;
+    horizontal_policy_.reset(NewLevelLayoutPolicy({horizontal}));
+  }
+
+  ~RelayoutTest() { delete db_; }
+
+  Options NewOptions() {
+    Options options;
+    options.env = &env_;
+    options.comparator = comparator_.get();
+    options.create_if_missing = true;
+    options.compression = kNoCompression;
+    return options;
+  }
+
+  void Open(const Options& options) {
+    delete db_;
+    db_ = nullptr;
+    ASSERT_TRUE(DB::Open(options, "/relayoutdb", &db_).ok());
+  }
+
+  static std::string Key(uint32_t i) {
+    std::string result;
+    PutFixed32(&result, i);
+    return result;
+  }
+
+  static std::string Value(uint32_t i) {
+    std::string result = std::to_string(i);
+    result.resize(1000, 'v');
+    return result;
+  }
+
+  // Fill a vertical DB whose tables are all below level-0
+  void Fill() {
+    Open(NewOptions());
+    for (uint32_t i = 0; i < kNumKeys; i++) {
+      ASSERT_TRUE(db_->Put(WriteOptions(), Key(i), Value(i)).ok());
+    }
+    db_->CompactRange(nullptr, nullptr);
+    std::string files;
+    ASSERT_TRUE(db_->GetProperty("leveldb.num-files-at-level0", &files));
+    ASSERT_EQ("0", files);
+  }
+
+  void Verify() {
+    for (uint32_t i = 0; i < kNumKeys; i++) {
+      std::string value;
+      ASSERT_TRUE(db_->Get(ReadOptions(), Key(i), &value).ok());
+      ASSERT_EQ(Value(i), value);
+    }
+  }
+
+  // Numbers of the vertical and horizontal tables of the current version,
+  // in increasing order. Replaced tables may stay on disk while a reader
+  // still uses an older version.
+  void ListTables(std::vector<uint64_t>* vertical,
+                  std::vector<uint64_t>* horizontal) {
+    vertical->clear();
+    horizontal->clear();
+    std::string sstables;
+    ASSERT_TRUE(db_->GetProperty("leveldb.sstables", &sstables));
+    Slice input(sstables);
+    while (!input.empty()) {
+      // Table lines look like " 17:123['a' .. 'd']"
+      const char* eol =
+          static_cast<const char*>(memchr(input.data(), '\n', input.size()));
+      Slice line(input.data(), eol - input.data());
+      input.remove_prefix(line.size() + 1);
+      uint64_t number;
+      if (line.starts_with(" ")) {
+        line.remove_prefix(1);
+        ASSERT_TRUE(ConsumeDecimalNumber(&line, &number));
+        if (colsm::IsVerticalTable(&env_,
+                                   TableFileName("/relayoutdb", number))) {
+          vertical->push_back(number);
+        } else {
+          horizontal->push_back(number);
+        }
+      }
+    }
+    std::sort(vertical->begin(), vertical->end());
+    std::sort(horizontal->begin(), horizontal->end());
+  }
+
+  // Wait for the background job to leave this many tables of each format. If
+  // "tick", time passes and reads come in meanwhile.
+  void WaitForTables(size_t vertical_count, size_t horizontal_count,
+                     bool tick) {
+    std::vector<uint64_t> vertical, horizontal;
+    for (int i = 0; i < 1000; i++) {
+      ListTables(&vertical, &horizontal);
+      if (vertical.size() == vertical_count &&
+          horizontal.size() == horizontal_count) {
+        break;
+      }
+      if (tick) {
+        env_.Advance(1000000);
+        std::string value;
+        ASSERT_TRUE(db_->Get(ReadOptions(), Key(i % kNumKeys), &value).ok());
+      }
+      Env::Default()->SleepForMicroseconds(10000);
+    }
+    ASSERT_EQ(vertical_count, vertical.size());
+    ASSERT_EQ(horizontal_count, horizontal.size());
+  }
+
+  static const uint32_t kNumKeys = 10000;
+
+  std::unique_ptr<Env> mem_env_;
+  ClockEnv env_;
+  std::unique_ptr<const Comparator> comparator_;
+  std::unique_ptr<const LayoutPolicy> horizontal_policy_;
+  DB* db_;
+};
+
+TEST_F(RelayoutTest, ConvertsLevels) {
+  Fill();
+  std::vector<uint64_t> vertical, horizontal;
+  ListTables(&vertical, &horizontal);
+  ASSERT_GT(vertical.size(), 1);
+  ASSERT_EQ(0, horizontal.size());
+
+  Options options = NewOptions();
+  options.layout_policy = horizontal_policy_.get();
+  options.relayout_bytes_per_second = 1 << 30;
+  Open(options);
+  WaitForTables(0, vertical.size(), true);
+  Verify();
+
+  Open(options);
+  Verify();
+}
+
+TEST_F(RelayoutTest, RateLimitedMostReadFirst) {
+  Fill();
+  std::vector<uint64_t> original, horizontal;
+  ListTables(&original, &horizontal);
+  ASSERT_GT(original.size(), 2);
+
+  // The first rewrite uses up the budget of the next many seconds
+  Options options = NewOptions();
+  options.layout_policy = horizontal_policy_.get();
+  options.relayout_bytes_per_second = 1024;
+  Open(options);
+  WaitForTables(original.size() - 1, 1, false);
+  std::string value;
+  for (int i = 0; i < 10; i++) {
+    ASSERT_TRUE(db_->Get(ReadOptions(), Key(0), &value).ok());
+  }
+  Env::Default()->SleepForMicroseconds(100000);
+  std::vector<uint64_t> vertical;
+  ListTables(&vertical, &horizontal);
+  ASSERT_EQ(1, horizontal.size());
+  ASSERT_EQ(original.size() - 1, vertical.size());
+
+  // Outputs are numbered in key order, the last table holds the last keys
+  for (int round = 0; round < 10; round++) {
+    for (uint32_t i = kNumKeys - 100; i < kNumKeys; i++) {
+      ASSERT_TRUE(db_->Get(ReadOptions(), Key(i), &value).ok());
+    }
+  }
+  ASSERT_EQ(original.back(), vertical.back());
+
+  // Once the budget refills, a read schedules the next rewrite
+  env_.Advance(3600ull * 1000000);
+  ASSERT_TRUE(db_->Get(ReadOptions(), Key(0), &value).ok());
+  WaitForTables(original.size() - 2, 2, false);
+  ListTables(&vertical, &horizontal);
+  ASSERT_EQ(original.size() - 2, vertical.size());
+  ASSERT_TRUE(std::find(vertical.begin(), vertical.end(), original.back()) ==
+              vertical.end());
+  Verify();
+}
+
+}  // namespace leveldb
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
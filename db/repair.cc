@@ -40,8 +40,6 @@
 #include "leveldb/db.h"
 #include "leveldb/env.h"
 
-#include "colsm/cost/cost_model.h"
-
 namespace leveldb {
 
 namespace {
@@ -53,7 +51,9 @@ class Repairer {
         env_(options.env),
         icmp_(options.comparator),
         ipolicy_(options.filter_policy),
-        options_(SanitizeOptions(dbname, &icmp_, &ipolicy_, options)),
+        persistent_cache_(options.persistent_cache),
+        options_(SanitizeOptions(dbname, &icmp_, &ipolicy_, &persistent_cache_,
+                                 options)),
         owns_info_log_(options_.info_log != options.info_log),
         owns_cache_(options_.block_cache != options.block_cache),
         next_file_number_(1) {
@@ -67,6 +67,7 @@ class Repairer {
       delete options_.info_log;
     }
     if (owns_cache_) {
+      persistent_cache_.Close();
       delete options_.block_cache;
     }
   }
@@ -175,7 +176,7 @@ class Repairer {
     // propagating bad information (like overly large sequence
     // numbers).
     log::Reader reader(lfile, &reporter, false /*do not checksum*/,
-                       0 /*initial_offset*/);
+                       0 /*initial_offset*/, log);
 
     // Read all the records and add to a memtable
     std::string scratch;
@@ -207,7 +208,11 @@ class Repairer {
     FileMetaData meta;
     meta.number = next_file_number_++;
     Iterator* iter = mem->NewIterator();
-    status = BuildTable(dbname_, env_, options_, table_cache_, iter, &meta);
+    // Only writes level 0 tables
+    bool vertical;
+    Options table_options = LevelTableOptions(options_, 0, &vertical);
+    status = BuildTable(dbname_, env_, table_options, vertical, table_cache_,
+                        iter, &meta);
     delete iter;
     mem->Unref();
     mem = nullptr;
@@ -280,7 +285,11 @@ class Repairer {
       if (parsed.sequence > t.max_sequence) {
         t.max_sequence = parsed.sequence;
       }
+      if (parsed.type == kTypeDeletion) {
+        t.meta.num_deletions++;
+      }
     }
+    t.meta.num_entries = counter;
     if (!iter->status().ok()) {
       status = iter->status();
     }
@@ -326,6 +335,7 @@ class Repairer {
       s = builder->Finish();
       if (s.ok()) {
         t.meta.file_size = builder->FileSize();
+        t.meta.num_entries = counter;
       }
     }
     delete builder;
@@ -375,7 +385,7 @@ class Repairer {
       // TODO(opt): separate out into multiple levels
       const TableInfo& t = tables_[i];
       edit_.AddFile(0, t.meta.number, t.meta.file_size, t.meta.smallest,
-                    t.meta.largest);
+                    t.meta.largest, t.meta.num_entries, t.meta.num_deletions);
     }
 
     // std::fprintf(stderr,
@@ -435,6 +445,7 @@ class Repairer {
   Env* const env_;
   InternalKeyComparator const icmp_;
   InternalFilterPolicy const ipolicy_;
+  ClosablePersistentCache persistent_cache_;
   const Options options_;
   bool owns_info_log_;
   bool owns_cache_;
@@ -0,0 +1,113 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include <memory>
+
+#include "colsm/comparators.h"
+#include "gtest/gtest.h"
+#include "helpers/memenv/memenv.h"
+#include "leveldb/cache.h"
+#include "leveldb/db.h"
+#include "leveldb/env.h"
+#include "util/coding.h"
+
+namespace leveldb {
+
+class RowCacheTest : public testing::Test {
+ public:
+  RowCacheTest()
+      : env_(NewMemEnv(Env::Default())),
+        comparator_(colsm::intComparator()),
+        row_cache_(NewLRUCache(1 << 20)),
+        db_(nullptr) {
+    Options options;
+    options.env = env_.get();
+    options.comparator = comparator_.get();
+    options.create_if_missing = true;
+    options.row_cache = row_cache_.get();
+    EXPECT_TRUE(DB::Open(options, "/rowdb", &db_).ok());
+  }
+
+  ~RowCacheTest() { delete db_; }
+
+  static std::string Key(uint32_t i) {
+    std::string result;
+    PutFixed32(&result, i);
+    return result;
+  }
+
+  std::string Get(uint32_t key, const Snapshot* snapshot = nullptr) {
+    ReadOptions options;
+    options.snapshot = snapshot;
+    std::string value;
+    Status s = db_->Get(options, Key(key), &value);
+    if (s.IsNotFound()) {
+      return "NOT_FOUND";
+    }
+    EXPECT_TRUE(s.ok());
+    return value;
+  }
+
+  void Put(uint32_t key, const std::string& value) {
+    ASSERT_TRUE(db_->Put(WriteOptions(), Key(key), value).ok());
+  }
+
+  std::unique_ptr<Env> env_;
+  std::unique_ptr<const Comparator> comparator_;
+  std::unique_ptr<Cache> row_cache_;
+  DB* db_;
+};
+
+TEST_F(RowCacheTest, HitAfterFill) {
+  for (uint32_t i = 0; i < 100; i++) {
+    Put(i, "v" + std::to_string(i));
+  }
+  db_->CompactRange(nullptr, nullptr);
+  ASSERT_EQ(0, row_cache_->TotalCharge());
+
+  ASSERT_EQ("v5", Get(5));
+  size_t charge = row_cache_->TotalCharge();
+  ASSERT_GT(charge, 0);
+  ASSERT_EQ("v5", Get(5));
+  ASSERT_EQ(charge, row_cache_->TotalCharge());
+  ASSERT_EQ("NOT_FOUND", Get(1000));
+}
+
+TEST_F(RowCacheTest, Overwrite) {
+  Put(1, "old");
+  db_->CompactRange(nullptr, nullptr);
+  ASSERT_EQ("old", Get(1));
+
+  // Newer writes are found in the memtable, then in the newer tables
+  Put(1, "new");
+  ASSERT_EQ("new", Get(1));
+  db_->CompactRange(nullptr, nullptr);
+  ASSERT_EQ("new", Get(1));
+  ASSERT_EQ("new", Get(1));
+
+  ASSERT_TRUE(db_->Delete(WriteOptions(), Key(1)).ok());
+  db_->CompactRange(nullptr, nullptr);
+  ASSERT_EQ("NOT_FOUND", Get(1));
+  ASSERT_EQ("NOT_FOUND", Get(1));
+}
+
+TEST_F(RowCacheTest, Snapshot) {
+  Put(1, "old");
+  const Snapshot* snapshot = db_->GetSnapshot();
+  Put(1, "new");
+  db_->CompactRange(nullptr, nullptr);
+
+  // Both versions are in the same table, the row holds the newer one
+  ASSERT_EQ("new", Get(1));
+  ASSERT_EQ("old", Get(1, snapshot));
+  ASSERT_EQ("new", Get(1));
+  db_->ReleaseSnapshot(snapshot);
+}
+
+}  // namespace leveldb
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
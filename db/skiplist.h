@@ -30,6 +30,8 @@
 #include <atomic>
 #include <cassert>
 #include <cstdlib>
+#include <functional>
+#include <thread>
 
 #include "util/arena.h"
 #include "util/random.h"
@@ -56,6 +58,12 @@ class SkipList {
   // REQUIRES: nothing that compares equal to key is currently in the list.
   void Insert(const Key& key);
 
+  // Like Insert(), but may run concurrently with other calls of
+  // InsertConcurrently().  Links are spliced in with compare-and-swap, and
+  // nodes come from per-thread slabs of the arena.
+  // REQUIRES: no concurrent call of Insert()
+  void InsertConcurrently(const Key& key);
+
   // Returns true iff an entry that compares equal to key is in the list.
   bool Contains(const Key& key) const;
 
@@ -107,6 +115,8 @@ class SkipList {
 
   Node* NewNode(const Key& key, int height);
   int RandomHeight();
+  // Thread-safe variant of RandomHeight()
+  int RandomHeightConcurrently();
   bool Equal(const Key& a, const Key& b) const { return (compare_(a, b) == 0); }
 
   // Return true if key is greater than the data stored in "n"
@@ -173,6 +183,13 @@ struct SkipList<Key, Comparator>::Node {
     next_[n].store(x, std::memory_order_relaxed);
   }
 
+  // Link x after this node if the link still points to expected.
+  bool CASNext(int n, Node* expected, Node* x) {
+    assert(n >= 0);
+    return next_[n].compare_exchange_strong(expected, x,
+                                            std::memory_order_release);
+  }
+
  private:
   // Array of length equal to the node height.  next_[0] is lowest level link.
   std::atomic<Node*> next_[1];
@@ -251,6 +268,18 @@ int SkipList<Key, Comparator>::RandomHeight() {
   return height;
 }
 
+template <typename Key, class Comparator>
+int SkipList<Key, Comparator>::RandomHeightConcurrently() {
+  static const unsigned int kBranching = 4;
+  static thread_local Random rnd(static_cast<uint32_t>(
+      std::hash<std::thread::id>()(std::this_thread::get_id())));
+  int height = 1;
+  while (height < kMaxHeight && ((rnd.Next() % kBranching) == 0)) {
+    height++;
+  }
+  return height;
+}
+
 template <typename Key, class Comparator>
 bool SkipList<Key, Comparator>::KeyIsAfterNode(const Key& key, Node* n) const {
   // null n is considered infinite
@@ -325,7 +354,7 @@ template <typename Key, class Comparator>
 SkipList<Key, Comparator>::SkipList(Comparator cmp, Arena* arena)
     : compare_(cmp),
       arena_(arena),
-      head_(NewNode(0 /* any key will do */, kMaxHeight)),
+      head_(NewNode(Key() /* any key will do */, kMaxHeight)),
       max_height_(1),
       rnd_(0xdeadbeef) {
   for (int i = 0; i < kMaxHeight; i++) {
@@ -367,6 +396,41 @@ void SkipList<Key, Comparator>::Insert(const Key& key) {
   }
 }
 
+template <typename Key, class Comparator>
+void SkipList<Key, Comparator>::InsertConcurrently(const Key& key) {
+  const int height = RandomHeightConcurrently();
+  int max_height = GetMaxHeight();
+  while (height > max_height &&
+         !max_height_.compare_exchange_weak(max_height, height,
+                                            std::memory_order_relaxed)) {
+  }
+
+  // prev[i] comes before key at level i, though other inserts may have
+  // put nodes between it and key since
+  Node* prev[kMaxHeight];
+  FindGreaterOrEqual(key, prev);
+
+  char* const node_memory = arena_->AllocateConcurrently(
+      sizeof(Node) + sizeof(std::atomic<Node*>) * (height - 1));
+  Node* x = new (node_memory) Node(key);
+  for (int i = 0; i < height; i++) {
+    while (true) {
+      // Move past the nodes inserted before key since prev[i] was found
+      Node* next = prev[i]->Next(i);
+      while (KeyIsAfterNode(key, next)) {
+        prev[i] = next;
+        next = next->Next(i);
+      }
+      // Our data structure does not allow duplicate insertion
+      assert(next == nullptr || !Equal(key, next->key));
+      x->NoBarrier_SetNext(i, next);
+      if (prev[i]->CASNext(i, next, x)) {
+        break;
+      }
+    }
+  }
+}
+
 template <typename Key, class Comparator>
 bool SkipList<Key, Comparator>::Contains(const Key& key) const {
   Node* x = FindGreaterOrEqual(key, nullptr);
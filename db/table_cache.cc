@@ -4,6 +4,7 @@
 
 #include "db/table_cache.h"
 
+#include "db/dbformat.h"
 #include "db/filename.h"
 #include "leveldb/env.h"
 #include "leveldb/table.h"
@@ -23,6 +24,35 @@ static void DeleteEntry(const Slice& key, void* value) {
   delete tf;
 }
 
+// A row is the entry found by a point lookup in a table, encoded as
+//    found_key   : length-prefixed internal key
+//    found_value : char[]
+static void DeleteRow(const Slice& key, void* value) {
+  delete reinterpret_cast<std::string*>(value);
+}
+
+struct RowSaver {
+  void* arg;
+  void (*handle_result)(void*, const Slice&, const Slice&);
+  Slice user_key;
+  std::string row;
+};
+
+// Record the found entry if it is for the key looked up, and pass it on
+static void SaveRow(void* arg, const Slice& found_key,
+                    const Slice& found_value) {
+  RowSaver* saver = reinterpret_cast<RowSaver*>(arg);
+  if (found_key.size() >= 8 && ExtractUserKey(found_key) == saver->user_key) {
+    PutLengthPrefixedSlice(&saver->row, found_key);
+    saver->row.append(found_value.data(), found_value.size());
+  }
+  (*saver->handle_result)(saver->arg, found_key, found_value);
+}
+
+static inline SequenceNumber SequenceOf(const Slice& internal_key) {
+  return DecodeFixed64(internal_key.data() + internal_key.size() - 8) >> 8;
+}
+
 static void UnrefEntry(void* arg1, void* arg2) {
   Cache* cache = reinterpret_cast<Cache*>(arg1);
   Cache::Handle* h = reinterpret_cast<Cache::Handle*>(arg2);
@@ -34,7 +64,9 @@ TableCache::TableCache(const std::string& dbname, const Options& options,
     : env_(options.env),
       dbname_(dbname),
       options_(options),
-      cache_(NewLRUCache(entries)) {}
+      cache_(NewLRUCache(entries)),
+      row_cache_id_(options.row_cache != nullptr ? options.row_cache->NewId()
+                                                 : 0) {}
 
 TableCache::~TableCache() { delete cache_; }
 
@@ -101,11 +133,61 @@ Status TableCache::Get(const ReadOptions& options, uint64_t file_number,
                        uint64_t file_size, const Slice& k, void* arg,
                        void (*handle_result)(void*, const Slice&,
                                              const Slice&)) {
+  Cache* row_cache = options_.row_cache;
+  if (row_cache == nullptr) {
+    Cache::Handle* handle = nullptr;
+    Status s = FindTable(file_number, file_size, &handle);
+    if (s.ok()) {
+      Table* t = reinterpret_cast<TableAndFile*>(cache_->Value(handle))->table;
+      s = t->InternalGet(options, k, arg, handle_result);
+      cache_->Release(handle);
+    }
+    return s;
+  }
+
+  // Tables are immutable, so a row keyed by file number and user key never
+  // goes stale. Newer writes are found in the memtable or in newer files.
+  const Slice user_key = ExtractUserKey(k);
+  std::string row_key;
+  PutFixed64(&row_key, row_cache_id_);
+  PutFixed64(&row_key, file_number);
+  row_key.append(user_key.data(), user_key.size());
+
+  Cache::Handle* row_handle = row_cache->Lookup(row_key);
+  if (row_handle != nullptr) {
+    Slice row(*reinterpret_cast<std::string*>(row_cache->Value(row_handle)));
+    Slice found_key;
+    // The row holds the newest entry of the key in the file, which is the
+    // result of the lookup unless it is newer than the lookup's snapshot
+    if (GetLengthPrefixedSlice(&row, &found_key) &&
+        SequenceOf(found_key) <= SequenceOf(k)) {
+      (*handle_result)(arg, found_key, row);
+      row_cache->Release(row_handle);
+      return Status::OK();
+    }
+    row_cache->Release(row_handle);
+  }
+
   Cache::Handle* handle = nullptr;
   Status s = FindTable(file_number, file_size, &handle);
   if (s.ok()) {
     Table* t = reinterpret_cast<TableAndFile*>(cache_->Value(handle))->table;
-    s = t->InternalGet(options, k, arg, handle_result);
+    // Only a lookup at the latest state is sure to find the newest entry
+    if (options.snapshot == nullptr && options.fill_cache) {
+      RowSaver saver;
+      saver.arg = arg;
+      saver.handle_result = handle_result;
+      saver.user_key = user_key;
+      s = t->InternalGet(options, k, &saver, SaveRow);
+      if (s.ok() && !saver.row.empty()) {
+        const size_t charge = saver.row.size() + row_key.size();
+        row_cache->Release(row_cache->Insert(
+            row_key, new std::string(std::move(saver.row)), charge,
+            &DeleteRow));
+      }
+    } else {
+      s = t->InternalGet(options, k, arg, handle_result);
+    }
     cache_->Release(handle);
   }
   return s;
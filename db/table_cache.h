@@ -50,6 +50,8 @@ class TableCache {
   const std::string dbname_;
   const Options& options_;
   Cache* cache_;
+  // Prefix of the row cache keys, as the row cache may be shared among DBs
+  const uint64_t row_cache_id_;
 };
 
 }  // namespace leveldb
@@ -0,0 +1,179 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#include "colsm/comparators.h"
+#include "gtest/gtest.h"
+#include "helpers/memenv/memenv.h"
+#include "leveldb/db.h"
+#include "leveldb/env.h"
+#include "util/coding.h"
+#include "util/logging.h"
+
+namespace leveldb {
+
+static const uint32_t kNumKeys = 2000;
+
+static std::string Key(uint32_t i) {
+  std::string result;
+  PutFixed32(&result, i);
+  return result;
+}
+
+static std::string Value(uint32_t i, int round) {
+  std::string result = std::to_string(i) + "." + std::to_string(round);
+  result.resize(1000, 'v');
+  return result;
+}
+
+class TieredCompactionTest : public testing::Test {
+ public:
+  TieredCompactionTest()
+      : env_(NewMemEnv(Env::Default())),
+        comparator_(colsm::intComparator()),
+        db_(nullptr) {}
+
+  ~TieredCompactionTest() { delete db_; }
+
+  void Open() {
+    delete db_;
+    db_ = nullptr;
+    Options options;
+    options.env = env_.get();
+    options.comparator = comparator_.get();
+    options.create_if_missing = true;
+    options.compression = kNoCompression;
+    options.write_buffer_size = 100 * 1024;
+    // Small levels, so the keys spread over several of them
+    options.max_file_size = 1 << 20;
+    options.size_factor = 2;
+    options.layout_adaptation_ops = 2000;
+    options.tiered_compaction = true;
+    ASSERT_TRUE(DB::Open(options, "/tiereddb", &db_).ok());
+  }
+
+  void Fill(int round) {
+    for (uint32_t i = 0; i < kNumKeys; i++) {
+      ASSERT_TRUE(db_->Put(WriteOptions(), Key(i), Value(i, round)).ok());
+    }
+  }
+
+  void Verify(int round) {
+    for (uint32_t i = 0; i < kNumKeys; i++) {
+      std::string value;
+      ASSERT_TRUE(db_->Get(ReadOptions(), Key(i), &value).ok());
+      ASSERT_EQ(Value(i, round), value);
+    }
+    Iterator* iter = db_->NewIterator(ReadOptions());
+    uint32_t i = 0;
+    for (iter->SeekToFirst(); iter->Valid(); iter->Next(), i++) {
+      ASSERT_EQ(Key(i), iter->key().ToString());
+      ASSERT_EQ(Value(i, round), iter->value().ToString());
+    }
+    ASSERT_TRUE(iter->status().ok());
+    ASSERT_EQ(kNumKeys, i);
+    delete iter;
+  }
+
+  std::string MergePolicy() {
+    std::string policy;
+    EXPECT_TRUE(db_->GetProperty("leveldb.merge-policy", &policy));
+    return policy;
+  }
+
+  // Table bytes of each level
+  std::vector<uint64_t> LevelBytes() {
+    std::string sstables;
+    EXPECT_TRUE(db_->GetProperty("leveldb.sstables", &sstables));
+    std::vector<uint64_t> bytes;
+    Slice input(sstables);
+    while (!input.empty()) {
+      // Table lines look like " 17:123['a' .. 'd']"
+      const char* eol =
+          static_cast<const char*>(memchr(input.data(), '\n', input.size()));
+      Slice line(input.data(), eol - input.data());
+      input.remove_prefix(line.size() + 1);
+      uint64_t number, size;
+      if (line.starts_with(" ")) {
+        line.remove_prefix(1);
+        EXPECT_TRUE(ConsumeDecimalNumber(&line, &number));
+        EXPECT_TRUE(line.starts_with(":"));
+        line.remove_prefix(1);
+        EXPECT_TRUE(ConsumeDecimalNumber(&line, &size));
+        bytes.back() += size;
+      } else {
+        // Next level header
+        bytes.push_back(0);
+      }
+    }
+    return bytes;
+  }
+
+  // Deepest level holding tables
+  int LastLevel() {
+    std::vector<uint64_t> bytes = LevelBytes();
+    int last = bytes.size() - 1;
+    while (last > 0 && bytes[last] == 0) {
+      last--;
+    }
+    return last;
+  }
+
+  std::unique_ptr<Env> env_;
+  std::unique_ptr<const Comparator> comparator_;
+  DB* db_;
+};
+
+TEST_F(TieredCompactionTest, UpdatesTierLevels) {
+  Open();
+  ASSERT_EQ("TLLLLLL", MergePolicy());
+
+  // Updates only, tiering rewrites the updated keys less often
+  for (int round = 0; round < 2; round++) {
+    Fill(round);
+  }
+  ASSERT_GT(LastLevel(), 1);
+  ASSERT_EQ('T', MergePolicy()[1]);
+
+  // Each round overwrites every key. The runs of the tiered levels may hold
+  // several versions of them, but the deepest level is leveled, so it holds
+  // each key about once.
+  for (int round = 2; round < 6; round++) {
+    Fill(round);
+  }
+  const int last = LastLevel();
+  ASSERT_EQ('L', MergePolicy()[last]);
+  ASSERT_LT(LevelBytes()[last], 1.25 * kNumKeys * 1000);
+  Verify(5);
+
+  for (uint32_t i = 0; i < kNumKeys; i += 2) {
+    ASSERT_TRUE(db_->Delete(WriteOptions(), Key(i)).ok());
+  }
+  for (uint32_t i = 0; i < kNumKeys; i += 2) {
+    ASSERT_TRUE(db_->Put(WriteOptions(), Key(i), Value(i, 5)).ok());
+  }
+  db_->CompactRange(nullptr, nullptr);
+  Verify(5);
+
+  // Levels left with several runs are still read in the right order once
+  // every level uses leveling again
+  Fill(6);
+  Open();
+  ASSERT_EQ("TLLLLLL", MergePolicy());
+  Verify(6);
+  Fill(7);
+  db_->CompactRange(nullptr, nullptr);
+  Verify(7);
+}
+
+}  // namespace leveldb
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
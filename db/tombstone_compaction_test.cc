@@ -0,0 +1,166 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include <cstring>
+#include <memory>
+
+#include "colsm/comparators.h"
+#include "db/db_impl.h"
+#include "gtest/gtest.h"
+#include "helpers/memenv/memenv.h"
+#include "leveldb/db.h"
+#include "leveldb/env.h"
+#include "util/coding.h"
+#include "util/logging.h"
+
+namespace leveldb {
+
+static const uint32_t kNumKeys = 10000;
+
+static std::string Key(uint32_t i) {
+  std::string result;
+  PutFixed32(&result, i);
+  return result;
+}
+
+static std::string Value(uint32_t i) {
+  std::string result = std::to_string(i);
+  result.resize(100, 'v');
+  return result;
+}
+
+class TombstoneCompactionTest : public testing::Test {
+ public:
+  TombstoneCompactionTest()
+      : env_(NewMemEnv(Env::Default())),
+        comparator_(colsm::intComparator()),
+        db_(nullptr),
+        full_bytes_(0) {}
+
+  ~TombstoneCompactionTest() { delete db_; }
+
+  void Open(const Options& base) {
+    delete db_;
+    db_ = nullptr;
+    Options options = base;
+    options.env = env_.get();
+    options.comparator = comparator_.get();
+    options.create_if_missing = true;
+    options.compression = kNoCompression;
+    ASSERT_TRUE(DB::Open(options, "/tombstonedb", &db_).ok());
+  }
+
+  DBImpl* dbfull() { return reinterpret_cast<DBImpl*>(db_); }
+
+  // Write every key and compact them into the levels below, then delete
+  // the first "deleted" keys and write nothing more.  Stores the table
+  // bytes of every key in full_bytes_.
+  void FillAndDelete(uint32_t deleted) {
+    for (uint32_t i = 0; i < kNumKeys; i++) {
+      ASSERT_TRUE(db_->Put(WriteOptions(), Key(i), Value(i)).ok());
+    }
+    db_->CompactRange(nullptr, nullptr);
+    full_bytes_ = TotalBytes();
+    for (uint32_t i = 0; i < deleted; i++) {
+      ASSERT_TRUE(db_->Delete(WriteOptions(), Key(i)).ok());
+    }
+    ASSERT_TRUE(dbfull()->TEST_CompactMemTable().ok());
+  }
+
+  // Table bytes of the DB
+  uint64_t TotalBytes() {
+    std::string sstables;
+    EXPECT_TRUE(db_->GetProperty("leveldb.sstables", &sstables));
+    uint64_t total = 0;
+    Slice input(sstables);
+    while (!input.empty()) {
+      // Table lines look like " 17:123['a' .. 'd']"
+      const char* eol =
+          static_cast<const char*>(memchr(input.data(), '\n', input.size()));
+      Slice line(input.data(), eol - input.data());
+      input.remove_prefix(line.size() + 1);
+      uint64_t number, size;
+      if (line.starts_with(" ")) {
+        line.remove_prefix(1);
+        EXPECT_TRUE(ConsumeDecimalNumber(&line, &number));
+        EXPECT_TRUE(line.starts_with(":"));
+        line.remove_prefix(1);
+        EXPECT_TRUE(ConsumeDecimalNumber(&line, &size));
+        total += size;
+      }
+    }
+    return total;
+  }
+
+  // Wait for the tables to shrink below "bytes"
+  void WaitForBytesBelow(uint64_t bytes) {
+    for (int i = 0; i < 1000 && TotalBytes() >= bytes; i++) {
+      Env::Default()->SleepForMicroseconds(1000);
+    }
+    ASSERT_LT(TotalBytes(), bytes);
+  }
+
+  void Verify(uint32_t deleted) {
+    for (uint32_t i = 0; i < kNumKeys; i++) {
+      std::string value;
+      Status s = db_->Get(ReadOptions(), Key(i), &value);
+      if (i < deleted) {
+        ASSERT_TRUE(s.IsNotFound()) << i;
+      } else {
+        ASSERT_TRUE(s.ok()) << i;
+        ASSERT_EQ(Value(i), value);
+      }
+    }
+  }
+
+  std::unique_ptr<Env> env_;
+  std::unique_ptr<const Comparator> comparator_;
+  DB* db_;
+  uint64_t full_bytes_;
+};
+
+TEST_F(TombstoneCompactionTest, DeletedRangeIsCompactedAway) {
+  Options options;
+  options.tombstone_compaction_ratio = 0.5;
+  Open(options);
+  FillAndDelete(kNumKeys / 2);
+
+  // The table of deletions is merged with the keys it deletes, though no
+  // level is over its size
+  WaitForBytesBelow(full_bytes_ * 0.6);
+  Verify(kNumKeys / 2);
+}
+
+TEST_F(TombstoneCompactionTest, CoveredBytesTriggerCompaction) {
+  Options options;
+  options.tombstone_compaction_bytes = 100 * 1024;
+  Open(options);
+  FillAndDelete(kNumKeys / 2);
+  WaitForBytesBelow(full_bytes_ * 0.6);
+  Verify(kNumKeys / 2);
+}
+
+TEST_F(TombstoneCompactionTest, DeletionsStayWithoutOption) {
+  Open(Options());
+  FillAndDelete(kNumKeys / 2);
+  const uint64_t bytes = TotalBytes();
+  Env::Default()->SleepForMicroseconds(100000);
+  ASSERT_EQ(bytes, TotalBytes());
+  ASSERT_GT(bytes, full_bytes_);
+  Verify(kNumKeys / 2);
+
+  // The deletion counts are read back from the manifest
+  Options options;
+  options.tombstone_compaction_ratio = 0.5;
+  Open(options);
+  WaitForBytesBelow(full_bytes_ * 0.6);
+  Verify(kNumKeys / 2);
+}
+
+}  // namespace leveldb
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
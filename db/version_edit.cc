@@ -20,7 +20,9 @@ enum Tag {
   kDeletedFile = 6,
   kNewFile = 7,
   // 8 was used for large value refs
-  kPrevLogNumber = 9
+  kPrevLogNumber = 9,
+  // Entry and deletion counts of the file added by the preceding kNewFile
+  kNewFileEntries = 10
 };
 
 void VersionEdit::Clear() {
@@ -80,6 +82,12 @@ void VersionEdit::EncodeTo(std::string* dst) const {
     PutVarint64(dst, f.file_size);
     PutLengthPrefixedSlice(dst, f.smallest.Encode());
     PutLengthPrefixedSlice(dst, f.largest.Encode());
+    if (f.num_entries > 0) {
+      PutVarint32(dst, kNewFileEntries);
+      PutVarint64(dst, f.number);
+      PutVarint64(dst, f.num_entries);
+      PutVarint64(dst, f.num_deletions);
+    }
   }
 }
 
@@ -185,6 +193,17 @@ Status VersionEdit::DecodeFrom(const Slice& src) {
         }
         break;
 
+      case kNewFileEntries:
+        if (GetVarint64(&input, &number) && !new_files_.empty() &&
+            new_files_.back().second.number == number &&
+            GetVarint64(&input, &new_files_.back().second.num_entries) &&
+            GetVarint64(&input, &new_files_.back().second.num_deletions)) {
+          // Counts attached to the file just added
+        } else {
+          msg = "new-file entry counts";
+        }
+        break;
+
       default:
         msg = "unknown tag";
         break;
@@ -249,6 +268,13 @@ std::string VersionEdit::DebugString() const {
     r.append(f.smallest.DebugString());
     r.append(" .. ");
     r.append(f.largest.DebugString());
+    if (f.num_entries > 0) {
+      r.append(" ");
+      AppendNumberTo(&r, f.num_deletions);
+      r.append("/");
+      AppendNumberTo(&r, f.num_entries);
+      r.append(" deletions");
+    }
   }
   r.append("\n}\n");
   return r;
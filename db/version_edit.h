@@ -5,6 +5,7 @@
 #ifndef STORAGE_LEVELDB_DB_VERSION_EDIT_H_
 #define STORAGE_LEVELDB_DB_VERSION_EDIT_H_
 
+#include <atomic>
 #include <set>
 #include <utility>
 #include <vector>
@@ -16,7 +17,39 @@ namespace leveldb {
 class VersionSet;
 
 struct FileMetaData {
-  FileMetaData() : refs(0), allowed_seeks(1 << 30), file_size(0) {}
+  FileMetaData()
+      : refs(0),
+        allowed_seeks(1 << 30),
+        file_size(0),
+        num_entries(0),
+        num_deletions(0),
+        being_compacted(false),
+        reads(0),
+        scans(0),
+        wasted_reads(0) {}
+
+  // Copies the read counts as of the copy
+  FileMetaData(const FileMetaData& f) : reads(0), scans(0), wasted_reads(0) {
+    *this = f;
+  }
+  FileMetaData& operator=(const FileMetaData& f) {
+    refs = f.refs;
+    allowed_seeks = f.allowed_seeks;
+    number = f.number;
+    file_size = f.file_size;
+    smallest = f.smallest;
+    largest = f.largest;
+    num_entries = f.num_entries;
+    num_deletions = f.num_deletions;
+    being_compacted = f.being_compacted;
+    reads.store(f.reads.load(std::memory_order_relaxed),
+                std::memory_order_relaxed);
+    scans.store(f.scans.load(std::memory_order_relaxed),
+                std::memory_order_relaxed);
+    wasted_reads.store(f.wasted_reads.load(std::memory_order_relaxed),
+                       std::memory_order_relaxed);
+    return *this;
+  }
 
   int refs;
   int allowed_seeks;  // Seeks allowed until compaction
@@ -24,6 +57,22 @@ struct FileMetaData {
   uint64_t file_size;    // File size in bytes
   InternalKey smallest;  // Smallest internal key served by table
   InternalKey largest;   // Largest internal key served by table
+  // Entries of the table and how many of them are deletion markers, zero
+  // if the manifest that added the table did not record them
+  uint64_t num_entries;
+  uint64_t num_deletions;
+  bool being_compacted;  // Input of a running compaction, guarded by DB mutex
+  // Point lookups that read the table, counted if
+  // Options::relayout_bytes_per_second is positive or
+  // Options::key_range_layout is set
+  std::atomic<uint32_t> reads;
+  // Iterators over the DB that entered the table, counted if
+  // Options::key_range_layout is set
+  std::atomic<uint32_t> scans;
+  // Point lookups that read the table in vain before a deeper one, and
+  // iterators that merged it with overlapping tables of its level, counted
+  // if Options::read_aware_compaction is set
+  std::atomic<uint32_t> wasted_reads;
 };
 
 class VersionEdit {
@@ -60,13 +109,18 @@ class VersionEdit {
   // Add the specified file at the specified number.
   // REQUIRES: This version has not been saved (see VersionSet::SaveTo)
   // REQUIRES: "smallest" and "largest" are smallest and largest keys in file
+  // REQUIRES: "num_deletions" of the "num_entries" entries of the file are
+  //           deletion markers, both zero if unknown
   void AddFile(int level, uint64_t file, uint64_t file_size,
-               const InternalKey& smallest, const InternalKey& largest) {
+               const InternalKey& smallest, const InternalKey& largest,
+               uint64_t num_entries = 0, uint64_t num_deletions = 0) {
     FileMetaData f;
     f.number = file;
     f.file_size = file_size;
     f.smallest = smallest;
     f.largest = largest;
+    f.num_entries = num_entries;
+    f.num_deletions = num_deletions;
     new_files_.push_back(std::make_pair(level, f));
   }
 
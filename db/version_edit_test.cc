@@ -5,6 +5,7 @@
 #include "db/version_edit.h"
 
 #include "gtest/gtest.h"
+#include "util/coding.h"
 
 namespace leveldb {
 
@@ -38,6 +39,29 @@ TEST(VersionEditTest, EncodeDecode) {
   TestEncodeDecode(edit);
 }
 
+TEST(VersionEditTest, EntryCounts) {
+  VersionEdit edit;
+  edit.AddFile(2, 7, 1000, InternalKey("foo", 1, kTypeValue),
+               InternalKey("zoo", 2, kTypeDeletion), 10, 3);
+  edit.AddFile(2, 8, 1000, InternalKey("zoo", 3, kTypeValue),
+               InternalKey("zzz", 4, kTypeValue));
+  TestEncodeDecode(edit);
+
+  std::string encoded;
+  edit.EncodeTo(&encoded);
+  VersionEdit parsed;
+  ASSERT_TRUE(parsed.DecodeFrom(encoded).ok());
+  ASSERT_NE(std::string::npos, parsed.DebugString().find("3/10 deletions"));
+
+  // Counts of a file the edit does not add
+  encoded.clear();
+  PutVarint32(&encoded, 10);  // kNewFileEntries
+  PutVarint64(&encoded, 7);
+  PutVarint64(&encoded, 10);
+  PutVarint64(&encoded, 3);
+  ASSERT_TRUE(parsed.DecodeFrom(encoded).IsCorruption());
+}
+
 }  // namespace leveldb
 
 int main(int argc, char** argv) {
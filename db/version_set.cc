@@ -10,6 +10,7 @@
 #include "db/memtable.h"
 #include "db/table_cache.h"
 #include <algorithm>
+#include <cmath>
 #include <cstdio>
 
 #include "leveldb/env.h"
@@ -65,6 +66,20 @@ static int64_t TotalFileSize(const std::vector<FileMetaData*>& files) {
   return sum;
 }
 
+// Average size of the entries of "files" whose entries are counted, zero
+// if there are none
+static double AverageEntryBytes(const std::vector<FileMetaData*>& files) {
+  uint64_t bytes = 0;
+  uint64_t entries = 0;
+  for (const FileMetaData* f : files) {
+    if (f->num_entries > 0) {
+      bytes += f->file_size;
+      entries += f->num_entries;
+    }
+  }
+  return entries > 0 ? static_cast<double>(bytes) / entries : 0;
+}
+
 Version::~Version() {
   assert(refs_ == 0);
 
@@ -160,24 +175,34 @@ bool SomeFileOverlapsRange(const InternalKeyComparator& icmp,
 // information about the files in the level.  For a given entry, key()
 // is the largest key that occurs in the file, and value() is an
 // 16-byte value containing the file number and file size, both
-// encoded using EncodeFixed64.
+// encoded using EncodeFixed64.  If "count_scans", each file the iterator
+// moves to counts a scan.
 class Version::LevelFileNumIterator : public Iterator {
  public:
   LevelFileNumIterator(const InternalKeyComparator& icmp,
-                       const std::vector<FileMetaData*>* flist)
-      : icmp_(icmp), flist_(flist), index_(flist->size()) {  // Marks as invalid
-  }
+                       const std::vector<FileMetaData*>* flist,
+                       bool count_scans = false)
+      : icmp_(icmp),
+        flist_(flist),
+        index_(flist->size()),  // Marks as invalid
+        count_scans_(count_scans) {}
   bool Valid() const override { return index_ < flist_->size(); }
   void Seek(const Slice& target) override {
     index_ = FindFile(icmp_, *flist_, target);
+    CountScan();
+  }
+  void SeekToFirst() override {
+    index_ = 0;
+    CountScan();
   }
-  void SeekToFirst() override { index_ = 0; }
   void SeekToLast() override {
     index_ = flist_->empty() ? 0 : flist_->size() - 1;
+    CountScan();
   }
   void Next() override {
     assert(Valid());
     index_++;
+    CountScan();
   }
   void Prev() override {
     assert(Valid());
@@ -186,6 +211,7 @@ class Version::LevelFileNumIterator : public Iterator {
     } else {
       index_--;
     }
+    CountScan();
   }
   Slice key() const override {
     assert(Valid());
@@ -200,9 +226,16 @@ class Version::LevelFileNumIterator : public Iterator {
   Status status() const override { return Status::OK(); }
 
  private:
+  void CountScan() {
+    if (count_scans_ && Valid()) {
+      (*flist_)[index_]->scans.fetch_add(1, std::memory_order_relaxed);
+    }
+  }
+
   const InternalKeyComparator icmp_;
   const std::vector<FileMetaData*>* const flist_;
   uint32_t index_;
+  const bool count_scans_;
 
   // Backing store for value().  Holds the file number and size.
   mutable char value_buf_[16];
@@ -223,28 +256,59 @@ static Iterator* GetFileIterator(void* arg, const ReadOptions& options,
 Iterator* Version::NewConcatenatingIterator(const ReadOptions& options,
                                             int level) const {
   return NewTwoLevelIterator(
-      new LevelFileNumIterator(vset_->icmp_, &files_[level]), &GetFileIterator,
-      vset_->table_cache_, options);
+      new LevelFileNumIterator(vset_->icmp_, &files_[level],
+                               vset_->options_->key_range_layout),
+      &GetFileIterator, vset_->table_cache_, options);
 }
 
-void Version::AddIterators(const ReadOptions& options,
+bool Version::AddIterators(const ReadOptions& options,
                            std::vector<Iterator*>* iters) {
-  // Merge all level zero files together since they may overlap
-  for (size_t i = 0; i < files_[0].size(); i++) {
-    iters->push_back(vset_->table_cache_->NewIterator(
-        options, files_[0][i]->number, files_[0][i]->file_size));
-  }
+  // Levels and files outside the iterator bounds are not visited
+  const Comparator* ucmp = vset_->icmp_.user_comparator();
+  const Slice* lower = options.iterate_lower_bound;
+  const Slice* upper = options.iterate_upper_bound;
+  bool read_cost_exceeded = false;
 
-  // For levels > 0, we can use a concatenating iterator that sequentially
-  // walks through the non-overlapping files in the level, opening them
-  // lazily.
-  for (int level = 1; level < config::kNumLevels; level++) {
-    if (!files_[level].empty()) {
+  for (int level = 0; level < config::kNumLevels; level++) {
+    if (overlapping_[level]) {
+      // Merge all level zero files together since they may overlap, and
+      // the files of the levels holding several sorted runs
+      std::vector<FileMetaData*> merged;
+      for (FileMetaData* f : files_[level]) {
+        if (AfterFile(ucmp, lower, f) || BeforeFile(ucmp, upper, f)) {
+          continue;
+        }
+        if (vset_->options_->key_range_layout) {
+          f->scans.fetch_add(1, std::memory_order_relaxed);
+        }
+        iters->push_back(
+            vset_->table_cache_->NewIterator(options, f->number, f->file_size));
+        merged.push_back(f);
+      }
+      if (vset_->options_->read_aware_compaction && merged.size() > 1) {
+        for (FileMetaData* f : merged) {
+          read_cost_exceeded |= vset_->ChargeRead(level, f);
+        }
+      }
+    } else if (!files_[level].empty() &&
+               ((lower == nullptr && upper == nullptr) ||
+                OverlapInLevel(level, lower, upper))) {
+      // For other levels, we can use a concatenating iterator that
+      // sequentially walks through the non-overlapping files in the level,
+      // opening them lazily.
       iters->push_back(NewConcatenatingIterator(options, level));
     }
   }
+
+  if (read_cost_exceeded && this == vset_->current_) {
+    // Rescore with the reads that cost more than a compaction now
+    vset_->Finalize(this);
+    return true;
+  }
+  return false;
 }
 
+
 // Callback from TableCache::Get()
 namespace {
 enum SaverState {
@@ -283,30 +347,31 @@ void Version::ForEachOverlapping(Slice user_key, Slice internal_key, void* arg,
                                  bool (*func)(void*, int, FileMetaData*)) {
   const Comparator* ucmp = vset_->icmp_.user_comparator();
 
-  // Search level-0 in order from newest to oldest.
   std::vector<FileMetaData*> tmp;
-  tmp.reserve(files_[0].size());
-  for (uint32_t i = 0; i < files_[0].size(); i++) {
-    FileMetaData* f = files_[0][i];
-    if (ucmp->Compare(user_key, f->smallest.user_key()) >= 0 &&
-        ucmp->Compare(user_key, f->largest.user_key()) <= 0) {
-      tmp.push_back(f);
-    }
-  }
-  if (!tmp.empty()) {
-    std::sort(tmp.begin(), tmp.end(), NewestFirst);
-    for (uint32_t i = 0; i < tmp.size(); i++) {
-      if (!(*func)(arg, 0, tmp[i])) {
-        return;
-      }
-    }
-  }
-
-  // Search other levels.
-  for (int level = 1; level < config::kNumLevels; level++) {
+  for (int level = 0; level < config::kNumLevels; level++) {
     size_t num_files = files_[level].size();
     if (num_files == 0) continue;
 
+    if (overlapping_[level]) {
+      // Search level-0, and levels holding several sorted runs, in order
+      // from newest to oldest.
+      tmp.clear();
+      for (uint32_t i = 0; i < num_files; i++) {
+        FileMetaData* f = files_[level][i];
+        if (ucmp->Compare(user_key, f->smallest.user_key()) >= 0 &&
+            ucmp->Compare(user_key, f->largest.user_key()) <= 0) {
+          tmp.push_back(f);
+        }
+      }
+      std::sort(tmp.begin(), tmp.end(), NewestFirst);
+      for (uint32_t i = 0; i < tmp.size(); i++) {
+        if (!(*func)(arg, level, tmp[i])) {
+          return;
+        }
+      }
+      continue;
+    }
+
     // Binary search to find earliest index whose largest key >= internal_key.
     uint32_t index = FindFile(vset_->icmp_, files_[level], internal_key);
     if (index < num_files) {
@@ -326,6 +391,8 @@ Status Version::Get(const ReadOptions& options, const LookupKey& k,
                     std::string* value, GetStats* stats) {
   stats->seek_file = nullptr;
   stats->seek_file_level = -1;
+  stats->probed_levels = 0;
+  stats->read_cost_exceeded = false;
 
   struct State {
     Saver saver;
@@ -348,9 +415,20 @@ Status Version::Get(const ReadOptions& options, const LookupKey& k,
         state->stats->seek_file = state->last_file_read;
         state->stats->seek_file_level = state->last_file_read_level;
       }
+      if (state->last_file_read != nullptr &&
+          state->vset->options_->read_aware_compaction &&
+          state->vset->ChargeRead(state->last_file_read_level,
+                                  state->last_file_read)) {
+        state->stats->read_cost_exceeded = true;
+      }
 
       state->last_file_read = f;
       state->last_file_read_level = level;
+      state->stats->probed_levels |= 1u << level;
+      if (state->vset->options_->relayout_bytes_per_second > 0 ||
+          state->vset->options_->key_range_layout) {
+        f->reads.fetch_add(1, std::memory_order_relaxed);
+      }
 
       state->s = state->vset->table_cache_->Get(*state->options, f->number,
                                                 f->file_size, state->ikey,
@@ -401,6 +479,12 @@ Status Version::Get(const ReadOptions& options, const LookupKey& k,
 }
 
 bool Version::UpdateStats(const GetStats& stats) {
+  bool result = false;
+  if (stats.read_cost_exceeded && this == vset_->current_) {
+    // Rescore with the reads that cost more than a compaction now
+    vset_->Finalize(this);
+    result = true;
+  }
   FileMetaData* f = stats.seek_file;
   if (f != nullptr) {
     f->allowed_seeks--;
@@ -410,7 +494,7 @@ bool Version::UpdateStats(const GetStats& stats) {
       return true;
     }
   }
-  return false;
+  return result;
 }
 
 bool Version::RecordReadSample(Slice internal_key) {
@@ -446,6 +530,9 @@ bool Version::RecordReadSample(Slice internal_key) {
   // finding such files?
   if (state.matches >= 2) {
     // 1MB cost is about 1 seek (see comment in Builder::Apply).
+    state.stats.read_cost_exceeded =
+        vset_->options_->read_aware_compaction &&
+        vset_->ChargeRead(state.stats.seek_file_level, state.stats.seek_file);
     return UpdateStats(state.stats);
   }
   return false;
@@ -464,8 +551,9 @@ void Version::Unref() {
 
 bool Version::OverlapInLevel(int level, const Slice* smallest_user_key,
                              const Slice* largest_user_key) {
-  return SomeFileOverlapsRange(vset_->icmp_, (level > 0), files_[level],
-                               smallest_user_key, largest_user_key);
+  return SomeFileOverlapsRange(vset_->icmp_, !overlapping_[level],
+                               files_[level], smallest_user_key,
+                               largest_user_key);
 }
 
 int Version::PickLevelForMemTableOutput(const Slice& smallest_user_key,
@@ -478,7 +566,11 @@ int Version::PickLevelForMemTableOutput(const Slice& smallest_user_key,
     InternalKey limit(largest_user_key, 0, static_cast<ValueType>(0));
     std::vector<FileMetaData*> overlaps;
     while (level < config::kMaxMemCompactLevel) {
-      if (OverlapInLevel(level + 1, &smallest_user_key, &largest_user_key)) {
+      // The runs of a tiered level are searched by file number, and a run
+      // compacted from the level above later would hold older data under
+      // newer numbers
+      if (vset_->Tiered(level + 1) ||
+          OverlapInLevel(level + 1, &smallest_user_key, &largest_user_key)) {
         break;
       }
       if (level + 2 < config::kNumLevels) {
@@ -520,9 +612,10 @@ void Version::GetOverlappingInputs(int level, const InternalKey* begin,
       // "f" is completely after specified range; skip it
     } else {
       inputs->push_back(f);
-      if (level == 0) {
-        // Level-0 files may overlap each other.  So check if the newly
-        // added file has expanded the range.  If so, restart search.
+      if (overlapping_[level]) {
+        // Level-0 files may overlap each other, like the runs of tiered
+        // levels.  So check if the newly added file has expanded the
+        // range.  If so, restart search.
         if (begin != nullptr && user_cmp->Compare(file_start, user_begin) < 0) {
           user_begin = file_start;
           inputs->clear();
@@ -697,21 +790,18 @@ class VersionSet::Builder {
         MaybeAddFile(v, level, *base_iter);
       }
 
-#ifndef NDEBUG
-      // Make sure there is no overlap in levels > 0
+      // Levels > 0 only overlap if they hold several sorted runs after
+      // tiered compactions
       if (level > 0) {
         for (uint32_t i = 1; i < v->files_[level].size(); i++) {
           const InternalKey& prev_end = v->files_[level][i - 1]->largest;
           const InternalKey& this_begin = v->files_[level][i]->smallest;
           if (vset_->icmp_.Compare(prev_end, this_begin) >= 0) {
-            std::fprintf(stderr, "overlapping ranges in same level %s vs. %s\n",
-                         prev_end.DebugString().c_str(),
-                         this_begin.DebugString().c_str());
-            std::abort();
+            v->overlapping_[level] = true;
+            break;
           }
         }
       }
-#endif
     }
   }
 
@@ -720,11 +810,6 @@ class VersionSet::Builder {
       // File is deleted: do nothing
     } else {
       std::vector<FileMetaData*>* files = &v->files_[level];
-      if (level > 0 && !files->empty()) {
-        // Must not overlap
-        assert(vset_->icmp_.Compare((*files)[files->size() - 1]->largest,
-                                    f->smallest) < 0);
-      }
       f->refs++;
       files->push_back(f);
     }
@@ -747,7 +832,12 @@ VersionSet::VersionSet(const std::string& dbname, const Options* options,
       descriptor_file_(nullptr),
       descriptor_log_(nullptr),
       dummy_versions_(this),
-      current_(nullptr) {
+      current_(nullptr),
+      leveling_start_(1) {
+  for (int level = 0; level < config::kNumLevels; level++) {
+    fanout_[level] = static_cast<int>(options_->size_factor);
+    read_weights_[level].store(1.0, std::memory_order_relaxed);
+  }
   AppendVersion(new Version(this));
 }
 
@@ -788,7 +878,7 @@ Status VersionSet::LogAndApply(VersionEdit* edit, port::Mutex* mu) {
   }
 
   edit->SetNextFile(next_file_number_);
-  edit->SetLastSequence(last_sequence_);
+  edit->SetLastSequence(LastSequence());
 
   Version* v = new Version(this);
   {
@@ -1024,10 +1114,96 @@ void VersionSet::MarkFileNumberUsed(uint64_t number) {
   }
 }
 
+void VersionSet::SetFanouts(const std::vector<int>& fanouts) {
+  for (size_t level = 2; level < fanouts.size() && level < config::kNumLevels;
+       level++) {
+    fanout_[level] = std::max(fanouts[level], 2);
+  }
+  // Rescore the current version against the new targets
+  Finalize(current_);
+}
+
+uint32_t VersionSet::ReadAllowance(int level, const FileMetaData* f) const {
+  // Same budget as allowed_seeks (see comment in Builder::Apply), scaled by
+  // the cost of a read in the format of the level
+  const double reads = std::max<double>(f->file_size / 16384U, 100);
+  const double weight = read_weights_[level].load(std::memory_order_relaxed);
+  return std::max(static_cast<uint32_t>(std::ceil(reads / weight)), 1u);
+}
+
+double VersionSet::TombstoneScore(const FileMetaData* f,
+                                  double entry_bytes) const {
+  if (f->num_entries == 0) {
+    return 0;
+  }
+  double score = 0;
+  if (options_->tombstone_compaction_ratio > 0) {
+    const double ratio = static_cast<double>(f->num_deletions) / f->num_entries;
+    score = ratio / options_->tombstone_compaction_ratio;
+  }
+  if (options_->tombstone_compaction_bytes > 0) {
+    if (entry_bytes == 0) {
+      // Nothing known below, take the entries of the table itself
+      entry_bytes = static_cast<double>(f->file_size) / f->num_entries;
+    }
+    score = std::max(score, f->num_deletions * entry_bytes /
+                                options_->tombstone_compaction_bytes);
+  }
+  return score;
+}
+
+bool VersionSet::ChargeRead(int level, FileMetaData* f) {
+  const uint32_t reads =
+      f->wasted_reads.fetch_add(1, std::memory_order_relaxed) + 1;
+  return reads == ReadAllowance(level, f);
+}
+
+// Deepest level holding tables, at least level-1
+static int LastLevel(const Version* v) {
+  int last = config::kNumLevels - 1;
+  while (last > 1 && v->NumFiles(last) == 0) {
+    last--;
+  }
+  return last;
+}
+
+void VersionSet::SetLevelingStart(int level) {
+  leveling_start_ = std::max(1, std::min(level, LastLevel(current_)));
+}
+
+void VersionSet::LevelMaxBytes(const Version* v, double* max_bytes) const {
+  for (int level = 0; level < config::kNumLevels; level++) {
+    max_bytes[level] = MaxBytesForLevel(options_, level);
+  }
+  if (!options_->dynamic_level_bytes) {
+    return;
+  }
+
+  // The deepest level holding tables grows up to the product of the
+  // fanouts, then spills into the next level.  The levels above it are
+  // sized from its actual size, never below the size of level-1.
+  const int last = LastLevel(v);
+  const double base = max_bytes[1];
+  double bytes = base;
+  for (int level = 2; level <= last; level++) {
+    bytes *= fanout_[level];
+    max_bytes[level] = bytes;
+  }
+  bytes = static_cast<double>(TotalFileSize(v->files_[last]));
+  for (int level = last - 1; level >= 1; level--) {
+    bytes /= fanout_[level + 1];
+    max_bytes[level] = std::max(bytes, base);
+  }
+}
+
 void VersionSet::Finalize(Version* v) {
   // Precomputed best level for next compaction
   int best_level = -1;
   double best_score = -1;
+  double max_bytes[config::kNumLevels];
+  LevelMaxBytes(v, max_bytes);
+  const bool tombstone_compaction = options_->tombstone_compaction_ratio > 0 ||
+                                    options_->tombstone_compaction_bytes > 0;
 
   for (int level = 0; level < config::kNumLevels - 1; level++) {
     double score;
@@ -1048,10 +1224,36 @@ void VersionSet::Finalize(Version* v) {
     } else {
       // Compute the ratio of current size to size limit.
       const uint64_t level_bytes = TotalFileSize(v->files_[level]);
-      score =
-          static_cast<double>(level_bytes) / MaxBytesForLevel(options_, level);
+      score = static_cast<double>(level_bytes) / max_bytes[level];
     }
 
+    // Reads the tables of the level cost in vain, and the entries their
+    // deletion markers keep around, against the cost of compacting them.
+    // The costliest table is compacted first.
+    v->costly_files_[level] = nullptr;
+    if (options_->read_aware_compaction || tombstone_compaction) {
+      const double entry_bytes =
+          tombstone_compaction ? AverageEntryBytes(v->files_[level + 1]) : 0;
+      double costliest = 0;
+      for (FileMetaData* f : v->files_[level]) {
+        double file_score = TombstoneScore(f, entry_bytes);
+        if (options_->read_aware_compaction) {
+          file_score = std::max(
+              file_score,
+              static_cast<double>(
+                  f->wasted_reads.load(std::memory_order_relaxed)) /
+                  ReadAllowance(level, f));
+        }
+        if (file_score >= 1 && file_score > costliest &&
+            !f->being_compacted) {
+          costliest = file_score;
+          v->costly_files_[level] = f;
+        }
+      }
+      score = std::max(score, costliest);
+    }
+
+    v->level_scores_[level] = score;
     if (score > best_score) {
       best_level = level;
       best_score = score;
@@ -1083,7 +1285,8 @@ Status VersionSet::WriteSnapshot(log::Writer* log) {
     const std::vector<FileMetaData*>& files = current_->files_[level];
     for (size_t i = 0; i < files.size(); i++) {
       const FileMetaData* f = files[i];
-      edit.AddFile(level, f->number, f->file_size, f->smallest, f->largest);
+      edit.AddFile(level, f->number, f->file_size, f->smallest, f->largest,
+                   f->num_entries, f->num_deletions);
     }
   }
 
@@ -1217,15 +1420,16 @@ Iterator* VersionSet::MakeInputIterator(Compaction* c) {
   options.verify_checksums = options_->paranoid_checks;
   options.fill_cache = false;
 
-  // Level-0 files have to be merged together.  For other levels,
-  // we will make a concatenating iterator per level.
+  // Level-0 files have to be merged together, like the runs of tiered
+  // levels.  For other levels, we will make a concatenating iterator per
+  // level.
   // TODO(opt): use concatenating iterator for level-0 if there is no overlap
-  const int space = (c->level() == 0 ? c->inputs_[0].size() + 1 : 2);
+  const int space = c->inputs_[0].size() + c->inputs_[1].size();
   Iterator** list = new Iterator*[space];
   int num = 0;
   for (int which = 0; which < 2; which++) {
     if (!c->inputs_[which].empty()) {
-      if (c->level() + which == 0) {
+      if (c->input_version_->overlapping_[c->level() + which]) {
         const std::vector<FileMetaData*>& files = c->inputs_[which];
         for (size_t i = 0; i < files.size(); i++) {
           list[num++] = table_cache_->NewIterator(options, files[i]->number,
@@ -1245,57 +1449,114 @@ Iterator* VersionSet::MakeInputIterator(Compaction* c) {
   return result;
 }
 
-Compaction* VersionSet::PickCompaction() {
-  Compaction* c;
-  int level;
+static bool AnyBeingCompacted(const std::vector<FileMetaData*>& files) {
+  for (size_t i = 0; i < files.size(); i++) {
+    if (files[i]->being_compacted) {
+      return true;
+    }
+  }
+  return false;
+}
 
+Compaction* VersionSet::PickCompaction() {
   // We prefer compactions triggered by too much data in a level over
-  // the compactions triggered by seeks.
-  const bool size_compaction = (current_->compaction_score_ >= 1);
-  const bool seek_compaction = (current_->file_to_compact_ != nullptr);
-  if (size_compaction) {
-    level = current_->compaction_level_;
-    assert(level >= 0);
-    assert(level + 1 < config::kNumLevels);
-    c = new Compaction(options_, level);
-
-    // Pick the first file that comes after compact_pointer_[level]
-    for (size_t i = 0; i < current_->files_[level].size(); i++) {
-      FileMetaData* f = current_->files_[level][i];
-      if (compact_pointer_[level].empty() ||
-          icmp_.Compare(f->largest.Encode(), compact_pointer_[level]) > 0) {
-        c->inputs_[0].push_back(f);
-        break;
-      }
+  // the compactions triggered by seeks.  Levels are tried from the highest
+  // score down, since the inputs of the best one may be busy.
+  std::vector<int> levels;
+  for (int level = 0; level < config::kNumLevels - 1; level++) {
+    if (current_->level_scores_[level] >= 1) {
+      levels.push_back(level);
     }
-    if (c->inputs_[0].empty()) {
-      // Wrap-around to the beginning of the key space
-      c->inputs_[0].push_back(current_->files_[level][0]);
+  }
+  std::stable_sort(levels.begin(), levels.end(), [this](int a, int b) {
+    return current_->level_scores_[a] > current_->level_scores_[b];
+  });
+  for (int level : levels) {
+    Compaction* c = PickLevelCompaction(level);
+    if (c != nullptr) {
+      return c;
     }
-  } else if (seek_compaction) {
-    level = current_->file_to_compact_level_;
-    c = new Compaction(options_, level);
-    c->inputs_[0].push_back(current_->file_to_compact_);
-  } else {
+  }
+
+  FileMetaData* f = current_->file_to_compact_;
+  if (f == nullptr || f->being_compacted) {
+    return nullptr;
+  }
+  return PickCompactionFrom(current_->file_to_compact_level_, f);
+}
+
+Compaction* VersionSet::PickLevelCompaction(int level) {
+  assert(level >= 0);
+  assert(level + 1 < config::kNumLevels);
+  const std::vector<FileMetaData*>& files = current_->files_[level];
+
+  // Pick the file costing readers the most, or else the first free file
+  // that comes after compact_pointer_[level]
+  FileMetaData* picked = current_->costly_files_[level];
+  if (picked != nullptr && picked->being_compacted) {
+    picked = nullptr;
+  }
+  for (size_t i = 0; i < files.size() && picked == nullptr; i++) {
+    FileMetaData* f = files[i];
+    if (!f->being_compacted &&
+        (compact_pointer_[level].empty() ||
+         icmp_.Compare(f->largest.Encode(), compact_pointer_[level]) > 0)) {
+      picked = f;
+      break;
+    }
+  }
+  if (picked == nullptr) {
+    // Wrap-around to the beginning of the key space
+    for (size_t i = 0; i < files.size() && picked == nullptr; i++) {
+      if (!files[i]->being_compacted) {
+        picked = files[i];
+      }
+    }
+  }
+  if (picked == nullptr) {
     return nullptr;
   }
 
+  return PickCompactionFrom(level, picked);
+}
+
+Compaction* VersionSet::PickCompactionFrom(int level, FileMetaData* f) {
+  // Level-0 files overlap each other, so only one compaction may read them.
+  // The same goes for tiered levels, whose runs are merged all at once.
+  if ((level == 0 || Tiered(level)) &&
+      AnyBeingCompacted(current_->files_[level])) {
+    return nullptr;
+  }
+
+  Compaction* c = new Compaction(options_, level);
+  c->inputs_[0].push_back(f);
   c->input_version_ = current_;
   c->input_version_->Ref();
 
-  // Files in level 0 may overlap each other, so pick up all overlapping ones
-  if (level == 0) {
+  if (Tiered(level)) {
+    c->inputs_[0] = current_->files_[level];
+  } else if (current_->overlapping_[level]) {
+    // Files in level 0 may overlap each other, so pick up all overlapping
+    // ones.  So may the runs left in a level that was tiered before.
     InternalKey smallest, largest;
     GetRange(c->inputs_[0], &smallest, &largest);
     // Note that the next call will discard the file we placed in
     // c->inputs_[0] earlier and replace it with an overlapping set
     // which will include the picked file.
-    current_->GetOverlappingInputs(0, &smallest, &largest, &c->inputs_[0]);
+    current_->GetOverlappingInputs(level, &smallest, &largest,
+                                   &c->inputs_[0]);
     assert(!c->inputs_[0].empty());
   }
 
+  // Give up if the expanded inputs reach into a running compaction, and
+  // leave the compaction pointer where it was
+  const std::string compact_pointer = compact_pointer_[level];
   SetupOtherInputs(c);
-
+  if (AnyBeingCompacted(c->inputs_[0]) || AnyBeingCompacted(c->inputs_[1])) {
+    compact_pointer_[level] = compact_pointer;
+    delete c;
+    return nullptr;
+  }
   return c;
 }
 
@@ -1385,8 +1646,11 @@ void VersionSet::SetupOtherInputs(Compaction* c) {
   AddBoundaryInputs(icmp_, current_->files_[level], &c->inputs_[0]);
   GetRange(c->inputs_[0], &smallest, &largest);
 
-  current_->GetOverlappingInputs(level + 1, &smallest, &largest,
-                                 &c->inputs_[1]);
+  // The output is a new run of a tiered level, it leaves the others alone
+  if (!Tiered(level + 1)) {
+    current_->GetOverlappingInputs(level + 1, &smallest, &largest,
+                                   &c->inputs_[1]);
+  }
 
   // Get entire range covered by compaction
   InternalKey all_start, all_limit;
@@ -1450,8 +1714,8 @@ Compaction* VersionSet::CompactRange(int level, const InternalKey* begin,
   // Avoid compacting too much in one shot in case the range is large.
   // But we cannot do this for level-0 since level-0 files can overlap
   // and we must not pick one file and drop another older file if the
-  // two files overlap.
-  if (level > 0) {
+  // two files overlap.  Neither for levels holding several runs.
+  if (!current_->overlapping_[level]) {
     const uint64_t limit = MaxFileSizeForLevel(options_, level);
     uint64_t total = 0;
     for (size_t i = 0; i < inputs.size(); i++) {
@@ -1472,18 +1736,18 @@ Compaction* VersionSet::CompactRange(int level, const InternalKey* begin,
   return c;
 }
 
-Compaction::Compaction(const Options* options, int level)
-    : level_(level),
-      max_output_file_size_(MaxFileSizeForLevel(options, level)),
-      input_version_(nullptr),
-      grandparent_index_(0),
-      seen_key_(false),
-      overlapped_bytes_(0) {
+CompactionCursor::CompactionCursor()
+    : grandparent_index(0), seen_key(false), overlapped_bytes(0) {
   for (int i = 0; i < config::kNumLevels; i++) {
-    level_ptrs_[i] = 0;
+    level_ptrs[i] = 0;
   }
 }
 
+Compaction::Compaction(const Options* options, int level)
+    : level_(level),
+      max_output_file_size_(MaxFileSizeForLevel(options, level)),
+      input_version_(nullptr) {}
+
 Compaction::~Compaction() {
   if (input_version_ != nullptr) {
     input_version_->Unref();
@@ -1495,7 +1759,14 @@ bool Compaction::IsTrivialMove() const {
   // Avoid a move if there is lots of overlapping grandparent data.
   // Otherwise, the move could create a parent file that will require
   // a very expensive merge later on.
+  // Runs of a tiered level are ordered by file number, a moved file would
+  // be older than the runs it is newer than.  A file picked for its
+  // deletion markers is rewritten to drop them.
   return (num_input_files(0) == 1 && num_input_files(1) == 0 &&
+          !vset->Tiered(level_ + 1) &&
+          vset->TombstoneScore(
+              inputs_[0][0],
+              AverageEntryBytes(input_version_->files_[level_ + 1])) < 1 &&
           TotalFileSize(grandparents_) <=
               MaxGrandParentOverlapBytes(vset->options_));
 }
@@ -1508,13 +1779,26 @@ void Compaction::AddInputDeletions(VersionEdit* edit) {
   }
 }
 
-bool Compaction::IsBaseLevelForKey(const Slice& user_key) {
+bool Compaction::IsBaseLevelForKey(const Slice& user_key,
+                                   CompactionCursor* cursor) {
   // Maybe use binary search to find right entry instead of linear search?
   const Comparator* user_cmp = input_version_->vset_->icmp_.user_comparator();
-  for (int lvl = level_ + 2; lvl < config::kNumLevels; lvl++) {
+  // A compaction into a tiered level does not read its other runs
+  const int first = inputs_[1].empty() ? level_ + 1 : level_ + 2;
+  for (int lvl = first; lvl < config::kNumLevels; lvl++) {
     const std::vector<FileMetaData*>& files = input_version_->files_[lvl];
-    while (level_ptrs_[lvl] < files.size()) {
-      FileMetaData* f = files[level_ptrs_[lvl]];
+    if (input_version_->overlapping_[lvl]) {
+      // Runs overlap each other, the cursor cannot skip files
+      for (const FileMetaData* f : files) {
+        if (user_cmp->Compare(user_key, f->smallest.user_key()) >= 0 &&
+            user_cmp->Compare(user_key, f->largest.user_key()) <= 0) {
+          return false;
+        }
+      }
+      continue;
+    }
+    while (cursor->level_ptrs[lvl] < files.size()) {
+      FileMetaData* f = files[cursor->level_ptrs[lvl]];
       if (user_cmp->Compare(user_key, f->largest.user_key()) <= 0) {
         // We've advanced far enough
         if (user_cmp->Compare(user_key, f->smallest.user_key()) >= 0) {
@@ -1523,36 +1807,68 @@ bool Compaction::IsBaseLevelForKey(const Slice& user_key) {
         }
         break;
       }
-      level_ptrs_[lvl]++;
+      cursor->level_ptrs[lvl]++;
     }
   }
   return true;
 }
 
-bool Compaction::ShouldStopBefore(const Slice& internal_key) {
+bool Compaction::ShouldStopBefore(const Slice& internal_key,
+                                  CompactionCursor* cursor) {
   const VersionSet* vset = input_version_->vset_;
   // Scan to find earliest grandparent file that contains key.
   const InternalKeyComparator* icmp = &vset->icmp_;
-  while (grandparent_index_ < grandparents_.size() &&
-         icmp->Compare(internal_key,
-                       grandparents_[grandparent_index_]->largest.Encode()) >
-             0) {
-    if (seen_key_) {
-      overlapped_bytes_ += grandparents_[grandparent_index_]->file_size;
+  while (cursor->grandparent_index < grandparents_.size() &&
+         icmp->Compare(
+             internal_key,
+             grandparents_[cursor->grandparent_index]->largest.Encode()) > 0) {
+    if (cursor->seen_key) {
+      cursor->overlapped_bytes +=
+          grandparents_[cursor->grandparent_index]->file_size;
     }
-    grandparent_index_++;
+    cursor->grandparent_index++;
   }
-  seen_key_ = true;
+  cursor->seen_key = true;
 
-  if (overlapped_bytes_ > MaxGrandParentOverlapBytes(vset->options_)) {
+  if (cursor->overlapped_bytes > MaxGrandParentOverlapBytes(vset->options_)) {
     // Too much overlap for current output; start new output
-    overlapped_bytes_ = 0;
+    cursor->overlapped_bytes = 0;
     return true;
   } else {
     return false;
   }
 }
 
+void Compaction::MarkBeingCompacted(bool being_compacted) {
+  for (int which = 0; which < 2; which++) {
+    for (size_t i = 0; i < inputs_[which].size(); i++) {
+      inputs_[which][i]->being_compacted = being_compacted;
+    }
+  }
+}
+
+std::vector<std::string> Compaction::SplitKeys(int max_ranges) const {
+  // Every level+1 file but the first starts a candidate range
+  const Comparator* user_cmp = input_version_->vset_->icmp_.user_comparator();
+  std::vector<std::string> candidates;
+  for (size_t i = 1; i < inputs_[1].size(); i++) {
+    Slice start = inputs_[1][i]->smallest.user_key();
+    if (candidates.empty() ||
+        user_cmp->Compare(start, Slice(candidates.back())) > 0) {
+      candidates.push_back(start.ToString());
+    }
+  }
+
+  // Spread the splits evenly over the candidates
+  std::vector<std::string> result;
+  const size_t ranges = std::min<size_t>(std::max(max_ranges, 1),
+                                         candidates.size() + 1);
+  for (size_t i = 1; i < ranges; i++) {
+    result.push_back(candidates[i * (candidates.size() + 1) / ranges - 1]);
+  }
+  return result;
+}
+
 void Compaction::ReleaseInputs() {
   if (input_version_ != nullptr) {
     input_version_->Unref();
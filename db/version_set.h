@@ -15,6 +15,8 @@
 #ifndef STORAGE_LEVELDB_DB_VERSION_SET_H_
 #define STORAGE_LEVELDB_DB_VERSION_SET_H_
 
+#include <algorithm>
+#include <atomic>
 #include <map>
 #include <set>
 #include <vector>
@@ -65,12 +67,17 @@ class Version {
   struct GetStats {
     FileMetaData* seek_file;
     int seek_file_level;
+    uint32_t probed_levels;  // Bit i is set if a file at level i was read
+    // A file read in vain now costs readers more than its compaction
+    bool read_cost_exceeded;
   };
 
   // Append to *iters a sequence of iterators that will
-  // yield the contents of this Version when merged together.
+  // yield the contents of this Version when merged together.  Returns
+  // true if a new compaction may need to be triggered.
   // REQUIRES: This version has been saved (see VersionSet::SaveTo)
-  void AddIterators(const ReadOptions&, std::vector<Iterator*>* iters);
+  // REQUIRES: lock is held
+  bool AddIterators(const ReadOptions&, std::vector<Iterator*>* iters);
 
   Status Get(const ReadOptions&, const LookupKey& key, std::string* val,
              GetStats* stats);
@@ -111,6 +118,16 @@ class Version {
 
   int NumFiles(int level) const { return files_[level].size(); }
 
+  // Return the files at the specified level.
+  const std::vector<FileMetaData*>& LevelFiles(int level) const {
+    return files_[level];
+  }
+
+  // Whether the files of the level may overlap each other, so they are
+  // searched from newest to oldest.  True for level-0, and for the levels
+  // holding several sorted runs after tiered compactions.
+  bool Overlapping(int level) const { return overlapping_[level]; }
+
   // Return a human readable string that describes this version's contents.
   std::string DebugString() const;
 
@@ -128,7 +145,13 @@ class Version {
         file_to_compact_(nullptr),
         file_to_compact_level_(-1),
         compaction_score_(-1),
-        compaction_level_(-1) {}
+        compaction_level_(-1) {
+    for (int level = 0; level < config::kNumLevels; level++) {
+      level_scores_[level] = -1;
+      costly_files_[level] = nullptr;
+      overlapping_[level] = (level == 0);
+    }
+  }
 
   Version(const Version&) = delete;
   Version& operator=(const Version&) = delete;
@@ -152,6 +175,8 @@ class Version {
 
   // List of files per level
   std::vector<FileMetaData*> files_[config::kNumLevels];
+  // Set by VersionSet::Builder::SaveTo()
+  bool overlapping_[config::kNumLevels];
 
   // Next file to compact based on seek stats.
   FileMetaData* file_to_compact_;
@@ -162,6 +187,14 @@ class Version {
   // are initialized by Finalize().
   double compaction_score_;
   int compaction_level_;
+
+  // Compaction score of every level, so a level other than compaction_level_
+  // can be picked while compaction_level_ is being compacted
+  double level_scores_[config::kNumLevels];
+
+  // File of each level whose wasted reads or deletion markers cost the
+  // most, if they outweigh the cost of compacting it.  Set by Finalize().
+  FileMetaData* costly_files_[config::kNumLevels];
 };
 
 class VersionSet {
@@ -208,13 +241,42 @@ class VersionSet {
   // Return the combined file size of all files at the specified level.
   int64_t NumLevelBytes(int level) const;
 
-  // Return the last sequence number.
-  uint64_t LastSequence() const { return last_sequence_; }
+  // Levels 1 to level-1 use tiering: a compaction merges all the sorted
+  // runs of such a level at once, and adds the result as a new run to the
+  // next level if that level is tiered too.  Levels from "level" down use
+  // leveling, where levels that were tiered before keep their runs until
+  // their next compactions.  The deepest level holding tables always uses
+  // leveling, as nothing would merge its runs, so "level" is clamped to it.
+  // Default: 1, only leveling.
+  // REQUIRES: DB mutex held
+  void SetLevelingStart(int level);
+  int LevelingStart() const { return leveling_start_; }
+
+  // Ratio of the target size of each level to that of the level above it,
+  // used with Options::dynamic_level_bytes.  fanouts[i] is the ratio of
+  // level i to level i-1, the entries of level-0 and level-1 are ignored.
+  // Default: Options::size_factor for every level.
+  // REQUIRES: DB mutex held
+  void SetFanouts(const std::vector<int>& fanouts);
+  int Fanout(int level) const { return fanout_[level]; }
+
+  // Relative cost of a read in vain of a table at "level", with
+  // Options::read_aware_compaction.  Default: 1.
+  // REQUIRES: DB mutex held
+  void SetReadWeight(int level, double weight) {
+    read_weights_[level].store(weight, std::memory_order_relaxed);
+  }
+
+  // Return the last sequence number. May be called without holding the
+  // mutex, e.g. by DBImpl::Get().
+  uint64_t LastSequence() const {
+    return last_sequence_.load(std::memory_order_acquire);
+  }
 
   // Set the last sequence number to s.
   void SetLastSequence(uint64_t s) {
-    assert(s >= last_sequence_);
-    last_sequence_ = s;
+    assert(s >= LastSequence());
+    last_sequence_.store(s, std::memory_order_release);
   }
 
   // Mark the specified file number as used.
@@ -279,6 +341,24 @@ class VersionSet {
 
   void Finalize(Version* v);
 
+  // Compute the size limit of each level of "v"
+  void LevelMaxBytes(const Version* v, double* max_bytes) const;
+
+  // Number of wasted reads of "f" at "level" that cost as much as
+  // compacting it
+  uint32_t ReadAllowance(int level, const FileMetaData* f) const;
+
+  // How far the deletion markers of "f" are past the thresholds of
+  // Options::tombstone_compaction_ratio and
+  // Options::tombstone_compaction_bytes, if "entry_bytes" is the average
+  // entry size of the level below.  At least 1 once "f" should be compacted.
+  double TombstoneScore(const FileMetaData* f, double entry_bytes) const;
+
+  // Count a read "f" at "level" made more expensive.  Returns true once
+  // the reads it cost outweigh the cost of compacting it.  May be called
+  // without holding the mutex.
+  bool ChargeRead(int level, FileMetaData* f);
+
   void GetRange(const std::vector<FileMetaData*>& inputs, InternalKey* smallest,
                 InternalKey* largest);
 
@@ -286,8 +366,19 @@ class VersionSet {
                  const std::vector<FileMetaData*>& inputs2,
                  InternalKey* smallest, InternalKey* largest);
 
+  // Is "level" below level-0 and tiered?
+  bool Tiered(int level) const { return level > 0 && level < leveling_start_; }
+
   void SetupOtherInputs(Compaction* c);
 
+  // Pick a size compaction at "level" that does not overlap a running
+  // compaction, or return nullptr
+  Compaction* PickLevelCompaction(int level);
+
+  // Set up a compaction of "f" at "level" and the files it overlaps, or
+  // return nullptr if any of them is being compacted
+  Compaction* PickCompactionFrom(int level, FileMetaData* f);
+
   // Save current contents to *log
   Status WriteSnapshot(log::Writer* log);
 
@@ -300,7 +391,7 @@ class VersionSet {
   const InternalKeyComparator icmp_;
   uint64_t next_file_number_;
   uint64_t manifest_file_number_;
-  uint64_t last_sequence_;
+  std::atomic<uint64_t> last_sequence_;
   uint64_t log_number_;
   uint64_t prev_log_number_;  // 0 or backing store for memtable being compacted
 
@@ -313,6 +404,29 @@ class VersionSet {
   // Per-level key at which the next compaction at that level should start.
   // Either an empty string, or a valid InternalKey.
   std::string compact_pointer_[config::kNumLevels];
+
+  int leveling_start_;
+  int fanout_[config::kNumLevels];
+  // Read lock-free by Version::ChargeRead()
+  std::atomic<double> read_weights_[config::kNumLevels];
+};
+
+// Position of a walk over the compaction input in key order, used by
+// Compaction::ShouldStopBefore() and Compaction::IsBaseLevelForKey().
+// Subcompactions walk disjoint key ranges concurrently, each with its own.
+struct CompactionCursor {
+  CompactionCursor();
+
+  size_t grandparent_index;  // Index in grandparents_
+  bool seen_key;             // Some output key has been seen
+  int64_t overlapped_bytes;  // Bytes of overlap between current output
+                             // and grandparent files
+
+  // level_ptrs holds indices into input_version_->levels_: our state
+  // is that we are positioned at one of the file ranges for each
+  // higher level than the ones involved in this compaction (i.e. for
+  // all L >= level_ + 2).
+  size_t level_ptrs[config::kNumLevels];
 };
 
 // A Compaction encapsulates information about a compaction.
@@ -347,11 +461,26 @@ class Compaction {
   // Returns true if the information we have available guarantees that
   // the compaction is producing data in "level+1" for which no data exists
   // in levels greater than "level+1".
-  bool IsBaseLevelForKey(const Slice& user_key);
+  bool IsBaseLevelForKey(const Slice& user_key) {
+    return IsBaseLevelForKey(user_key, &cursor_);
+  }
+  bool IsBaseLevelForKey(const Slice& user_key, CompactionCursor* cursor);
 
   // Returns true iff we should stop building the current output
   // before processing "internal_key".
-  bool ShouldStopBefore(const Slice& internal_key);
+  bool ShouldStopBefore(const Slice& internal_key) {
+    return ShouldStopBefore(internal_key, &cursor_);
+  }
+  bool ShouldStopBefore(const Slice& internal_key, CompactionCursor* cursor);
+
+  // Flag the input files as inputs of a running compaction, so that
+  // concurrent compactions do not pick them.
+  // REQUIRES: DB mutex held
+  void MarkBeingCompacted(bool being_compacted);
+
+  // Return the user keys splitting the input into at most "max_ranges" key
+  // ranges of whole level+1 files, in increasing order.
+  std::vector<std::string> SplitKeys(int max_ranges) const;
 
   // Release the input version for the compaction, once the compaction
   // is successful.
@@ -374,18 +503,9 @@ class Compaction {
   // State used to check for number of overlapping grandparent files
   // (parent == level_ + 1, grandparent == level_ + 2)
   std::vector<FileMetaData*> grandparents_;
-  size_t grandparent_index_;  // Index in grandparent_starts_
-  bool seen_key_;             // Some output key has been seen
-  int64_t overlapped_bytes_;  // Bytes of overlap between current output
-                              // and grandparent files
 
-  // State for implementing IsBaseLevelForKey
-
-  // level_ptrs_ holds indices into input_version_->levels_: our state
-  // is that we are positioned at one of the file ranges for each
-  // higher level than the ones involved in this compaction (i.e. for
-  // all L >= level_ + 2).
-  size_t level_ptrs_[config::kNumLevels];
+  // Cursor of the walk over the whole input
+  CompactionCursor cursor_;
 };
 
 }  // namespace leveldb
@@ -31,6 +31,17 @@ class LEVELDB_EXPORT Cache;
 // of Cache uses a least-recently-used eviction policy.
 LEVELDB_EXPORT Cache* NewLRUCache(size_t capacity);
 
+// Create a new cache with a fixed size capacity.  This implementation
+// evicts with the CLOCK algorithm, so lookups take no lock, and admits a
+// new entry into a full cache only if it is accessed more often than the
+// entry it replaces, so one-time scans do not flush hot blocks.  The cache
+// has room for about twice the entries of estimated_entry_charge that fit
+// in its capacity, and evicts to make room beyond that.
+// Unlike NewLRUCache(), an Insert() into a full cache may return a handle
+// that is not kept in the cache.
+LEVELDB_EXPORT Cache* NewClockCache(size_t capacity,
+                                    size_t estimated_entry_charge = 4096);
+
 class LEVELDB_EXPORT Cache {
  public:
   Cache() = default;
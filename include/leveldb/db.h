@@ -119,6 +119,17 @@ class LEVELDB_EXPORT DB {
   //     about the internal operation of the DB.
   //  "leveldb.sstables" - returns a multi-line string that describes all
   //     of the sstables that make up the db contents.
+  //  "leveldb.layout" - returns one letter per level, 'V' if new tables of
+  //     the level use vertical blocks and 'H' otherwise.
+  //  "leveldb.merge-policy" - returns one letter per level, 'T' if the level
+  //     is tiered and 'L' if it uses leveling.
+  //  "leveldb.level-fanouts" - returns the ratio of the target size of each
+  //     level from level-2 on to the level above it, separated by spaces, if
+  //     Options::dynamic_level_bytes is set.
+  //  "leveldb.filter-bits-per-key" - returns the bloom filter bits per key
+  //     of the tables written to each level, separated by spaces, if
+  //     Options::filter_memory_budget is positive.  0 means no filter, -1
+  //     that filter_policy is used as is.
   //  "leveldb.approximate-memory-usage" - returns the approximate number of
   //     bytes of memory in use by the DB.
   virtual bool GetProperty(const Slice& property, std::string* value) = 0;
@@ -110,6 +110,20 @@ class LEVELDB_EXPORT Env {
   virtual Status NewAppendableFile(const std::string& fname,
                                    WritableFile** result);
 
+  // Rename the existing file "old_fname" to "fname" and create an object
+  // that writes over it from the start, without truncating it first.  On
+  // success, stores a pointer to the new file in *result and returns OK.
+  // On failure stores nullptr in *result and returns non-OK.
+  //
+  // Used to recycle log files, so syncing them does not have to update
+  // the file size.  The default implementation renames the file and then
+  // calls NewWritableFile(), which truncates it.
+  //
+  // The returned file will only be accessed by one thread at a time.
+  virtual Status ReuseWritableFile(const std::string& fname,
+                                   const std::string& old_fname,
+                                   WritableFile** result);
+
   // Returns true iff the named file exists.
   virtual bool FileExists(const std::string& fname) = 0;
 
@@ -197,6 +211,11 @@ class LEVELDB_EXPORT Env {
   // serialized.
   virtual void Schedule(void (*function)(void* arg), void* arg) = 0;
 
+  // Run functions passed to Schedule() in at least "number" background
+  // threads.  The pool never shrinks.  The default implementation ignores
+  // the request.
+  virtual void SetBackgroundThreads(int number);
+
   // Start a new thread, invoking "function(arg)" within the new thread.
   // When "function(arg)" returns, the thread will be destroyed.
   virtual void StartThread(void (*function)(void* arg), void* arg) = 0;
@@ -287,6 +306,11 @@ class LEVELDB_EXPORT WritableFile {
   virtual Status Close() = 0;
   virtual Status Flush() = 0;
   virtual Status Sync() = 0;
+
+  // Reserve space for about "size" bytes to be appended, without changing
+  // the file size, so later syncs do not have to allocate blocks.  The
+  // default implementation does nothing.
+  virtual Status Preallocate(uint64_t size);
 };
 
 // An interface for writing log messages.
@@ -355,6 +379,10 @@ class LEVELDB_EXPORT EnvWrapper : public Env {
   Status NewAppendableFile(const std::string& f, WritableFile** r) override {
     return target_->NewAppendableFile(f, r);
   }
+  Status ReuseWritableFile(const std::string& f, const std::string& o,
+                           WritableFile** r) override {
+    return target_->ReuseWritableFile(f, o, r);
+  }
   bool FileExists(const std::string& f) override {
     return target_->FileExists(f);
   }
@@ -384,6 +412,9 @@ class LEVELDB_EXPORT EnvWrapper : public Env {
   void Schedule(void (*f)(void*), void* a) override {
     return target_->Schedule(f, a);
   }
+  void SetBackgroundThreads(int number) override {
+    target_->SetBackgroundThreads(number);
+  }
   void StartThread(void (*f)(void*), void* a) override {
     return target_->StartThread(f, a);
   }
@@ -49,6 +49,21 @@ class LEVELDB_EXPORT FilterPolicy {
   // This method may return true or false if the key was not on the
   // list, but it should aim to return false with a high probability.
   virtual bool KeyMayMatch(const Slice& key, const Slice& filter) const = 0;
+
+  // Batch version of KeyMayMatch(). Sets results[i] to whether keys[i] may
+  // be in "filter", for i in [0, n). The default implementation probes the
+  // keys one by one; policies may override it to overlap the memory accesses.
+  virtual void KeysMayMatch(const Slice* keys, int n, const Slice& filter,
+                            bool* results) const;
+
+  // Return a new policy of the same kind with approximately the specified
+  // number of bits per key, or nullptr if this policy cannot size its
+  // filters.  The result must return the same Name(), so that this policy
+  // reads its filters.  The default implementation returns nullptr.
+  //
+  // Options::filter_memory_budget uses this to size the filters of each
+  // level.  Callers must delete the result.
+  virtual const FilterPolicy* NewWithBitsPerKey(int bits_per_key) const;
 };
 
 // Return a new filter policy that uses a bloom filter with approximately
@@ -67,6 +82,28 @@ class LEVELDB_EXPORT FilterPolicy {
 // trailing spaces in keys.
 LEVELDB_EXPORT const FilterPolicy* NewBloomFilterPolicy(int bits_per_key);
 
+// Return a new filter policy that uses a blocked bloom filter with
+// approximately the specified number of bits per key. All probes of a key
+// fall into one 32-byte block, so a lookup costs a single cache miss and is
+// checked with one SIMD test. At 10 bits per key the false positive rate is
+// about 1%, as with NewBloomFilterPolicy().
+//
+// The same caveat on comparators as NewBloomFilterPolicy() applies.
+LEVELDB_EXPORT const FilterPolicy* NewBlockedBloomFilterPolicy(
+    int bits_per_key);
+
+// Return a new filter policy that uses an xor filter with 8-bit fingerprints.
+// It takes ~9.84 bits per key for a false positive rate of ~0.4%, about 30%
+// less space than a bloom filter with the same rate, and a lookup always
+// costs 3 probes. Keys of 4 bytes, as of colsm::intComparator(), are hashed
+// without a pass over their bytes.
+//
+// The fingerprints have a fixed size, so the policy cannot be used with
+// Options::filter_memory_budget.
+//
+// The same caveat on comparators as NewBloomFilterPolicy() applies.
+LEVELDB_EXPORT const FilterPolicy* NewXorFilterPolicy();
+
 }  // namespace leveldb
 
 #endif  // STORAGE_LEVELDB_INCLUDE_FILTER_POLICY_H_
@@ -0,0 +1,61 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+//
+// A database can be configured with a custom LayoutPolicy object.  This
+// object chooses how the tables written to each level are laid out: whether
+// they use vertical or horizontal blocks, and the size, compression and
+// section limit of those blocks.  Tables are read in whatever layout they
+// were written with, so a policy can be changed between opens.
+//
+// Without a policy every level uses vertical blocks, with the block
+// parameters of Options.
+
+#ifndef STORAGE_LEVELDB_INCLUDE_LAYOUT_POLICY_H_
+#define STORAGE_LEVELDB_INCLUDE_LAYOUT_POLICY_H_
+
+#include <cstddef>
+#include <vector>
+
+#include "leveldb/export.h"
+#include "leveldb/options.h"
+
+namespace leveldb {
+
+// The layout of the tables written to a level
+struct LEVELDB_EXPORT LevelLayout {
+  // Use vertical blocks, otherwise horizontal ones
+  bool vertical = true;
+
+  // Same as the fields of Options with the same names
+  size_t block_size = 4 * 1024;
+  CompressionType compression = kSnappyCompression;
+  int section_limit = 256;
+};
+
+class LEVELDB_EXPORT LayoutPolicy {
+ public:
+  virtual ~LayoutPolicy();
+
+  // Return the name of this policy.
+  virtual const char* Name() const = 0;
+
+  // Set the layout of the tables written to "level".  On entry *layout
+  // holds the default layout: vertical blocks with the block parameters of
+  // Options.  Implementations change the fields they care about.
+  virtual void GetLayout(int level, LevelLayout* layout) const = 0;
+};
+
+// Return a new layout policy that lays out level i as layouts[i], and
+// levels past the end of "layouts" as its last element.
+//
+// REQUIRES: !layouts.empty()
+//
+// Callers must delete the result after any database that is using the
+// result has been closed.
+LEVELDB_EXPORT const LayoutPolicy* NewLevelLayoutPolicy(
+    const std::vector<LevelLayout>& layouts);
+
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_INCLUDE_LAYOUT_POLICY_H_
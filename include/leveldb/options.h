@@ -6,6 +6,7 @@
 #define STORAGE_LEVELDB_INCLUDE_OPTIONS_H_
 
 #include <cstddef>
+#include <cstdint>
 
 #include "leveldb/export.h"
 
@@ -15,7 +16,10 @@ class Cache;
 class Comparator;
 class Env;
 class FilterPolicy;
+class LayoutPolicy;
 class Logger;
+class PersistentCache;
+class Slice;
 class Snapshot;
 
 // DB contents are stored in a set of blocks, each of which holds a
@@ -83,6 +87,23 @@ struct LEVELDB_EXPORT Options {
   // the next time the database is opened.
   size_t write_buffer_size = 4 * 1024 * 1024;
 
+  // If true, each writer of a write group inserts its own batch into the
+  // memtable, in parallel with the others, once the leader has logged the
+  // group.  Otherwise the leader inserts the whole group.
+  bool allow_concurrent_memtable_write = false;
+
+  // If true, a write group leaves the writer queue as soon as it is logged,
+  // so the next group appends to the log (and syncs) while this one is
+  // applied to the memtable.  Groups are applied and become visible in
+  // sequence order.  Each group is applied by its leader alone, so
+  // allow_concurrent_memtable_write is ignored.
+  bool enable_pipelined_write = false;
+
+  // If true and the comparator is colsm::intComparator(), memtables keep
+  // the 4-byte user keys inline in their skiplist nodes and compare them
+  // without calling the comparator.  Ignored for other comparators.
+  bool int_key_memtable = false;
+
   // Number of open files that can be used by the DB.  You may need to
   // increase this if your database has a large working set (budget
   // one open file per 2MB of working set).
@@ -95,6 +116,19 @@ struct LEVELDB_EXPORT Options {
   // If null, leveldb will automatically create and use an 8MB internal cache.
   Cache* block_cache = nullptr;
 
+  // If non-null, blocks evicted from block_cache are kept in this cache, and
+  // a block_cache miss looks the block up here before reading the table file.
+  // It must outlive block_cache, or the DB if block_cache is null.  The
+  // blocks still in a block cache the DB created itself are dropped, not
+  // spilled, when the DB is closed.
+  PersistentCache* persistent_cache = nullptr;
+
+  // If non-null, use the specified cache for the entries found by point
+  // lookups in tables, so hot keys are served without reading the index and
+  // data blocks. Entries are keyed by table file and user key. Reads at a
+  // snapshot use the cache but do not fill it.
+  Cache* row_cache = nullptr;
+
   // Approximate size of user data packed per block.  Note that the
   // block size specified here corresponds to uncompressed data.  The
   // actual size of the unit read from disk may be smaller if
@@ -118,6 +152,35 @@ struct LEVELDB_EXPORT Options {
 
   // Enhance LevelDB to use larger files on higher levels
   size_t size_factor = 10;
+
+  // If true, the levels above the deepest one holding tables are sized from
+  // its actual size, each size_factor times smaller than the level below,
+  // but never smaller than level-1.  The deepest level grows until the
+  // levels above reach their fixed sizes, then spills into the next one.
+  // The upper levels thus hold about 1/(size_factor-1) of the data whatever
+  // its size.  With layout_adaptation_ops, the cost model also chooses the
+  // ratio of each level, between size_factor/2 and 2*size_factor.
+  bool dynamic_level_bytes = false;
+
+  // Maximum number of compactions run at the same time.  Compactions only
+  // run concurrently if their inputs do not overlap, and at most one of
+  // them reads from level-0.  The Env is asked for at least this many
+  // background threads.
+  int max_background_compactions = 1;
+
+  // Maximum number of key ranges a single compaction is split into.  The
+  // ranges are merged in parallel, each writing its own output files.
+  // They run on the Env's background threads, shared with the
+  // compactions: the Env is asked for at least this many threads, and the
+  // threads running at once never exceed the size of its pool.
+  int max_subcompactions = 1;
+
+  // Number of threads inserting the records of a log into memtables when
+  // the DB is opened.  If greater than 1, the records are inserted
+  // concurrently, and memtables that fill up are written to level-0 tables
+  // on another thread while the log is still being read.
+  int recovery_threads = 1;
+
   // Compress blocks using the specified compression algorithm.  This
   // parameter can be changed dynamically.
   //
@@ -140,12 +203,99 @@ struct LEVELDB_EXPORT Options {
   // Default: currently false, but may become true later.
   bool reuse_logs = false;
 
+  // If positive, up to this many log files are kept once their memtable is
+  // flushed, and are written over instead of creating a new log file when
+  // the memtable is switched, so syncing a log rarely has to update its file
+  // size.  New log files are preallocated.  Logs are then written in a
+  // recyclable format that older versions cannot read, and reuse_logs does
+  // not apply to them.
+  size_t recycle_log_file_num = 0;
+
   // If non-null, use the specified filter policy to reduce disk reads.
   // Many applications will benefit from passing the result of
   // NewBloomFilterPolicy() here.
   const FilterPolicy* filter_policy = nullptr;
 
+  // If positive, the tables written to each level get bloom filters sized
+  // so that the filters of all levels take about this many bytes.  The
+  // budget is split as the current level sizes call for: fewer bits per key
+  // on the large lower levels, and no filter on a level where one would not
+  // pay off.  The split is recomputed whenever the levels change.  The
+  // filters of each level come from filter_policy->NewWithBitsPerKey(), so
+  // DB::Open fails with InvalidArgument if filter_policy cannot size its
+  // filters.
+  size_t filter_memory_budget = 0;
+
+  // If positive, vertical tables store a range filter over their int keys
+  // with about this many bits per key. Iterators with bounds in ReadOptions
+  // use it to skip tables that have no key in range.
+  int range_filter_bits_per_key = 0;
+
   int section_limit = 256;
+
+  // If non-null, chooses the block format, block_size, compression and
+  // section_limit of the tables written to each level.  If null, every level
+  // uses vertical blocks with the values above.
+  const LayoutPolicy* layout_policy = nullptr;
+
+  // If positive, the DB counts the point lookups, range lookups and updates
+  // each level serves, and after this many operations re-solves the cost
+  // model for the format of each level.  Tables written by later flushes and
+  // compactions use the new formats, existing tables keep theirs.  The
+  // formats start from layout_policy.  If zero, they stay as layout_policy
+  // sets them.
+  uint64_t layout_adaptation_ops = 0;
+
+  // If true, a level may hold tables of both block formats: each table a
+  // compaction writes gets the format the cost model chooses for the key
+  // range it covers, from the point and range lookups the tables it replaces
+  // served, instead of the format of its level.  Ranges that serve more
+  // lookups per byte than their level lean to the format with the cheaper
+  // lookups.  Needs layout_adaptation_ops to be positive.
+  bool key_range_layout = false;
+
+  // If true, the cost model also chooses the first level m using leveling,
+  // each time it re-solves the formats.  Levels 1 to m-1 are then tiered: a
+  // compaction into one of them adds a new run instead of merging with its
+  // tables, and a compaction out of one merges all of its runs into the next
+  // level.  Trades lookups on these levels for fewer rewrites of updated
+  // keys.  Needs layout_adaptation_ops to be positive, every level uses
+  // leveling until the first solve.
+  bool tiered_compaction = false;
+
+  // If positive, tables below level-0 whose block format differs from the
+  // one their level now uses are rewritten in the background, one at a
+  // time and the most read first, writing about this many bytes per second
+  // at most.  Rewrites only run when no flush or compaction is needed.
+  uint64_t relayout_bytes_per_second = 0;
+
+  // If true, compactions are also scored by the reads each table costs in
+  // vain: point lookups that read it before finding their key deeper, and
+  // iterators that merge it with overlapping tables of its level.  A read
+  // in a vertical table weighs what the cost model says it costs.  Once the
+  // reads of a table outweigh the cost of compacting it, its level is
+  // compacted starting from its costliest table, even if the level is
+  // within its size.
+  bool read_aware_compaction = false;
+
+  // If positive, a table whose deletion markers make up at least this
+  // fraction of its entries is compacted into the next level even if its
+  // level is within its size, dropping the markers and the entries they
+  // delete.  Frees key ranges that are deleted and then left alone, which
+  // no size compaction may reach.  Tables added by a manifest older than
+  // the deletion counts are never picked this way.
+  double tombstone_compaction_ratio = 0;
+
+  // If positive, a table whose deletion markers delete about this many
+  // bytes in the levels below is compacted the same way.  Each marker is
+  // taken to delete an entry of the average size of the next level.
+  uint64_t tombstone_compaction_bytes = 0;
+
+  // If non-null, the name of a file written by colsm_calibrate, with the
+  // cost model coefficients measured on this host.  They replace the
+  // built-in ones when the DB is opened, and opening fails if the file
+  // cannot be read.
+  const char* cost_parameter_file = nullptr;
 };
 
 // Options that control read operations
@@ -165,6 +315,12 @@ struct LEVELDB_EXPORT ReadOptions {
   // not have been released).  If "snapshot" is null, use an implicit
   // snapshot of the state at the beginning of this read operation.
   const Snapshot* snapshot = nullptr;
+
+  // If non-null, iterators only return user keys >= *iterate_lower_bound and
+  // < *iterate_upper_bound, and skip tables whose range filter rules out the
+  // bounded range. The slices must remain live while the iterator is in use.
+  const Slice* iterate_lower_bound = nullptr;
+  const Slice* iterate_upper_bound = nullptr;
 };
 
 // Options that control write operations
@@ -0,0 +1,69 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+//
+// A PersistentCache is a second tier below the block cache, kept on a local
+// device that is faster than the one holding the tables (e.g. a local NVMe
+// drive in front of network-attached volumes). Blocks evicted from
+// Options::block_cache are inserted into it, and a block cache miss looks
+// it up before reading the table file.
+//
+// The contents cached are uncompressed blocks, which are verified with their
+// own checksum when read back. The cache does not survive a restart: the
+// keys of the blocks are only unique within a process.
+//
+// A PersistentCache has internal synchronization and may be safely accessed
+// concurrently from multiple threads.
+
+#ifndef STORAGE_LEVELDB_INCLUDE_PERSISTENT_CACHE_H_
+#define STORAGE_LEVELDB_INCLUDE_PERSISTENT_CACHE_H_
+
+#include <cstdint>
+#include <string>
+
+#include "leveldb/export.h"
+#include "leveldb/slice.h"
+#include "leveldb/status.h"
+
+namespace leveldb {
+
+class Env;
+
+class LEVELDB_EXPORT PersistentCache {
+ public:
+  PersistentCache() = default;
+
+  PersistentCache(const PersistentCache&) = delete;
+  PersistentCache& operator=(const PersistentCache&) = delete;
+
+  virtual ~PersistentCache();
+
+  // Store a copy of contents under key. Does nothing if key is already
+  // cached. The cache may evict other entries to make room. Called when
+  // the block cache evicts a block, under the lock of the block cache, so
+  // it must not wait for I/O.
+  virtual void Insert(const Slice& key, const Slice& contents) = 0;
+
+  // If the cache holds intact contents for key, store them in *contents and
+  // return true. Else return false.
+  virtual bool Lookup(const Slice& key, std::string* contents) = 0;
+
+  // Return an estimate of the bytes used by the cached contents.
+  virtual size_t TotalCharge() const = 0;
+};
+
+// Create a persistent cache of the given capacity in bytes, storing its files
+// in directory dir. The cache is a log of fixed-size segment files, with an
+// in-memory index of the entries; the oldest segment is dropped when the
+// capacity is exceeded. Full segments are written to their files by a
+// background thread started with env->StartThread(). Any cache files left
+// in dir are removed.
+//
+// On success, stores a pointer to the new cache in *result and returns OK.
+LEVELDB_EXPORT Status NewFilePersistentCache(Env* env, const std::string& dir,
+                                             size_t capacity,
+                                             PersistentCache** result);
+
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_INCLUDE_PERSISTENT_CACHE_H_
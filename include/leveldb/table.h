@@ -75,6 +75,11 @@ class LEVELDB_EXPORT Table {
 
   void ReadMeta(const Footer& footer);
   void ReadFilter(const Slice& filter_handle_value);
+  void ReadRangeFilter(const Slice& filter_handle_value);
+
+  // Return false if the range filter shows that no user key is within
+  // [*lower, *upper). A null bound is unbounded.
+  bool RangeMayMatch(const Slice* lower, const Slice* upper) const;
 
   Rep* const rep_;
 };
@@ -18,16 +18,20 @@
 #include "util/logging.h"
 
 #include "colsm/vblock/vert_block.h"
+#include "colsm/vblock/vert_index_block.h"
 
 namespace leveldb {
 
-Block::Block(const BlockContents& contents) {
+Block::Block(const BlockContents& contents) : contents_(contents.data) {
   // Read the last byte and determine what is in the block
   auto data_pointer = contents.data.data();
   auto data_length = contents.data.size();
   uint32_t last = *((uint32_t*)(data_pointer + data_length - 4));
   if (last == colsm::MAGIC) {
     core_ = std::unique_ptr<BlockCore>(new colsm::VertBlockCore(contents));
+  } else if (last == colsm::INDEX_MAGIC) {
+    core_ =
+        std::unique_ptr<BlockCore>(new colsm::VertIndexBlockCore(contents));
   } else {
     core_ = std::unique_ptr<BlockCore>(new BasicBlockCore(contents));
   }
@@ -30,6 +30,7 @@ class BlockCore {
 class Block {
  private:
   std::unique_ptr<BlockCore> core_;
+  Slice contents_;
 
  public:
   // Initialize the block with the specified contents.
@@ -43,6 +44,9 @@ class Block {
 
   size_t size() const { return core_->size(); }
 
+  // The raw contents the block was initialized with
+  const Slice& contents() const { return contents_; }
+
   Iterator* NewIterator(const Comparator* comparator) {
     return core_->NewIterator(comparator);
   }
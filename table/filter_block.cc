@@ -4,6 +4,8 @@
 
 #include "table/filter_block.h"
 
+#include <algorithm>
+
 #include "leveldb/filter_policy.h"
 #include "util/coding.h"
 
@@ -103,4 +105,24 @@ bool FilterBlockReader::KeyMayMatch(uint64_t block_offset, const Slice& key) {
   return true;  // Errors are treated as potential matches
 }
 
+void FilterBlockReader::KeysMayMatch(uint64_t block_offset, const Slice* keys,
+                                     int n, bool* results) {
+  uint64_t index = block_offset >> base_lg_;
+  if (index < num_) {
+    uint32_t start = DecodeFixed32(offset_ + index * 4);
+    uint32_t limit = DecodeFixed32(offset_ + index * 4 + 4);
+    if (start <= limit && limit <= static_cast<size_t>(offset_ - data_)) {
+      Slice filter = Slice(data_ + start, limit - start);
+      policy_->KeysMayMatch(keys, n, filter, results);
+      return;
+    } else if (start == limit) {
+      // Empty filters do not match any keys
+      std::fill(results, results + n, false);
+      return;
+    }
+  }
+  // Errors are treated as potential matches
+  std::fill(results, results + n, true);
+}
+
 }  // namespace leveldb
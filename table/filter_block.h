@@ -54,6 +54,9 @@ class FilterBlockReader {
   // REQUIRES: "contents" and *policy must stay live while *this is live.
   FilterBlockReader(const FilterPolicy* policy, const Slice& contents);
   bool KeyMayMatch(uint64_t block_offset, const Slice& key);
+  // Probe n keys that belong to the same data block at once
+  void KeysMayMatch(uint64_t block_offset, const Slice* keys, int n,
+                    bool* results);
 
  private:
   const FilterPolicy* policy_;
@@ -4,23 +4,30 @@
 
 #include "leveldb/table.h"
 
+#include <cstring>
+
 #include "leveldb/cache.h"
 #include "leveldb/comparator.h"
 #include "leveldb/env.h"
 #include "leveldb/filter_policy.h"
 #include "leveldb/options.h"
+#include "leveldb/persistent_cache.h"
 #include "table/block.h"
 #include "table/filter_block.h"
 #include "table/format.h"
 #include "table/two_level_iterator.h"
 #include "util/coding.h"
 
+#include "colsm/filter/range_filter.h"
+
 namespace leveldb {
 
 struct Table::Rep {
   ~Rep() {
     delete filter;
     delete[] filter_data;
+    delete range_filter;
+    delete[] range_filter_data;
     delete index_block;
   }
 
@@ -30,6 +37,8 @@ struct Table::Rep {
   uint64_t cache_id;
   FilterBlockReader* filter;
   const char* filter_data;
+  colsm::RangeFilter* range_filter;
+  const char* range_filter_data;
 
   BlockHandle metaindex_handle;  // Handle to metaindex_block: saved from footer
   Block* index_block;
@@ -72,6 +81,8 @@ Status Table::Open(const Options& options, RandomAccessFile* file,
     rep->cache_id = (options.block_cache ? options.block_cache->NewId() : 0);
     rep->filter_data = nullptr;
     rep->filter = nullptr;
+    rep->range_filter_data = nullptr;
+    rep->range_filter = nullptr;
     *table = new Table(rep);
     (*table)->ReadMeta(footer);
   }
@@ -80,7 +91,8 @@ Status Table::Open(const Options& options, RandomAccessFile* file,
 }
 
 void Table::ReadMeta(const Footer& footer) {
-  if (rep_->options.filter_policy == nullptr) {
+  if (rep_->options.filter_policy == nullptr &&
+      rep_->options.range_filter_bits_per_key <= 0) {
     return;  // Do not need any metadata
   }
 
@@ -98,11 +110,19 @@ void Table::ReadMeta(const Footer& footer) {
   Block* meta = new Block(contents);
 
   Iterator* iter = meta->NewIterator(BytewiseComparator());
-  std::string key = "filter.";
-  key.append(rep_->options.filter_policy->Name());
-  iter->Seek(key);
-  if (iter->Valid() && iter->key() == Slice(key)) {
-    ReadFilter(iter->value());
+  if (rep_->options.filter_policy != nullptr) {
+    std::string key = "filter.";
+    key.append(rep_->options.filter_policy->Name());
+    iter->Seek(key);
+    if (iter->Valid() && iter->key() == Slice(key)) {
+      ReadFilter(iter->value());
+    }
+  }
+  if (rep_->options.range_filter_bits_per_key > 0) {
+    iter->Seek("rangefilter.colsm");
+    if (iter->Valid() && iter->key() == Slice("rangefilter.colsm")) {
+      ReadRangeFilter(iter->value());
+    }
   }
   delete iter;
   delete meta;
@@ -131,6 +151,46 @@ void Table::ReadFilter(const Slice& filter_handle_value) {
   rep_->filter = new FilterBlockReader(rep_->options.filter_policy, block.data);
 }
 
+void Table::ReadRangeFilter(const Slice& filter_handle_value) {
+  Slice v = filter_handle_value;
+  BlockHandle filter_handle;
+  if (!filter_handle.DecodeFrom(&v).ok()) {
+    return;
+  }
+  ReadOptions opt;
+  if (rep_->options.paranoid_checks) {
+    opt.verify_checksums = true;
+  }
+  BlockContents block;
+  if (!ReadBlock(rep_->file, opt, filter_handle, &block).ok()) {
+    return;
+  }
+  if (block.heap_allocated) {
+    rep_->range_filter_data = block.data.data();  // Will need to delete later
+  }
+  rep_->range_filter = new colsm::RangeFilter(block.data);
+}
+
+bool Table::RangeMayMatch(const Slice* lower, const Slice* upper) const {
+  if (rep_->range_filter == nullptr) {
+    return true;
+  }
+  uint32_t low = 0;
+  uint32_t high = UINT32_MAX;
+  if (lower != nullptr) {
+    if (lower->size() != 4) return true;
+    low = DecodeFixed32(lower->data());
+  }
+  if (upper != nullptr) {
+    if (upper->size() != 4) return true;
+    // Upper bound is exclusive
+    high = DecodeFixed32(upper->data());
+    if (high == 0) return false;
+    high--;
+  }
+  return rep_->range_filter->RangeMayMatch(low, high);
+}
+
 Table::~Table() { delete rep_; }
 
 static void DeleteBlock(void* arg, void* ignored) {
@@ -142,6 +202,26 @@ static void DeleteCachedBlock(const Slice& key, void* value) {
   delete block;
 }
 
+// A block that moves to the persistent cache when evicted from the block cache
+class PersistentCachedBlock : public Block {
+ public:
+  PersistentCachedBlock(const BlockContents& contents,
+                        PersistentCache* persistent_cache)
+      : Block(contents), persistent_cache_(persistent_cache) {}
+
+  PersistentCache* persistent_cache() const { return persistent_cache_; }
+
+ private:
+  PersistentCache* const persistent_cache_;
+};
+
+static void SpillCachedBlock(const Slice& key, void* value) {
+  PersistentCachedBlock* block =
+      static_cast<PersistentCachedBlock*>(reinterpret_cast<Block*>(value));
+  block->persistent_cache()->Insert(key, block->contents());
+  delete block;
+}
+
 static void ReleaseBlock(void* arg, void* h) {
   Cache* cache = reinterpret_cast<Cache*>(arg);
   Cache::Handle* handle = reinterpret_cast<Cache::Handle*>(h);
@@ -174,12 +254,30 @@ Iterator* Table::BlockReader(void* arg, const ReadOptions& options,
       if (cache_handle != nullptr) {
         block = reinterpret_cast<Block*>(block_cache->Value(cache_handle));
       } else {
-        s = ReadBlock(table->rep_->file, options, handle, &contents);
+        PersistentCache* persistent_cache =
+            table->rep_->options.persistent_cache;
+        std::string cached;
+        if (persistent_cache != nullptr &&
+            persistent_cache->Lookup(key, &cached)) {
+          char* buf = new char[cached.size()];
+          memcpy(buf, cached.data(), cached.size());
+          contents.data = Slice(buf, cached.size());
+          contents.cachable = true;
+          contents.heap_allocated = true;
+        } else {
+          s = ReadBlock(table->rep_->file, options, handle, &contents);
+        }
         if (s.ok()) {
-          block = new Block(contents);
+          if (persistent_cache != nullptr) {
+            block = new PersistentCachedBlock(contents, persistent_cache);
+          } else {
+            block = new Block(contents);
+          }
           if (contents.cachable && options.fill_cache) {
-            cache_handle = block_cache->Insert(key, block, block->size(),
-                                               &DeleteCachedBlock);
+            cache_handle = block_cache->Insert(
+                key, block, block->size(),
+                persistent_cache != nullptr ? &SpillCachedBlock
+                                            : &DeleteCachedBlock);
           }
         }
       }
@@ -206,6 +304,13 @@ Iterator* Table::BlockReader(void* arg, const ReadOptions& options,
 }
 
 Iterator* Table::NewIterator(const ReadOptions& options) const {
+  if ((options.iterate_lower_bound != nullptr ||
+       options.iterate_upper_bound != nullptr) &&
+      !RangeMayMatch(options.iterate_lower_bound,
+                     options.iterate_upper_bound)) {
+    // No key in the bounded range, the iterator never reads a block
+    return NewEmptyIterator();
+  }
   return NewTwoLevelIterator(
       rep_->index_block->NewIterator(rep_->options.comparator),
       &Table::BlockReader, const_cast<Table*>(this), options);
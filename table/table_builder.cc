@@ -20,7 +20,9 @@
 
 #include "zlib.h"
 
+#include "colsm/filter/range_filter.h"
 #include "colsm/vblock/vert_block_builder.h"
+#include "colsm/vblock/vert_index_block_builder.h"
 
 using namespace colsm;
 
@@ -32,20 +34,26 @@ struct TableBuilder::Rep {
         index_block_options(opt),
         file(f),
         offset(0),
-        index_block(&index_block_options),
         num_entries(0),
         vformat(vf),
         closed(false),
         filter_block(opt.filter_policy == nullptr
                          ? nullptr
                          : new FilterBlockBuilder(opt.filter_policy)),
+        range_filter(vf && opt.range_filter_bits_per_key > 0
+                         ? new RangeFilterBuilder(opt.range_filter_bits_per_key)
+                         : nullptr),
         pending_index_entry(false) {
     index_block_options.block_restart_interval = 1;
     if (vformat) {
       data_block =
           std::unique_ptr<BlockBuilder>(new VertBlockBuilder(&options,LENGTH));
+      index_block = std::unique_ptr<BlockBuilder>(
+          new VertIndexBlockBuilder(&index_block_options));
     } else {
       data_block = std::unique_ptr<BlockBuilder>(new BlockBuilder(&options));
+      index_block =
+          std::unique_ptr<BlockBuilder>(new BlockBuilder(&index_block_options));
     }
   }
 
@@ -55,12 +63,14 @@ struct TableBuilder::Rep {
   uint64_t offset;
   Status status;
   std::unique_ptr<BlockBuilder> data_block;
-  BlockBuilder index_block;
+  std::unique_ptr<BlockBuilder> index_block;
   std::string last_key;
   int64_t num_entries;
   bool vformat;
   bool closed;  // Either Finish() or Abandon() has been called.
   FilterBlockBuilder* filter_block;
+  // Range filter over int user keys, only for vertical tables
+  std::unique_ptr<RangeFilterBuilder> range_filter;
 
   // We do not emit the index entry for a block until we have seen the
   // first key for the next data block.  This allows us to use shorter
@@ -123,13 +133,21 @@ void TableBuilder::Add(const Slice& key, const Slice& value) {
     r->options.comparator->FindShortestSeparator(&r->last_key, key);
     std::string handle_encoding;
     r->pending_handle.EncodeTo(&handle_encoding);
-    r->index_block.Add(r->last_key, Slice(handle_encoding));
+    r->index_block->Add(r->last_key, Slice(handle_encoding));
     r->pending_index_entry = false;
   }
 
   if (r->filter_block != nullptr) {
     r->filter_block->AddKey(key);
   }
+  if (r->range_filter != nullptr) {
+    if (key.size() == 12) {
+      r->range_filter->AddKey(*reinterpret_cast<const uint32_t*>(key.data()));
+    } else {
+      // Not an int key, a partial filter would give false negatives
+      r->range_filter.reset();
+    }
+  }
 
   r->last_key.assign(key.data(), key.size());
   r->num_entries++;
@@ -232,7 +250,8 @@ Status TableBuilder::Finish() {
   assert(!r->closed);
   r->closed = true;
 
-  BlockHandle filter_block_handle, metaindex_block_handle, index_block_handle;
+  BlockHandle filter_block_handle, range_filter_handle, metaindex_block_handle,
+      index_block_handle;
 
   // Write filter block
   if (ok() && r->filter_block != nullptr) {
@@ -240,6 +259,12 @@ Status TableBuilder::Finish() {
                   &filter_block_handle);
   }
 
+  // Write range filter block
+  if (ok() && r->range_filter != nullptr) {
+    WriteRawBlock(r->range_filter->Finish(), kNoCompression,
+                  &range_filter_handle);
+  }
+
   // Write metaindex block
   if (ok()) {
     BlockBuilder meta_index_block(&r->options);
@@ -253,6 +278,11 @@ Status TableBuilder::Finish() {
       filter_block_handle.EncodeTo(&handle_encoding);
       meta_index_block.Add(key, handle_encoding);
     }
+    if (r->range_filter != nullptr) {
+      std::string handle_encoding;
+      range_filter_handle.EncodeTo(&handle_encoding);
+      meta_index_block.Add("rangefilter.colsm", handle_encoding);
+    }
 
     // TODO(postrelease): Add stats and other meta blocks
     WriteBlock(&meta_index_block, &metaindex_block_handle);
@@ -264,10 +294,10 @@ Status TableBuilder::Finish() {
       r->options.comparator->FindShortSuccessor(&r->last_key);
       std::string handle_encoding;
       r->pending_handle.EncodeTo(&handle_encoding);
-      r->index_block.Add(r->last_key, Slice(handle_encoding));
+      r->index_block->Add(r->last_key, Slice(handle_encoding));
       r->pending_index_entry = false;
     }
-    WriteBlock(&r->index_block, &index_block_handle);
+    WriteBlock(r->index_block.get(), &index_block_handle);
   }
 
   // Write footer
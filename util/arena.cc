@@ -4,12 +4,30 @@
 
 #include "util/arena.h"
 
+#include "util/mutexlock.h"
+
 namespace leveldb {
 
 static const int kBlockSize = 4096;
+static const size_t kSlabSize = 4096;
+
+static std::atomic<uint64_t> next_arena_id(1);
+
+// The slab a thread allocates from in AllocateConcurrently().  A thread
+// inserts into one memtable at a time, so one slab per thread suffices.
+struct ThreadSlab {
+  uint64_t arena_id = 0;
+  char* ptr = nullptr;
+  size_t remaining = 0;
+};
+
+static thread_local ThreadSlab thread_slab;
 
 Arena::Arena()
-    : alloc_ptr_(nullptr), alloc_bytes_remaining_(0), memory_usage_(0) {}
+    : id_(next_arena_id.fetch_add(1, std::memory_order_relaxed)),
+      alloc_ptr_(nullptr),
+      alloc_bytes_remaining_(0),
+      memory_usage_(0) {}
 
 Arena::~Arena() {
   for (size_t i = 0; i < blocks_.size(); i++) {
@@ -55,6 +73,28 @@ char* Arena::AllocateAligned(size_t bytes) {
   return result;
 }
 
+char* Arena::AllocateConcurrently(size_t bytes) {
+  const size_t align = (sizeof(void*) > 8) ? sizeof(void*) : 8;
+  bytes = (bytes + align - 1) & ~(align - 1);
+  if (bytes > kSlabSize / 4) {
+    MutexLock l(&mutex_);
+    return AllocateAligned(bytes);
+  }
+
+  ThreadSlab* slab = &thread_slab;
+  if (slab->arena_id != id_ || slab->remaining < bytes) {
+    // Slabs are block-sized, so each gets a block of its own
+    MutexLock l(&mutex_);
+    slab->arena_id = id_;
+    slab->ptr = AllocateAligned(kSlabSize);
+    slab->remaining = kSlabSize;
+  }
+  char* result = slab->ptr;
+  slab->ptr += bytes;
+  slab->remaining -= bytes;
+  return result;
+}
+
 char* Arena::AllocateNewBlock(size_t block_bytes) {
   char* result = new char[block_bytes];
   blocks_.push_back(result);
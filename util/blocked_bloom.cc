@@ -0,0 +1,138 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include <immintrin.h>
+
+#include <algorithm>
+
+#include "leveldb/filter_policy.h"
+#include "leveldb/slice.h"
+#include "util/hash.h"
+
+namespace leveldb {
+
+namespace {
+
+// The filter is an array of 256-bit blocks, each seen as 8 32-bit words. A
+// key selects one block by its hash, and sets one bit in each of the 8 words
+// (the split block bloom filter of Putze et al. and Parquet). All probes
+// of a key are thus within one cache line, and can be generated and tested
+// with a handful of AVX2 instructions.
+static const size_t kBlockBytes = 32;
+
+static uint32_t BlockedBloomHash(const Slice& key) {
+  return Hash(key.data(), key.size(), 0xbc9f1d34);
+}
+
+// Remix the hash so the bits selecting the block and the bits selecting the
+// probes within the block are independent
+static inline uint32_t Remix(uint32_t h) {
+  h ^= h >> 16;
+  h *= 0x85ebca6b;
+  h ^= h >> 13;
+  h *= 0xc2b2ae35;
+  h ^= h >> 16;
+  return h;
+}
+
+static inline size_t BlockIndex(uint32_t h, size_t num_blocks) {
+  return (static_cast<uint64_t>(h) * num_blocks) >> 32;
+}
+
+// One bit per 32-bit word, chosen by the top 5 bits of h * salt
+static inline __m256i ProbeMask(uint32_t h) {
+  const __m256i salt =
+      _mm256_setr_epi32(0x47b6137b, 0x44974d91, 0x8824ad5b, 0xa2b7289d,
+                        0x705495c7, 0x2df1424b, 0x9efc4947, 0x5c6bfb31);
+  __m256i hash = _mm256_set1_epi32(Remix(h));
+  __m256i shift = _mm256_srli_epi32(_mm256_mullo_epi32(hash, salt), 27);
+  return _mm256_sllv_epi32(_mm256_set1_epi32(1), shift);
+}
+
+static inline bool BlockMayMatch(const char* block, uint32_t h) {
+  __m256i bits = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block));
+  // testc returns 1 if all bits of the mask are set in the block
+  return _mm256_testc_si256(bits, ProbeMask(h));
+}
+
+class BlockedBloomFilterPolicy : public FilterPolicy {
+ public:
+  explicit BlockedBloomFilterPolicy(int bits_per_key)
+      : bits_per_key_(bits_per_key < 1 ? 1 : bits_per_key) {}
+
+  const char* Name() const override { return "colsm.BlockedBloomFilter"; }
+
+  const FilterPolicy* NewWithBitsPerKey(int bits_per_key) const override {
+    return new BlockedBloomFilterPolicy(bits_per_key);
+  }
+
+  void CreateFilter(const Slice* keys, int n, std::string* dst) const override {
+    // At least one block, which also keeps the false positive rate of
+    // small filters low
+    size_t bits = n * bits_per_key_;
+    size_t num_blocks = (bits + kBlockBytes * 8 - 1) / (kBlockBytes * 8);
+    if (num_blocks < 1) num_blocks = 1;
+
+    const size_t init_size = dst->size();
+    dst->resize(init_size + num_blocks * kBlockBytes, 0);
+    char* array = &(*dst)[init_size];
+    for (int i = 0; i < n; i++) {
+      uint32_t h = BlockedBloomHash(keys[i]);
+      char* block = array + BlockIndex(h, num_blocks) * kBlockBytes;
+      __m256i bits =
+          _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block));
+      bits = _mm256_or_si256(bits, ProbeMask(h));
+      _mm256_storeu_si256(reinterpret_cast<__m256i*>(block), bits);
+    }
+  }
+
+  bool KeyMayMatch(const Slice& key, const Slice& filter) const override {
+    const size_t len = filter.size();
+    if (len == 0) return false;
+    if (len % kBlockBytes != 0) {
+      // Not a filter generated by this policy. Consider it a match.
+      return true;
+    }
+    uint32_t h = BlockedBloomHash(key);
+    return BlockMayMatch(
+        filter.data() + BlockIndex(h, len / kBlockBytes) * kBlockBytes, h);
+  }
+
+  void KeysMayMatch(const Slice* keys, int n, const Slice& filter,
+                    bool* results) const override {
+    const size_t len = filter.size();
+    if (len == 0 || len % kBlockBytes != 0) {
+      std::fill(results, results + n, len != 0);
+      return;
+    }
+    const size_t num_blocks = len / kBlockBytes;
+    // Hash all keys and prefetch their blocks first, so the cache misses of
+    // different keys overlap instead of being paid one after another
+    static const int kBatch = 16;
+    uint32_t hashes[kBatch];
+    const char* blocks[kBatch];
+    for (int start = 0; start < n; start += kBatch) {
+      int count = std::min(kBatch, n - start);
+      for (int i = 0; i < count; i++) {
+        hashes[i] = BlockedBloomHash(keys[start + i]);
+        blocks[i] =
+            filter.data() + BlockIndex(hashes[i], num_blocks) * kBlockBytes;
+        _mm_prefetch(blocks[i], _MM_HINT_T0);
+      }
+      for (int i = 0; i < count; i++) {
+        results[start + i] = BlockMayMatch(blocks[i], hashes[i]);
+      }
+    }
+  }
+
+ private:
+  size_t bits_per_key_;
+};
+}  // namespace
+
+const FilterPolicy* NewBlockedBloomFilterPolicy(int bits_per_key) {
+  return new BlockedBloomFilterPolicy(bits_per_key);
+}
+
+}  // namespace leveldb
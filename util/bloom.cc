@@ -25,6 +25,10 @@ class BloomFilterPolicy : public FilterPolicy {
 
   const char* Name() const override { return "leveldb.BuiltinBloomFilter2"; }
 
+  const FilterPolicy* NewWithBitsPerKey(int bits_per_key) const override {
+    return new BloomFilterPolicy(bits_per_key);
+  }
+
   void CreateFilter(const Slice* keys, int n, std::string* dst) const override {
     // Compute bloom filter size (in both bits and bytes)
     size_t bits = n * bits_per_key_;
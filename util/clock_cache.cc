@@ -0,0 +1,596 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#include "leveldb/cache.h"
+#include "port/port.h"
+#include "util/hash.h"
+#include "util/mutexlock.h"
+
+namespace leveldb {
+
+namespace {
+
+// CLOCK cache with TinyLFU admission
+//
+// Lookup() and Release() are the hot path of a block cache, so neither takes
+// a lock. Each shard keeps its entries in a fixed array of slots, an open
+// addressed hash table with linear probing. A slot packs its state, the
+// references of clients and a reference bit into one atomic word. A lookup
+// adds a reference to the slot holding the hash of its key, and only then
+// checks the slot is in the cache and has its key: a slot is never reused
+// while referenced. Insert(), Erase() and eviction are serialized by the
+// shard lock, and change the state of a slot only atomically with respect to
+// the references readers add.
+//
+// Eviction sweeps a clock hand over the slots. An entry that has been looked
+// up since the last sweep gets a second chance, and an entry still in use by
+// clients is skipped.
+//
+// When the cache is full, a new entry is only admitted if it has been
+// accessed more often than the entry it would evict, as estimated by a
+// count-min sketch over the recent accesses (TinyLFU, Einziger et al.). The
+// blocks read once by a long scan thus cannot flush the frequently used ones.
+struct ClockHandle {
+  // Layout of meta: the references of clients in the low bits, the
+  // reference bit, and the state of the slot in the two high bits
+  static constexpr uint64_t kOneRef = 1;
+  static constexpr uint64_t kRefMask = (uint64_t{1} << 30) - 1;
+  static constexpr uint64_t kReferenced = uint64_t{1} << 30;
+  static constexpr int kStateShift = 62;
+  // No entry, may be claimed by an insert
+  static constexpr uint64_t kEmpty = 0;
+  // Being filled or freed by the holder of the shard lock
+  static constexpr uint64_t kConstruction = 1;
+  // An entry in the cache
+  static constexpr uint64_t kVisible = 2;
+  // An entry erased from the cache, freed with its last reference
+  static constexpr uint64_t kInvisible = 3;
+
+  static uint64_t State(uint64_t meta) { return meta >> kStateShift; }
+  static uint64_t Refs(uint64_t meta) { return meta & kRefMask; }
+  static uint64_t StateDelta(uint64_t from, uint64_t to) {
+    return (to - from) << kStateShift;
+  }
+
+  std::atomic<uint64_t> meta{0};
+  // Inserts that probed past this slot, a lookup cannot stop before a slot
+  // where this is zero
+  std::atomic<uint32_t> displacements{0};
+  // Hash of the key, read by lookups before they reference the slot
+  std::atomic<uint32_t> hash{0};
+
+  // Set while the slot is under construction, read once it is visible
+  void* value;
+  void (*deleter)(const Slice&, void* value);
+  size_t charge;
+  char* key_data;
+  size_t key_length;
+  // Not in any slot: a handle returned by an Insert() that was not admitted,
+  // freed with its last reference
+  bool detached = false;
+
+  Slice key() const { return Slice(key_data, key_length); }
+};
+
+// Count-min sketch of access frequencies with 4 rows of saturating counters.
+// Counters are halved every sample_size accesses, so the sketch reflects
+// recent popularity. Updates are relaxed and may lose increments under
+// contention, which only makes the estimate slightly lower.
+class FrequencySketch {
+ public:
+  static const int kDepth = 4;
+  static const uint8_t kMaxCount = 15;
+
+  FrequencySketch() : mask_(0), sample_size_(0), additions_(0) {}
+
+  void SetWidth(uint32_t width) {
+    uint32_t power = 1024;
+    while (power < width) {
+      power *= 2;
+    }
+    mask_ = power - 1;
+    sample_size_ = power * 10;
+    table_.reset(new std::atomic<uint8_t>[power * kDepth]);
+    for (uint32_t i = 0; i < power * kDepth; i++) {
+      table_[i].store(0, std::memory_order_relaxed);
+    }
+  }
+
+  void Increment(uint32_t hash) {
+    for (int i = 0; i < kDepth; i++) {
+      auto& counter = table_[Index(hash, i)];
+      uint8_t count = counter.load(std::memory_order_relaxed);
+      if (count < kMaxCount) {
+        counter.store(count + 1, std::memory_order_relaxed);
+      }
+    }
+    additions_.store(additions_.load(std::memory_order_relaxed) + 1,
+                     std::memory_order_relaxed);
+  }
+
+  uint32_t Frequency(uint32_t hash) const {
+    uint32_t result = kMaxCount;
+    for (int i = 0; i < kDepth; i++) {
+      uint32_t count = table_[Index(hash, i)].load(std::memory_order_relaxed);
+      result = count < result ? count : result;
+    }
+    return result;
+  }
+
+  // Age the counters once enough accesses are recorded
+  void MaybeReset() {
+    if (additions_.load(std::memory_order_relaxed) < sample_size_) {
+      return;
+    }
+    additions_.store(0, std::memory_order_relaxed);
+    for (uint32_t i = 0; i < (mask_ + 1) * kDepth; i++) {
+      table_[i].store(table_[i].load(std::memory_order_relaxed) >> 1,
+                      std::memory_order_relaxed);
+    }
+  }
+
+ private:
+  uint32_t Index(uint32_t hash, int row) const {
+    uint32_t h = (hash + row * 0x9e3779b9) * 0x85ebca6b;
+    h ^= h >> 15;
+    return row * (mask_ + 1) + (h & mask_);
+  }
+
+  std::unique_ptr<std::atomic<uint8_t>[]> table_;
+  uint32_t mask_;
+  uint32_t sample_size_;
+  std::atomic<uint32_t> additions_;
+};
+
+// An entry to pass to its deleter once the shard lock is released
+struct DeadEntry {
+  void* value;
+  void (*deleter)(const Slice&, void* value);
+  char* key_data;
+  size_t key_length;
+};
+
+static void DeleteEntries(const std::vector<DeadEntry>& dead) {
+  for (const DeadEntry& d : dead) {
+    (*d.deleter)(Slice(d.key_data, d.key_length), d.value);
+    delete[] d.key_data;
+  }
+}
+
+// A single shard of sharded cache.
+class ClockCacheShard {
+ public:
+  ClockCacheShard() : capacity_(0), usage_(0), mask_(0), hand_(0) {}
+  ~ClockCacheShard();
+
+  // Separate from constructor so caller can easily make an array of shards
+  void SetCapacity(size_t capacity, size_t estimated_entry_charge) {
+    capacity_ = capacity;
+    // Twice the slots of the entries expected to fit, so probes stay short
+    const size_t entries =
+        capacity / std::max<size_t>(estimated_entry_charge, 1);
+    size_t num_slots = 16;
+    while (num_slots < 2 * entries) {
+      num_slots *= 2;
+    }
+    slots_.reset(new ClockHandle[num_slots]);
+    mask_ = num_slots - 1;
+    // Size the sketch for the entries that fit
+    sketch_.SetWidth(entries);
+  }
+
+  Cache::Handle* Insert(const Slice& key, uint32_t hash, void* value,
+                        size_t charge,
+                        void (*deleter)(const Slice& key, void* value));
+  Cache::Handle* Lookup(const Slice& key, uint32_t hash);
+  void Release(ClockHandle* h);
+  void Erase(const Slice& key, uint32_t hash);
+  void Prune();
+  size_t TotalCharge() const {
+    return usage_.load(std::memory_order_relaxed);
+  }
+
+ private:
+  // Pick the entry the clock hand would evict next, without moving the hand
+  // or clearing reference bits. Return the number of slots the hand would
+  // pass to get there, or 0 if every entry is in use.
+  size_t FindVictim() EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  // Move the hand by "steps" slots, giving a second chance to the referenced
+  // entries passed, and try to evict the entry it stops on
+  void AdvanceHand(size_t steps, std::vector<DeadEntry>* dead)
+      EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  // Evict the next entry the clock hand finds. Return false if every entry
+  // is in use.
+  bool EvictOne(std::vector<DeadEntry>* dead) EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  // Remove an unreferenced entry of "state" from its slot
+  bool TryFree(size_t index, uint64_t state, std::vector<DeadEntry>* dead)
+      EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  // Erase the entries of the key from the cache. Return false if there
+  // were none.
+  bool EraseLocked(const Slice& key, uint32_t hash,
+                   std::vector<DeadEntry>* dead)
+      EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+  // Claim an empty slot for the hash. Return false if all are taken.
+  bool ClaimSlot(uint32_t hash, size_t* index)
+      EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+  size_t capacity_;
+
+  port::Mutex mutex_;
+  std::atomic<size_t> usage_;
+  std::unique_ptr<ClockHandle[]> slots_;
+  size_t mask_;
+  size_t hand_ GUARDED_BY(mutex_);
+
+  FrequencySketch sketch_;
+};
+
+ClockCacheShard::~ClockCacheShard() {
+  std::vector<DeadEntry> dead;
+  for (size_t i = 0; i <= mask_; i++) {
+    ClockHandle* h = &slots_[i];
+    const uint64_t meta = h->meta.load(std::memory_order_relaxed);
+    if (ClockHandle::State(meta) == ClockHandle::kVisible) {
+      // Error if caller has an unreleased handle
+      assert(ClockHandle::Refs(meta) == 0);
+      dead.push_back({h->value, h->deleter, h->key_data, h->key_length});
+    }
+  }
+  DeleteEntries(dead);
+}
+
+Cache::Handle* ClockCacheShard::Lookup(const Slice& key, uint32_t hash) {
+  // Misses count too, as they are followed by an Insert of the key
+  sketch_.Increment(hash);
+  size_t index = hash & mask_;
+  for (size_t probe = 0; probe <= mask_; probe++) {
+    ClockHandle* h = &slots_[index];
+    if (h->hash.load(std::memory_order_relaxed) == hash) {
+      const uint64_t meta =
+          h->meta.fetch_add(ClockHandle::kOneRef, std::memory_order_acquire);
+      // The reference keeps the slot from being freed while its key is read
+      if (ClockHandle::State(meta) == ClockHandle::kVisible &&
+          h->hash.load(std::memory_order_relaxed) == hash && key == h->key()) {
+        if ((meta & ClockHandle::kReferenced) == 0) {
+          h->meta.fetch_or(ClockHandle::kReferenced,
+                           std::memory_order_relaxed);
+        }
+        return reinterpret_cast<Cache::Handle*>(h);
+      }
+      Release(h);
+    }
+    if (h->displacements.load(std::memory_order_relaxed) == 0) {
+      break;
+    }
+    index = (index + 1) & mask_;
+  }
+  return nullptr;
+}
+
+void ClockCacheShard::Release(ClockHandle* h) {
+  const uint64_t meta =
+      h->meta.fetch_sub(ClockHandle::kOneRef, std::memory_order_release);
+  if (ClockHandle::Refs(meta) != 1) {
+    return;
+  }
+  if (h->detached) {
+    (*h->deleter)(h->key(), h->value);
+    delete[] h->key_data;
+    delete h;
+  } else if (ClockHandle::State(meta) == ClockHandle::kInvisible) {
+    // The last reference to an erased entry
+    std::vector<DeadEntry> dead;
+    {
+      MutexLock l(&mutex_);
+      TryFree(h - slots_.get(), ClockHandle::kInvisible, &dead);
+    }
+    DeleteEntries(dead);
+  }
+}
+
+bool ClockCacheShard::TryFree(size_t index, uint64_t state,
+                              std::vector<DeadEntry>* dead) {
+  ClockHandle* h = &slots_[index];
+  // Only an unreferenced entry may leave its slot
+  uint64_t meta = h->meta.load(std::memory_order_relaxed);
+  do {
+    if (ClockHandle::State(meta) != state || ClockHandle::Refs(meta) != 0) {
+      return false;
+    }
+  } while (!h->meta.compare_exchange_weak(
+      meta, ClockHandle::kConstruction << ClockHandle::kStateShift,
+      std::memory_order_acquire, std::memory_order_relaxed));
+
+  if (state == ClockHandle::kVisible) {
+    usage_.fetch_sub(h->charge, std::memory_order_relaxed);
+  }
+  dead->push_back({h->value, h->deleter, h->key_data, h->key_length});
+  const uint32_t hash = h->hash.load(std::memory_order_relaxed);
+  for (size_t i = hash & mask_; i != index; i = (i + 1) & mask_) {
+    slots_[i].displacements.fetch_sub(1, std::memory_order_relaxed);
+  }
+  // Keep the references of lookups that probe the slot meanwhile
+  h->meta.fetch_sub(
+      ClockHandle::StateDelta(ClockHandle::kEmpty, ClockHandle::kConstruction),
+      std::memory_order_release);
+  return true;
+}
+
+bool ClockCacheShard::ClaimSlot(uint32_t hash, size_t* index) {
+  const size_t home = hash & mask_;
+  size_t i = home;
+  for (size_t probe = 0; probe <= mask_; probe++) {
+    ClockHandle* h = &slots_[i];
+    uint64_t expected = 0;
+    if (h->meta.compare_exchange_strong(
+            expected, ClockHandle::kConstruction << ClockHandle::kStateShift,
+            std::memory_order_acquire, std::memory_order_relaxed)) {
+      *index = i;
+      return true;
+    }
+    h->displacements.fetch_add(1, std::memory_order_relaxed);
+    i = (i + 1) & mask_;
+  }
+  // Every slot is taken, undo the displacements
+  for (size_t probe = 0; probe <= mask_; probe++) {
+    slots_[(home + probe) & mask_].displacements.fetch_sub(
+        1, std::memory_order_relaxed);
+  }
+  return false;
+}
+
+Cache::Handle* ClockCacheShard::Insert(const Slice& key, uint32_t hash,
+                                       void* value, size_t charge,
+                                       void (*deleter)(const Slice& key,
+                                                       void* value)) {
+  char* key_data = new char[key.size()];
+  std::memcpy(key_data, key.data(), key.size());
+
+  std::vector<DeadEntry> dead;
+  ClockHandle* e = nullptr;
+  {
+    MutexLock l(&mutex_);
+    bool admit = capacity_ > 0;
+    bool replaced = false;
+    if (admit) {
+      sketch_.MaybeReset();
+      replaced = EraseLocked(key, hash, &dead);
+    }
+    if (admit && !replaced &&
+        usage_.load(std::memory_order_relaxed) + charge > capacity_) {
+      // Admit only if more popular than the entry to evict.  A rejected
+      // entry leaves the clock as it is.
+      const size_t steps = FindVictim();
+      if (steps > 0) {
+        const size_t victim = (hand_ + steps - 1) & mask_;
+        if (sketch_.Frequency(hash) <=
+            sketch_.Frequency(
+                slots_[victim].hash.load(std::memory_order_relaxed))) {
+          admit = false;
+        } else {
+          AdvanceHand(steps, &dead);
+        }
+      }
+    }
+
+    size_t index;
+    while (admit && !ClaimSlot(hash, &index)) {
+      // No free slot, though the entries are below capacity
+      admit = EvictOne(&dead);
+    }
+    if (admit) {
+      e = &slots_[index];
+      e->value = value;
+      e->deleter = deleter;
+      e->charge = charge;
+      e->key_data = key_data;
+      e->key_length = key.size();
+      e->hash.store(hash, std::memory_order_relaxed);
+      usage_.fetch_add(charge, std::memory_order_relaxed);
+      // Publish the entry with the reference of the returned handle
+      e->meta.fetch_add(ClockHandle::StateDelta(ClockHandle::kConstruction,
+                                                ClockHandle::kVisible) +
+                            ClockHandle::kOneRef,
+                        std::memory_order_release);
+      while (usage_.load(std::memory_order_relaxed) > capacity_ &&
+             EvictOne(&dead)) {
+      }
+    }
+  }
+  DeleteEntries(dead);
+
+  if (e == nullptr) {
+    // Not cached, the handle is freed on release
+    e = new ClockHandle;
+    e->meta.store(ClockHandle::kOneRef, std::memory_order_relaxed);
+    e->hash.store(hash, std::memory_order_relaxed);
+    e->value = value;
+    e->deleter = deleter;
+    e->charge = charge;
+    e->key_data = key_data;
+    e->key_length = key.size();
+    e->detached = true;
+  }
+  return reinterpret_cast<Cache::Handle*>(e);
+}
+
+size_t ClockCacheShard::FindVictim() {
+  // The first round of a sweep takes the first unreferenced entry, else the
+  // second round the first one not in use
+  size_t first_unused = 0;
+  for (size_t step = 1; step <= mask_ + 1; step++) {
+    const uint64_t meta =
+        slots_[(hand_ + step - 1) & mask_].meta.load(std::memory_order_relaxed);
+    if (ClockHandle::State(meta) != ClockHandle::kVisible ||
+        ClockHandle::Refs(meta) > 0) {
+      continue;
+    }
+    if ((meta & ClockHandle::kReferenced) == 0) {
+      return step;
+    }
+    if (first_unused == 0) {
+      first_unused = step;
+    }
+  }
+  return first_unused == 0 ? 0 : mask_ + 1 + first_unused;
+}
+
+void ClockCacheShard::AdvanceHand(size_t steps, std::vector<DeadEntry>* dead) {
+  for (size_t step = 1; step < steps; step++) {
+    slots_[hand_].meta.fetch_and(~ClockHandle::kReferenced,
+                                 std::memory_order_relaxed);
+    hand_ = (hand_ + 1) & mask_;
+  }
+  const size_t victim = hand_;
+  hand_ = (hand_ + 1) & mask_;
+  // Fails if a lookup referenced it meanwhile, then the entries over
+  // capacity are evicted later
+  TryFree(victim, ClockHandle::kVisible, dead);
+}
+
+bool ClockCacheShard::EvictOne(std::vector<DeadEntry>* dead) {
+  // Two rounds clear all reference bits, so a victim is found unless every
+  // entry is in use
+  for (size_t step = 0; step < 2 * (mask_ + 1); step++) {
+    const size_t index = hand_;
+    hand_ = (hand_ + 1) & mask_;
+    ClockHandle* h = &slots_[index];
+    const uint64_t meta = h->meta.load(std::memory_order_relaxed);
+    if (ClockHandle::State(meta) != ClockHandle::kVisible ||
+        ClockHandle::Refs(meta) > 0) {
+      continue;
+    }
+    if ((meta & ClockHandle::kReferenced) != 0) {
+      h->meta.fetch_and(~ClockHandle::kReferenced, std::memory_order_relaxed);
+      continue;
+    }
+    if (TryFree(index, ClockHandle::kVisible, dead)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool ClockCacheShard::EraseLocked(const Slice& key, uint32_t hash,
+                                  std::vector<DeadEntry>* dead) {
+  bool erased = false;
+  size_t index = hash & mask_;
+  for (size_t probe = 0; probe <= mask_; probe++) {
+    ClockHandle* h = &slots_[index];
+    // Only the holder of the lock makes a slot visible or not
+    const uint64_t meta = h->meta.load(std::memory_order_acquire);
+    if (ClockHandle::State(meta) == ClockHandle::kVisible &&
+        h->hash.load(std::memory_order_relaxed) == hash && key == h->key()) {
+      h->meta.fetch_add(ClockHandle::StateDelta(ClockHandle::kVisible,
+                                                ClockHandle::kInvisible),
+                        std::memory_order_relaxed);
+      usage_.fetch_sub(h->charge, std::memory_order_relaxed);
+      // Freed now if no client uses it, else on its last release
+      TryFree(index, ClockHandle::kInvisible, dead);
+      erased = true;
+    }
+    if (h->displacements.load(std::memory_order_relaxed) == 0) {
+      break;
+    }
+    index = (index + 1) & mask_;
+  }
+  return erased;
+}
+
+void ClockCacheShard::Erase(const Slice& key, uint32_t hash) {
+  std::vector<DeadEntry> dead;
+  {
+    MutexLock l(&mutex_);
+    EraseLocked(key, hash, &dead);
+  }
+  DeleteEntries(dead);
+}
+
+void ClockCacheShard::Prune() {
+  std::vector<DeadEntry> dead;
+  {
+    MutexLock l(&mutex_);
+    for (size_t i = 0; i <= mask_; i++) {
+      TryFree(i, ClockHandle::kVisible, &dead);
+    }
+  }
+  DeleteEntries(dead);
+}
+
+static const int kNumShardBits = 4;
+static const int kNumShards = 1 << kNumShardBits;
+
+class ShardedClockCache : public Cache {
+ private:
+  ClockCacheShard shard_[kNumShards];
+  port::Mutex id_mutex_;
+  uint64_t last_id_;
+
+  static inline uint32_t HashSlice(const Slice& s) {
+    return Hash(s.data(), s.size(), 0);
+  }
+
+  static uint32_t Shard(uint32_t hash) { return hash >> (32 - kNumShardBits); }
+
+ public:
+  ShardedClockCache(size_t capacity, size_t estimated_entry_charge)
+      : last_id_(0) {
+    const size_t per_shard = (capacity + (kNumShards - 1)) / kNumShards;
+    for (int s = 0; s < kNumShards; s++) {
+      shard_[s].SetCapacity(per_shard, estimated_entry_charge);
+    }
+  }
+  ~ShardedClockCache() override {}
+  Handle* Insert(const Slice& key, void* value, size_t charge,
+                 void (*deleter)(const Slice& key, void* value)) override {
+    const uint32_t hash = HashSlice(key);
+    return shard_[Shard(hash)].Insert(key, hash, value, charge, deleter);
+  }
+  Handle* Lookup(const Slice& key) override {
+    const uint32_t hash = HashSlice(key);
+    return shard_[Shard(hash)].Lookup(key, hash);
+  }
+  void Release(Handle* handle) override {
+    ClockHandle* h = reinterpret_cast<ClockHandle*>(handle);
+    shard_[Shard(h->hash.load(std::memory_order_relaxed))].Release(h);
+  }
+  void Erase(const Slice& key) override {
+    const uint32_t hash = HashSlice(key);
+    shard_[Shard(hash)].Erase(key, hash);
+  }
+  void* Value(Handle* handle) override {
+    return reinterpret_cast<ClockHandle*>(handle)->value;
+  }
+  uint64_t NewId() override {
+    MutexLock l(&id_mutex_);
+    return ++(last_id_);
+  }
+  void Prune() override {
+    for (int s = 0; s < kNumShards; s++) {
+      shard_[s].Prune();
+    }
+  }
+  size_t TotalCharge() const override {
+    size_t total = 0;
+    for (int s = 0; s < kNumShards; s++) {
+      total += shard_[s].TotalCharge();
+    }
+    return total;
+  }
+};
+
+}  // end anonymous namespace
+
+Cache* NewClockCache(size_t capacity, size_t estimated_entry_charge) {
+  return new ShardedClockCache(capacity, estimated_entry_charge);
+}
+
+}  // namespace leveldb
@@ -12,6 +12,7 @@
 #include <sys/types.h>
 #include <unistd.h>
 
+#include <algorithm>
 #include <atomic>
 #include <cerrno>
 #include <cstddef>
@@ -322,6 +323,19 @@ class PosixWritableFile final : public WritableFile {
     return SyncFd(fd_, filename_);
   }
 
+  Status Preallocate(uint64_t size) override {
+#if HAVE_FALLOCATE
+    // FALLOC_FL_KEEP_SIZE reserves the blocks without changing the file
+    // size, so readers still see the end of the file where writing stopped.
+    if (::fallocate(fd_, FALLOC_FL_KEEP_SIZE, 0, static_cast<off_t>(size)) !=
+            0 &&
+        errno != EOPNOTSUPP) {
+      return PosixError(filename_, errno);
+    }
+#endif  // HAVE_FALLOCATE
+    return Status::OK();
+  }
+
  private:
   Status FlushBuffer() {
     Status status = WriteUnbuffered(buf_, pos_);
@@ -568,6 +582,24 @@ class PosixEnv : public Env {
     return Status::OK();
   }
 
+  Status ReuseWritableFile(const std::string& filename,
+                           const std::string& old_filename,
+                           WritableFile** result) override {
+    if (std::rename(old_filename.c_str(), filename.c_str()) != 0) {
+      *result = nullptr;
+      return PosixError(old_filename, errno);
+    }
+    // Not truncated, so writes within the old size do not change it
+    int fd = ::open(filename.c_str(), O_WRONLY | kOpenBaseFlags, 0644);
+    if (fd < 0) {
+      *result = nullptr;
+      return PosixError(filename, errno);
+    }
+
+    *result = new PosixWritableFile(filename, fd);
+    return Status::OK();
+  }
+
   bool FileExists(const std::string& filename) override {
     return ::access(filename.c_str(), F_OK) == 0;
   }
@@ -663,6 +695,8 @@ class PosixEnv : public Env {
   void Schedule(void (*background_work_function)(void* background_work_arg),
                 void* background_work_arg) override;
 
+  void SetBackgroundThreads(int number) override;
+
   void StartThread(void (*thread_main)(void* thread_main_arg),
                    void* thread_main_arg) override {
     std::thread new_thread(thread_main, thread_main_arg);
@@ -739,7 +773,9 @@ class PosixEnv : public Env {
 
   port::Mutex background_work_mutex_;
   port::CondVar background_work_cv_ GUARDED_BY(background_work_mutex_);
-  bool started_background_thread_ GUARDED_BY(background_work_mutex_);
+  // Threads started so far, and the number Schedule() should start
+  int background_threads_ GUARDED_BY(background_work_mutex_);
+  int max_background_threads_ GUARDED_BY(background_work_mutex_);
 
   std::queue<BackgroundWorkItem> background_work_queue_
       GUARDED_BY(background_work_mutex_);
@@ -774,7 +810,8 @@ int MaxOpenFiles() {
 
 PosixEnv::PosixEnv()
     : background_work_cv_(&background_work_mutex_),
-      started_background_thread_(false),
+      background_threads_(0),
+      max_background_threads_(1),
       mmap_limiter_(MaxMmaps()),
       fd_limiter_(MaxOpenFiles()) {}
 
@@ -783,22 +820,26 @@ void PosixEnv::Schedule(
     void* background_work_arg) {
   background_work_mutex_.Lock();
 
-  // Start the background thread, if we haven't done so already.
-  if (!started_background_thread_) {
-    started_background_thread_ = true;
+  // Start the background threads, if we haven't done so already.
+  while (background_threads_ < max_background_threads_) {
+    background_threads_++;
     std::thread background_thread(PosixEnv::BackgroundThreadEntryPoint, this);
     background_thread.detach();
   }
 
-  // If the queue is empty, the background thread may be waiting for work.
-  if (background_work_queue_.empty()) {
-    background_work_cv_.Signal();
-  }
+  // Wake up one of the threads waiting for work, if any.
+  background_work_cv_.Signal();
 
   background_work_queue_.emplace(background_work_function, background_work_arg);
   background_work_mutex_.Unlock();
 }
 
+void PosixEnv::SetBackgroundThreads(int number) {
+  background_work_mutex_.Lock();
+  max_background_threads_ = std::max(max_background_threads_, number);
+  background_work_mutex_.Unlock();
+}
+
 void PosixEnv::BackgroundThreadMain() {
   while (true) {
     background_work_mutex_.Lock();
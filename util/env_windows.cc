@@ -595,6 +595,8 @@ class WindowsEnv : public Env {
   void Schedule(void (*background_work_function)(void* background_work_arg),
                 void* background_work_arg) override;
 
+  void SetBackgroundThreads(int number) override;
+
   void StartThread(void (*thread_main)(void* thread_main_arg),
                    void* thread_main_arg) override {
     std::thread new_thread(thread_main, thread_main_arg);
@@ -672,7 +674,9 @@ class WindowsEnv : public Env {
 
   port::Mutex background_work_mutex_;
   port::CondVar background_work_cv_ GUARDED_BY(background_work_mutex_);
-  bool started_background_thread_ GUARDED_BY(background_work_mutex_);
+  // Threads started so far, and the number Schedule() should start
+  int background_threads_ GUARDED_BY(background_work_mutex_);
+  int max_background_threads_ GUARDED_BY(background_work_mutex_);
 
   std::queue<BackgroundWorkItem> background_work_queue_
       GUARDED_BY(background_work_mutex_);
@@ -685,7 +689,8 @@ int MaxMmaps() { return g_mmap_limit; }
 
 WindowsEnv::WindowsEnv()
     : background_work_cv_(&background_work_mutex_),
-      started_background_thread_(false),
+      background_threads_(0),
+      max_background_threads_(1),
       mmap_limiter_(MaxMmaps()) {}
 
 void WindowsEnv::Schedule(
@@ -693,22 +698,26 @@ void WindowsEnv::Schedule(
     void* background_work_arg) {
   background_work_mutex_.Lock();
 
-  // Start the background thread, if we haven't done so already.
-  if (!started_background_thread_) {
-    started_background_thread_ = true;
+  // Start the background threads, if we haven't done so already.
+  while (background_threads_ < max_background_threads_) {
+    background_threads_++;
     std::thread background_thread(WindowsEnv::BackgroundThreadEntryPoint, this);
     background_thread.detach();
   }
 
-  // If the queue is empty, the background thread may be waiting for work.
-  if (background_work_queue_.empty()) {
-    background_work_cv_.Signal();
-  }
+  // Wake up one of the threads waiting for work, if any.
+  background_work_cv_.Signal();
 
   background_work_queue_.emplace(background_work_function, background_work_arg);
   background_work_mutex_.Unlock();
 }
 
+void WindowsEnv::SetBackgroundThreads(int number) {
+  background_work_mutex_.Lock();
+  max_background_threads_ = std::max(max_background_threads_, number);
+  background_work_mutex_.Unlock();
+}
+
 void WindowsEnv::BackgroundThreadMain() {
   while (true) {
     background_work_mutex_.Lock();
@@ -4,8 +4,21 @@
 
 #include "leveldb/filter_policy.h"
 
+#include "leveldb/slice.h"
+
 namespace leveldb {
 
 FilterPolicy::~FilterPolicy() {}
 
+void FilterPolicy::KeysMayMatch(const Slice* keys, int n, const Slice& filter,
+                                bool* results) const {
+  for (int i = 0; i < n; i++) {
+    results[i] = KeyMayMatch(keys[i], filter);
+  }
+}
+
+const FilterPolicy* FilterPolicy::NewWithBitsPerKey(int bits_per_key) const {
+  return nullptr;
+}
+
 }  // namespace leveldb
@@ -0,0 +1,40 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "leveldb/layout_policy.h"
+
+#include <algorithm>
+#include <cassert>
+
+namespace leveldb {
+
+LayoutPolicy::~LayoutPolicy() {}
+
+namespace {
+
+class LevelLayoutPolicy : public LayoutPolicy {
+ public:
+  explicit LevelLayoutPolicy(const std::vector<LevelLayout>& layouts)
+      : layouts_(layouts) {
+    assert(!layouts_.empty());
+  }
+
+  const char* Name() const override { return "leveldb.LevelLayoutPolicy"; }
+
+  void GetLayout(int level, LevelLayout* layout) const override {
+    *layout = layouts_[std::min<size_t>(level, layouts_.size() - 1)];
+  }
+
+ private:
+  const std::vector<LevelLayout> layouts_;
+};
+
+}  // namespace
+
+const LayoutPolicy* NewLevelLayoutPolicy(
+    const std::vector<LevelLayout>& layouts) {
+  return new LevelLayoutPolicy(layouts);
+}
+
+}  // namespace leveldb
@@ -0,0 +1,351 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "leveldb/persistent_cache.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <deque>
+#include <map>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "leveldb/env.h"
+#include "port/port.h"
+#include "util/coding.h"
+#include "util/crc32c.h"
+#include "util/mutexlock.h"
+
+namespace leveldb {
+
+PersistentCache::~PersistentCache() {}
+
+namespace {
+
+// Entries are appended to an in-memory active segment. A full active segment
+// becomes read-only and is written to its own file by a background thread,
+// so an Insert() never waits for I/O, and files are never read while they
+// grow. Until its file is written, a segment is read from memory. Each entry
+// is stored as
+//
+//    crc      : uint32_t (masked crc32c of contents)
+//    contents : char[size]
+//
+// and located through the in-memory index. Eviction is FIFO by segment: the
+// oldest segment is dropped with all the entries it holds.
+class FilePersistentCache : public PersistentCache {
+ public:
+  FilePersistentCache(Env* env, const std::string& dir, size_t capacity)
+      : env_(env),
+        dir_(dir),
+        capacity_(capacity),
+        segment_size_(std::min<size_t>(std::max<size_t>(capacity / 16, 4096),
+                                       4 << 20)),
+        max_unwritten_segments_(
+            std::max<size_t>(kMaxUnwrittenBytes / segment_size_, 4)),
+        writer_cv_(&mutex_),
+        shutting_down_(false),
+        writer_running_(true),
+        active_number_(1),
+        sealed_bytes_(0) {
+    env_->StartThread(&FilePersistentCache::WriterMain, this);
+  }
+
+  ~FilePersistentCache() override {
+    {
+      MutexLock l(&mutex_);
+      shutting_down_ = true;
+      writer_cv_.SignalAll();
+      while (writer_running_) {
+        writer_cv_.Wait();
+      }
+    }
+    for (auto& segment : sealed_) {
+      if (segment.second.file != nullptr) {
+        segment.second.file.reset();
+        env_->RemoveFile(SegmentFileName(segment.first));
+      }
+    }
+    for (auto& fname : obsolete_files_) {
+      env_->RemoveFile(fname);
+    }
+  }
+
+  void Insert(const Slice& key, const Slice& contents) override;
+
+  bool Lookup(const Slice& key, std::string* contents) override;
+
+  size_t TotalCharge() const override {
+    MutexLock l(&mutex_);
+    return sealed_bytes_ + active_.size();
+  }
+
+ private:
+  struct Location {
+    uint64_t segment;
+    uint32_t offset;
+    uint32_t size;
+  };
+
+  struct Segment {
+    // Null until the writer has written the segment
+    std::shared_ptr<RandomAccessFile> file;
+    // Null once the segment is read from its file
+    std::shared_ptr<const std::string> contents;
+    std::vector<std::string> keys;
+    size_t size;
+  };
+
+  // Bytes of full segments kept in memory for the writer at most, beyond
+  // that the oldest unwritten segment is dropped rather than blocking inserts
+  static const size_t kMaxUnwrittenBytes = 16 << 20;
+
+  std::string SegmentFileName(uint64_t number) const {
+    char buf[100];
+    std::snprintf(buf, sizeof(buf), "/%06llu.pcache",
+                  static_cast<unsigned long long>(number));
+    return dir_ + buf;
+  }
+
+  static void WriterMain(void* cache) {
+    reinterpret_cast<FilePersistentCache*>(cache)->WriterLoop();
+  }
+
+  // Write the sealed segments to their files and remove the files of the
+  // dropped ones, until shutdown
+  void WriterLoop();
+
+  // Make the active segment read-only and start a new one
+  void SealActive() EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+  // Drop a sealed segment with the entries it holds
+  void DropSegment(std::map<uint64_t, Segment>::iterator it)
+      EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+  // Remove the index entries of keys still pointing to segment number
+  void DropKeys(uint64_t number, const std::vector<std::string>& keys)
+      EXCLUSIVE_LOCKS_REQUIRED(mutex_);
+
+  Env* const env_;
+  const std::string dir_;
+  const size_t capacity_;
+  const size_t segment_size_;
+  const size_t max_unwritten_segments_;
+
+  mutable port::Mutex mutex_;
+  // Signalled when there is work for the writer, and when it exits
+  port::CondVar writer_cv_ GUARDED_BY(mutex_);
+  bool shutting_down_ GUARDED_BY(mutex_);
+  bool writer_running_ GUARDED_BY(mutex_);
+  std::unordered_map<std::string, Location> index_ GUARDED_BY(mutex_);
+  // Read-only segments, oldest first
+  std::map<uint64_t, Segment> sealed_ GUARDED_BY(mutex_);
+  // Sealed segments the writer has yet to write, oldest first
+  std::deque<uint64_t> unwritten_ GUARDED_BY(mutex_);
+  // Files of dropped segments the writer has yet to remove
+  std::vector<std::string> obsolete_files_ GUARDED_BY(mutex_);
+  uint64_t active_number_ GUARDED_BY(mutex_);
+  std::string active_ GUARDED_BY(mutex_);
+  std::vector<std::string> active_keys_ GUARDED_BY(mutex_);
+  size_t sealed_bytes_ GUARDED_BY(mutex_);
+};
+
+void FilePersistentCache::Insert(const Slice& key, const Slice& contents) {
+  if (contents.size() + 4 > segment_size_) {
+    return;
+  }
+  MutexLock l(&mutex_);
+  std::string key_str = key.ToString();
+  if (index_.find(key_str) != index_.end()) {
+    return;
+  }
+  if (active_.size() + 4 + contents.size() > segment_size_) {
+    SealActive();
+  }
+  Location location{active_number_, static_cast<uint32_t>(active_.size()),
+                    static_cast<uint32_t>(contents.size())};
+  PutFixed32(&active_,
+             crc32c::Mask(crc32c::Value(contents.data(), contents.size())));
+  active_.append(contents.data(), contents.size());
+  active_keys_.push_back(key_str);
+  index_.emplace(std::move(key_str), location);
+}
+
+bool FilePersistentCache::Lookup(const Slice& key, std::string* contents) {
+  Location location;
+  std::shared_ptr<RandomAccessFile> file;
+  std::shared_ptr<const std::string> buffer;
+  Slice record;
+  std::string scratch;
+  {
+    MutexLock l(&mutex_);
+    auto it = index_.find(key.ToString());
+    if (it == index_.end()) {
+      return false;
+    }
+    location = it->second;
+    if (location.segment == active_number_) {
+      scratch = active_.substr(location.offset, 4 + location.size);
+      record = Slice(scratch);
+    } else {
+      const Segment& segment = sealed_[location.segment];
+      file = segment.file;
+      buffer = segment.contents;
+    }
+  }
+  if (buffer != nullptr) {
+    // Not written yet, the buffer stays alive while we hold it
+    record = Slice(buffer->data() + location.offset, 4 + location.size);
+  } else if (file != nullptr) {
+    // Read outside the lock, the file stays open while we hold it
+    scratch.resize(4 + location.size);
+    Status s = file->Read(location.offset, 4 + location.size, &record,
+                          &scratch[0]);
+    if (!s.ok() || record.size() != 4 + location.size) {
+      return false;
+    }
+  }
+  uint32_t expected = crc32c::Unmask(DecodeFixed32(record.data()));
+  if (crc32c::Value(record.data() + 4, location.size) != expected) {
+    MutexLock l(&mutex_);
+    index_.erase(key.ToString());
+    return false;
+  }
+  contents->assign(record.data() + 4, location.size);
+  return true;
+}
+
+void FilePersistentCache::SealActive() {
+  const uint64_t number = active_number_;
+  Segment& segment = sealed_[number];
+  segment.size = active_.size();
+  segment.contents = std::make_shared<const std::string>(std::move(active_));
+  segment.keys.swap(active_keys_);
+  sealed_bytes_ += segment.size;
+  unwritten_.push_back(number);
+  active_number_++;
+  active_.clear();
+  active_keys_.clear();
+
+  // Make room for the next active segment, and drop what the writer cannot
+  // keep up with
+  while (!sealed_.empty() && sealed_bytes_ + segment_size_ > capacity_) {
+    DropSegment(sealed_.begin());
+  }
+  while (unwritten_.size() > max_unwritten_segments_) {
+    // Segments evicted above are at the front, and dropped already
+    auto it = sealed_.find(unwritten_.front());
+    if (it != sealed_.end()) {
+      DropSegment(it);
+    }
+    unwritten_.pop_front();
+  }
+  writer_cv_.SignalAll();
+}
+
+void FilePersistentCache::DropSegment(
+    std::map<uint64_t, Segment>::iterator it) {
+  DropKeys(it->first, it->second.keys);
+  sealed_bytes_ -= it->second.size;
+  if (it->second.file != nullptr) {
+    obsolete_files_.push_back(SegmentFileName(it->first));
+  }
+  sealed_.erase(it);
+}
+
+void FilePersistentCache::DropKeys(uint64_t number,
+                                   const std::vector<std::string>& keys) {
+  for (auto& key : keys) {
+    auto it = index_.find(key);
+    if (it != index_.end() && it->second.segment == number) {
+      index_.erase(it);
+    }
+  }
+}
+
+void FilePersistentCache::WriterLoop() {
+  MutexLock l(&mutex_);
+  while (!shutting_down_) {
+    if (!obsolete_files_.empty()) {
+      std::vector<std::string> files;
+      files.swap(obsolete_files_);
+      mutex_.Unlock();
+      for (auto& fname : files) {
+        env_->RemoveFile(fname);
+      }
+      mutex_.Lock();
+      continue;
+    }
+    if (unwritten_.empty()) {
+      writer_cv_.Wait();
+      continue;
+    }
+    const uint64_t number = unwritten_.front();
+    unwritten_.pop_front();
+    auto it = sealed_.find(number);
+    if (it == sealed_.end()) {
+      continue;
+    }
+    std::shared_ptr<const std::string> contents = it->second.contents;
+
+    mutex_.Unlock();
+    const std::string fname = SegmentFileName(number);
+    WritableFile* writer;
+    Status s = env_->NewWritableFile(fname, &writer);
+    if (s.ok()) {
+      // The cache does not survive a restart, so there is no need to sync
+      s = writer->Append(*contents);
+      if (s.ok()) {
+        s = writer->Close();
+      }
+      delete writer;
+    }
+    RandomAccessFile* reader = nullptr;
+    if (s.ok()) {
+      s = env_->NewRandomAccessFile(fname, &reader);
+    }
+    mutex_.Lock();
+
+    it = sealed_.find(number);
+    if (s.ok() && it != sealed_.end()) {
+      it->second.file.reset(reader);
+      it->second.contents.reset();
+    } else {
+      // Dropped meanwhile, or failed to write
+      delete reader;
+      if (it != sealed_.end()) {
+        DropSegment(it);
+      }
+      obsolete_files_.push_back(fname);
+    }
+  }
+  writer_running_ = false;
+  writer_cv_.SignalAll();
+}
+
+}  // namespace
+
+Status NewFilePersistentCache(Env* env, const std::string& dir,
+                              size_t capacity, PersistentCache** result) {
+  *result = nullptr;
+  env->CreateDir(dir);  // Ignore error, the directory may exist
+  std::vector<std::string> children;
+  Status s = env->GetChildren(dir, &children);
+  if (!s.ok()) {
+    return s;
+  }
+  const std::string suffix = ".pcache";
+  for (auto& child : children) {
+    if (child.size() > suffix.size() &&
+        child.compare(child.size() - suffix.size(), suffix.size(), suffix) ==
+            0) {
+      env->RemoveFile(dir + "/" + child);
+    }
+  }
+  *result = new FilePersistentCache(env, dir, capacity);
+  return Status::OK();
+}
+
+}  // namespace leveldb
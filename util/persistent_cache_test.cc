@@ -0,0 +1,208 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "leveldb/persistent_cache.h"
+
+#include <atomic>
+#include <memory>
+
+#include "colsm/comparators.h"
+#include "gtest/gtest.h"
+#include "helpers/memenv/memenv.h"
+#include "leveldb/cache.h"
+#include "leveldb/db.h"
+#include "leveldb/env.h"
+#include "util/coding.h"
+
+namespace leveldb {
+
+// Counts the hits of a persistent cache
+class CountingCache : public PersistentCache {
+ public:
+  explicit CountingCache(PersistentCache* target)
+      : target_(target), inserts_(0), hits_(0) {}
+
+  void Insert(const Slice& key, const Slice& contents) override {
+    inserts_++;
+    target_->Insert(key, contents);
+  }
+
+  bool Lookup(const Slice& key, std::string* contents) override {
+    bool found = target_->Lookup(key, contents);
+    hits_ += found;
+    return found;
+  }
+
+  size_t TotalCharge() const override { return target_->TotalCharge(); }
+
+  int inserts() const { return inserts_.load(); }
+  int hits() const { return hits_.load(); }
+
+ private:
+  PersistentCache* target_;
+  std::atomic<int> inserts_;
+  std::atomic<int> hits_;
+};
+
+class PersistentCacheTest : public testing::Test {
+ public:
+  PersistentCacheTest() : env_(NewMemEnv(Env::Default())), cache_(nullptr) {}
+
+  ~PersistentCacheTest() { delete cache_; }
+
+  void Open(size_t capacity) {
+    delete cache_;
+    ASSERT_TRUE(
+        NewFilePersistentCache(env_.get(), "/pcache", capacity, &cache_).ok());
+  }
+
+  static std::string Key(int i) {
+    std::string result;
+    PutFixed32(&result, i);
+    return result;
+  }
+
+  static std::string Value(int i, size_t size) {
+    return std::string(size, static_cast<char>('a' + i % 26));
+  }
+
+  int NumFiles() {
+    std::vector<std::string> children;
+    env_->GetChildren("/pcache", &children);
+    return children.size();
+  }
+
+  // Segments are written in the background
+  void WaitForFiles() {
+    for (int i = 0; i < 1000 && NumFiles() == 0; i++) {
+      Env::Default()->SleepForMicroseconds(1000);
+    }
+    ASSERT_GT(NumFiles(), 0);
+  }
+
+  std::unique_ptr<Env> env_;
+  PersistentCache* cache_;
+};
+
+TEST_F(PersistentCacheTest, InsertAndLookup) {
+  Open(1 << 20);
+  std::string contents;
+  ASSERT_FALSE(cache_->Lookup(Key(1), &contents));
+
+  // Enough entries to seal some segments
+  for (int i = 0; i < 100; i++) {
+    cache_->Insert(Key(i), Value(i, 1000));
+  }
+  WaitForFiles();
+  for (int i = 0; i < 100; i++) {
+    ASSERT_TRUE(cache_->Lookup(Key(i), &contents));
+    ASSERT_EQ(Value(i, 1000), contents);
+  }
+  ASSERT_FALSE(cache_->Lookup(Key(100), &contents));
+
+  // Existing entries are kept
+  cache_->Insert(Key(1), "other");
+  ASSERT_TRUE(cache_->Lookup(Key(1), &contents));
+  ASSERT_EQ(Value(1, 1000), contents);
+}
+
+TEST_F(PersistentCacheTest, EvictOldest) {
+  const size_t kCapacity = 256 * 1024;
+  Open(kCapacity);
+  for (int i = 0; i < 1000; i++) {
+    cache_->Insert(Key(i), Value(i, 1000));
+  }
+  ASSERT_LE(cache_->TotalCharge(), kCapacity);
+
+  std::string contents;
+  ASSERT_FALSE(cache_->Lookup(Key(0), &contents));
+  ASSERT_TRUE(cache_->Lookup(Key(999), &contents));
+  ASSERT_EQ(Value(999, 1000), contents);
+
+  int found = 0;
+  for (int i = 0; i < 1000; i++) {
+    found += cache_->Lookup(Key(i), &contents);
+  }
+  ASSERT_GT(found, 100);
+  ASSERT_LT(found, 300);
+}
+
+TEST_F(PersistentCacheTest, RemoveFiles) {
+  Open(1 << 20);
+  for (int i = 0; i < 200; i++) {
+    cache_->Insert(Key(i), Value(i, 1000));
+  }
+  WaitForFiles();
+  delete cache_;
+  cache_ = nullptr;
+  ASSERT_EQ(0, NumFiles());
+}
+
+TEST_F(PersistentCacheTest, SecondaryBlockCache) {
+  Open(4 << 20);
+  std::unique_ptr<Cache> block_cache(NewLRUCache(8 * 1024));
+  auto int_comparator = colsm::intComparator();
+  Options options;
+  options.comparator = int_comparator.get();
+  options.env = env_.get();
+  options.create_if_missing = true;
+  options.block_cache = block_cache.get();
+  CountingCache counting_cache(cache_);
+  options.persistent_cache = &counting_cache;
+
+  DB* db;
+  ASSERT_TRUE(DB::Open(options, "/db", &db).ok());
+  for (int i = 0; i < 2000; i++) {
+    ASSERT_TRUE(db->Put(WriteOptions(), Key(i), Value(i, 100)).ok());
+  }
+  db->CompactRange(nullptr, nullptr);
+
+  // Reads evict blocks from the small block cache into the persistent cache,
+  // and the second round reads them back from there
+  for (int round = 0; round < 2; round++) {
+    for (int i = 0; i < 2000; i += 7) {
+      std::string value;
+      ASSERT_TRUE(db->Get(ReadOptions(), Key(i), &value).ok());
+      ASSERT_EQ(Value(i, 100), value);
+    }
+  }
+  ASSERT_GT(cache_->TotalCharge(), 0);
+  ASSERT_GT(counting_cache.hits(), 0);
+  delete db;
+  block_cache.reset();
+}
+
+TEST_F(PersistentCacheTest, NoSpillOnClose) {
+  Open(4 << 20);
+  auto int_comparator = colsm::intComparator();
+  Options options;
+  options.comparator = int_comparator.get();
+  options.env = env_.get();
+  options.create_if_missing = true;
+  CountingCache counting_cache(cache_);
+  options.persistent_cache = &counting_cache;
+
+  DB* db;
+  ASSERT_TRUE(DB::Open(options, "/db", &db).ok());
+  for (int i = 0; i < 2000; i++) {
+    ASSERT_TRUE(db->Put(WriteOptions(), Key(i), Value(i, 100)).ok());
+  }
+  db->CompactRange(nullptr, nullptr);
+  for (int i = 0; i < 2000; i += 7) {
+    std::string value;
+    ASSERT_TRUE(db->Get(ReadOptions(), Key(i), &value).ok());
+  }
+
+  // The block cache the DB created is dropped without spilling
+  const int inserts = counting_cache.inserts();
+  delete db;
+  ASSERT_EQ(inserts, counting_cache.inserts());
+}
+
+}  // namespace leveldb
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,182 @@
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include <algorithm>
+#include <vector>
+
+#include "leveldb/filter_policy.h"
+#include "leveldb/slice.h"
+#include "util/coding.h"
+#include "util/hash.h"
+
+namespace leveldb {
+
+namespace {
+
+// Xor filter with 8-bit fingerprints (Graf and Lemire, "Xor Filters: Faster
+// and Smaller Than Bloom and Cuckoo Filters"). A key is mapped to one slot in
+// each of the three segments of a fingerprint array, and the filter is built
+// such that the xor of the three slots equals the key's fingerprint. It uses
+// 1.23 * 8 ~ 9.84 bits per key for a false positive rate of 1/256 (~0.4%),
+// and a lookup always costs exactly 3 probes.
+//
+// The filter layout is as following:
+//    fingerprints : uint8_t {3 * segment_length}
+//    seed         : uint32_t
+//    segment_length : uint32_t
+static const size_t kTrailerSize = 8;
+
+// Construction fails with a small probability, and is then retried with
+// another seed
+static const int kMaxAttempt = 64;
+
+static inline uint64_t Mix64(uint64_t h) {
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdULL;
+  h ^= h >> 33;
+  h *= 0xc4ceb9fe1a85ec53ULL;
+  h ^= h >> 33;
+  return h;
+}
+
+static inline uint64_t XorHash(const Slice& key, uint32_t seed) {
+  uint64_t base;
+  if (key.size() == 4) {
+    // Fast path for int keys, which need no byte-wise hashing
+    base = DecodeFixed32(key.data());
+  } else {
+    base = Hash(key.data(), key.size(), 0xbc9f1d34);
+  }
+  return Mix64(base + (static_cast<uint64_t>(seed) << 32));
+}
+
+static inline uint32_t Reduce(uint32_t hash, uint32_t n) {
+  return (static_cast<uint64_t>(hash) * n) >> 32;
+}
+
+static inline uint64_t Rotl64(uint64_t n, unsigned int c) {
+  return (n << (c & 63)) | (n >> ((-c) & 63));
+}
+
+static inline uint8_t Fingerprint(uint64_t hash) { return hash ^ (hash >> 32); }
+
+static inline void Slots(uint64_t hash, uint32_t segment_length,
+                         uint32_t* slots) {
+  slots[0] = Reduce(static_cast<uint32_t>(hash), segment_length);
+  slots[1] = Reduce(static_cast<uint32_t>(Rotl64(hash, 21)), segment_length) +
+             segment_length;
+  slots[2] = Reduce(static_cast<uint32_t>(Rotl64(hash, 42)), segment_length) +
+             2 * segment_length;
+}
+
+class XorFilterPolicy : public FilterPolicy {
+ public:
+  const char* Name() const override { return "colsm.XorFilter8"; }
+
+  void CreateFilter(const Slice* keys, int n, std::string* dst) const override {
+    uint32_t segment_length = (32 + static_cast<uint32_t>(1.23 * n)) / 3 + 1;
+    uint32_t capacity = 3 * segment_length;
+
+    std::vector<uint64_t> hashes(n);
+    std::vector<uint8_t> count(capacity);
+    std::vector<uint64_t> xor_hash(capacity);
+    std::vector<uint32_t> queue;
+    std::vector<std::pair<uint64_t, uint32_t>> stack;
+    uint32_t slots[3];
+
+    uint32_t seed = 0;
+    bool built = false;
+    for (int attempt = 0; attempt < kMaxAttempt && !built; ++attempt) {
+      seed = attempt;
+      for (int i = 0; i < n; ++i) {
+        hashes[i] = XorHash(keys[i], seed);
+      }
+      // Keys can repeat, e.g., versions of a user key, and would never peel
+      std::sort(hashes.begin(), hashes.end());
+      size_t num_hash =
+          std::unique(hashes.begin(), hashes.end()) - hashes.begin();
+
+      std::fill(count.begin(), count.end(), 0);
+      std::fill(xor_hash.begin(), xor_hash.end(), 0);
+      for (size_t i = 0; i < num_hash; ++i) {
+        Slots(hashes[i], segment_length, slots);
+        for (auto slot : slots) {
+          count[slot]++;
+          xor_hash[slot] ^= hashes[i];
+        }
+      }
+
+      // Peel the slots that only one key maps to
+      queue.clear();
+      stack.clear();
+      for (uint32_t i = 0; i < capacity; ++i) {
+        if (count[i] == 1) {
+          queue.push_back(i);
+        }
+      }
+      while (!queue.empty()) {
+        uint32_t index = queue.back();
+        queue.pop_back();
+        if (count[index] != 1) {
+          continue;
+        }
+        uint64_t hash = xor_hash[index];
+        stack.emplace_back(hash, index);
+        Slots(hash, segment_length, slots);
+        for (auto slot : slots) {
+          count[slot]--;
+          xor_hash[slot] ^= hash;
+          if (count[slot] == 1) {
+            queue.push_back(slot);
+          }
+        }
+      }
+      built = stack.size() == num_hash;
+    }
+
+    const size_t init_size = dst->size();
+    if (!built) {
+      // Give up, an empty fingerprint array matches every key
+      PutFixed32(dst, seed);
+      PutFixed32(dst, 0);
+      return;
+    }
+    dst->resize(init_size + capacity, 0);
+    uint8_t* fingerprints = reinterpret_cast<uint8_t*>(&(*dst)[init_size]);
+    for (auto it = stack.rbegin(); it != stack.rend(); ++it) {
+      Slots(it->first, segment_length, slots);
+      fingerprints[it->second] = Fingerprint(it->first) ^
+                                 fingerprints[slots[0]] ^
+                                 fingerprints[slots[1]] ^
+                                 fingerprints[slots[2]];
+    }
+    PutFixed32(dst, seed);
+    PutFixed32(dst, segment_length);
+  }
+
+  bool KeyMayMatch(const Slice& key, const Slice& filter) const override {
+    const size_t len = filter.size();
+    if (len < kTrailerSize) return false;
+    uint32_t seed = DecodeFixed32(filter.data() + len - kTrailerSize);
+    uint32_t segment_length = DecodeFixed32(filter.data() + len - 4);
+    if (segment_length == 0 ||
+        static_cast<uint64_t>(segment_length) * 3 != len - kTrailerSize) {
+      // Construction failed, or not a filter generated by this policy.
+      return true;
+    }
+    const uint8_t* fingerprints =
+        reinterpret_cast<const uint8_t*>(filter.data());
+    uint64_t hash = XorHash(key, seed);
+    uint32_t slots[3];
+    Slots(hash, segment_length, slots);
+    return Fingerprint(hash) ==
+           (fingerprints[slots[0]] ^ fingerprints[slots[1]] ^
+            fingerprints[slots[2]]);
+  }
+};
+}  // namespace
+
+const FilterPolicy* NewXorFilterPolicy() { return new XorFilterPolicy(); }
+
+}  // namespace leveldb